@@ -97,6 +97,36 @@ static void unicast_recv(struct unicast_conn *, const linkaddr_t *);
 static const struct broadcast_callbacks broadcast_call = {broadcast_recv, NULL};
 static const struct unicast_callbacks unicast_call = {unicast_recv, NULL};
 
+#if DELUGE_BULK_TRANSFER
+#ifdef DELUGE_CALLBACK_BULK_RESERVE
+#ifndef DELUGE_CALLBACK_BULK_RELEASE
+#error DELUGE_CALLBACK_BULK_RESERVE requires DELUGE_CALLBACK_BULK_RELEASE
+#endif
+/* Reserves cells for sending pages to (tx) or receiving pages from
+   (!tx) a neighbor. Returns 1 if they are in place, i.e. if they match
+   the ones the neighbor reserves on its side. */
+int DELUGE_CALLBACK_BULK_RESERVE(const linkaddr_t *peer, int tx);
+void DELUGE_CALLBACK_BULK_RELEASE(const linkaddr_t *peer, int tx);
+#endif /* DELUGE_CALLBACK_BULK_RESERVE */
+
+/* The neighbor we send pages to. bulk_tx tells if we have cells
+   reserved to it, bulk_rx if we have cells reserved from our source
+   (summary_from), which has pages up to bulk_available. */
+static linkaddr_t bulk_peer;
+static uint8_t bulk_tx;
+static uint8_t bulk_rx;
+static uint8_t bulk_available;
+static struct ctimer bulk_timer;
+
+/* Pages go to a single requester, no need to wait for more requests. */
+#define TX_DELAY	1
+/* Once the update is in, nodes serve pages of the version they get. */
+#define SERVED_VERSION(obj)	((obj).update_version)
+#else /* DELUGE_BULK_TRANSFER */
+#define TX_DELAY	CLOCK_SECOND
+#define SERVED_VERSION(obj)	((obj).version)
+#endif /* DELUGE_BULK_TRANSFER */
+
 /* The Deluge process manages the main Deluge timer. */
 PROCESS(deluge_process, "Deluge");
 
@@ -109,17 +139,74 @@ transition(int state)
       ctimer_stop(&summary_timer);
       ctimer_stop(&profile_timer);
       break;
+#if !DELUGE_BULK_TRANSFER
+    /* In bulk mode, a node receives and sends pages at the same time. */
     case DELUGE_STATE_RX:
       ctimer_stop(&rx_timer);
       break;
     case DELUGE_STATE_TX:
       ctimer_stop(&tx_timer);
       break;
+#endif /* !DELUGE_BULK_TRANSFER */
     }
     deluge_state = state;
   }
 }
 
+#if DELUGE_BULK_TRANSFER
+static void
+bulk_release_rx(void)
+{
+#ifdef DELUGE_CALLBACK_BULK_RELEASE
+  if(bulk_rx) {
+    DELUGE_CALLBACK_BULK_RELEASE(&current_object.summary_from, 0);
+  }
+#endif
+  bulk_rx = 0;
+}
+
+static void
+bulk_release_tx(void *arg)
+{
+#ifdef DELUGE_CALLBACK_BULK_RELEASE
+  if(bulk_tx) {
+    DELUGE_CALLBACK_BULK_RELEASE(&bulk_peer, 1);
+  }
+#endif
+  bulk_tx = 0;
+}
+
+/* Gets pages from source, in reserved cells if possible. */
+static void
+bulk_set_source(const linkaddr_t *source)
+{
+  if(bulk_rx && linkaddr_cmp(source, &current_object.summary_from)) {
+    return;
+  }
+  bulk_release_rx();
+  linkaddr_copy(&current_object.summary_from, source);
+#ifdef DELUGE_CALLBACK_BULK_RESERVE
+  bulk_rx = DELUGE_CALLBACK_BULK_RESERVE(source, 0);
+#endif
+}
+
+/* Sends pages to peer, in reserved cells if it listens in them. */
+static void
+bulk_set_peer(const linkaddr_t *peer, int reserved)
+{
+  if(!linkaddr_cmp(peer, &bulk_peer)) {
+    bulk_release_tx(NULL);
+    linkaddr_copy(&bulk_peer, peer);
+  }
+#ifdef DELUGE_CALLBACK_BULK_RESERVE
+  if(reserved && !bulk_tx) {
+    bulk_tx = DELUGE_CALLBACK_BULK_RESERVE(peer, 1);
+  }
+#endif
+  ctimer_set(&bulk_timer, T_BULK_IDLE, bulk_release_tx, NULL);
+}
+#endif /* DELUGE_BULK_TRANSFER */
+
 static int
 write_page(struct deluge_object *obj, unsigned pagenum, unsigned char *data)
 {
@@ -244,7 +331,11 @@ send_request(void *arg)
 
   obj = (struct deluge_object *)arg;
 
+#if DELUGE_BULK_TRANSFER
+  request.cmd = bulk_rx ? DELUGE_CMD_BULK_REQUEST : DELUGE_CMD_REQUEST;
+#else
   request.cmd = DELUGE_CMD_REQUEST;
+#endif
   request.pagenum = obj->current_rx_page;
   request.version = obj->pages[request.pagenum].version;
   request.request_set = ~obj->pages[obj->current_rx_page].packet_set;
@@ -261,20 +352,19 @@ send_request(void *arg)
     obj->nrequests = 0;
     transition(DELUGE_STATE_MAINTAIN);
   } else {
+#if DELUGE_BULK_TRANSFER
+    ctimer_set(&rx_timer, T_BULK_RETRY, send_request, obj);
+#else
     ctimer_reset(&rx_timer);
+#endif
   }
 }
 
 static void
-advertise_summary(struct deluge_object *obj)
+send_summary(struct deluge_object *obj)
 {
   struct deluge_msg_summary summary;
 
-  if(recv_adv >= CONST_K) {
-    ctimer_stop(&summary_timer);
-    return;
-  }
-
   summary.cmd = DELUGE_CMD_SUMMARY;
   summary.version = obj->update_version;
   summary.highest_available = highest_available_page(obj);
@@ -287,6 +377,17 @@ advertise_summary(struct deluge_object *obj)
   broadcast_send(&deluge_broadcast);
 }
 
+static void
+advertise_summary(struct deluge_object *obj)
+{
+  if(recv_adv >= CONST_K) {
+    ctimer_stop(&summary_timer);
+    return;
+  }
+
+  send_summary(obj);
+}
+
 static void
 handle_summary(struct deluge_msg_summary *msg, const linkaddr_t *sender)
 {
@@ -303,7 +404,7 @@ handle_summary(struct deluge_msg_summary *msg, const linkaddr_t *sender)
     recv_adv++;
   }
 
-  if(msg->version < current_object.version) {
+  if(msg->version < SERVED_VERSION(current_object)) {
     old_summary = 1;
     broadcast_profile = 1;
   }
@@ -316,6 +417,22 @@ handle_summary(struct deluge_msg_summary *msg, const linkaddr_t *sender)
       return;
     }
 
+#if DELUGE_BULK_TRANSFER
+    /* Stick to a source we have reserved cells with, and ask it for
+       new pages right away. */
+    if(bulk_rx && !linkaddr_cmp(sender, &current_object.summary_from)) {
+      return;
+    }
+    bulk_set_source(sender);
+    bulk_available = msg->highest_available;
+    transition(DELUGE_STATE_RX);
+    if(ctimer_expired(&rx_timer)) {
+      ctimer_set(&rx_timer, (unsigned)random_rand() % T_BULK_R,
+		 send_request, &current_object);
+    }
+    return;
+#endif /* DELUGE_BULK_TRANSFER */
+
     oldest_request = oldest_data = now = clock_time();
     for(i = 0; i < msg->highest_available; i++) {
       page = &current_object.pages[i];
@@ -365,7 +482,11 @@ send_page(struct deluge_object *obj, unsigned pagenum)
       pkt.crc = crc16_data(cp, S_PKT, 0);
       memcpy(pkt.payload, cp, S_PKT);
       packetbuf_copyfrom(&pkt, sizeof(pkt));
+#if DELUGE_BULK_TRANSFER
+      unicast_send(&deluge_uc, &bulk_peer);
+#else
       broadcast_send(&deluge_broadcast);
+#endif
     }
     pkt.packetnum++;
   }
@@ -395,7 +516,7 @@ tx_callback(void *arg)
 }
 
 static void
-handle_request(struct deluge_msg_request *msg)
+handle_request(struct deluge_msg_request *msg, const linkaddr_t *sender)
 {
   int highest_available;
 
@@ -409,9 +530,17 @@ handle_request(struct deluge_msg_request *msg)
 
   highest_available = highest_available_page(&current_object);
 
+#if DELUGE_BULK_TRANSFER
+  /* Complete pages are served right away, to one requester at a time */
+  if(msg->pagenum < highest_available &&
+     msg->version == current_object.pages[msg->pagenum].version &&
+     (current_object.tx_set == 0 || linkaddr_cmp(sender, &bulk_peer))) {
+    bulk_set_peer(sender, msg->cmd == DELUGE_CMD_BULK_REQUEST);
+#else /* DELUGE_BULK_TRANSFER */
   /* Deluge M.6 */
   if(msg->version == current_object.version &&
       msg->pagenum <= highest_available) {
+#endif /* DELUGE_BULK_TRANSFER */
     current_object.pages[msg->pagenum].last_request = clock_time();
 
     /* Deluge T.1 */
@@ -423,7 +552,7 @@ handle_request(struct deluge_msg_request *msg)
     }
 
     transition(DELUGE_STATE_TX);
-    ctimer_set(&tx_timer, CLOCK_SECOND, tx_callback, &current_object);
+    ctimer_set(&tx_timer, TX_DELAY, tx_callback, &current_object);
   }
 }
 
@@ -479,13 +608,33 @@ handle_packet(struct deluge_msg_packet *msg)
 	leds_on(LEDS_RED);
 	PRINTF("Update completed for object %u, version %u\n", 
 	       (unsigned)current_object.object_id, packet.version);
+#if DELUGE_BULK_TRANSFER
+	ctimer_stop(&rx_timer);
+	bulk_release_rx();
+#endif
       } else if(current_object.current_rx_page < OBJECT_PAGE_COUNT(current_object)) {
+#if DELUGE_BULK_TRANSFER
+	/* Ask for the next page while we forward this one, or wait for
+	   our source to announce it. */
+	current_object.nrequests = 0;
+	if(current_object.current_rx_page < bulk_available) {
+	  ctimer_set(&rx_timer, (unsigned)random_rand() % T_BULK_R,
+		     send_request, &current_object);
+	} else {
+	  ctimer_stop(&rx_timer);
+	}
+#else
         if(ctimer_expired(&rx_timer)) {
 	  ctimer_set(&rx_timer,
 		CONST_OMEGA * ESTIMATED_TX_TIME + (random_rand() % T_R),
 		send_request, &current_object);
 	}
+#endif /* DELUGE_BULK_TRANSFER */
       }
+#if DELUGE_BULK_TRANSFER
+      /* Let our neighbors know they can get the page from us */
+      send_summary(&current_object);
+#endif
       /* Deluge R.3 */
       transition(DELUGE_STATE_MAINTAIN);
     } else {
@@ -508,7 +657,7 @@ send_profile(struct deluge_object *obj)
 
     msg = (struct deluge_msg_profile *)buf;
     msg->cmd = DELUGE_CMD_PROFILE;
-    msg->version = obj->version;
+    msg->version = SERVED_VERSION(*obj);
     msg->npages = OBJECT_PAGE_COUNT(*obj);
     msg->object_id = obj->object_id;
     for(i = 0; i < msg->npages; i++) {
@@ -573,9 +722,16 @@ handle_profile(struct deluge_msg_profile *msg)
 
   transition(DELUGE_STATE_RX);
 
+#if DELUGE_BULK_TRANSFER
+  /* Wait for a summary to pick a source */
+  ctimer_stop(&rx_timer);
+  bulk_release_rx();
+  bulk_available = 0;
+#else
   ctimer_set(&rx_timer,
 	CONST_OMEGA * ESTIMATED_TX_TIME + ((unsigned)random_rand() % T_R),
 	send_request, obj);
+#endif
 }
 
 static void
@@ -596,8 +752,9 @@ command_dispatcher(const linkaddr_t *sender)
       handle_summary((struct deluge_msg_summary *)msg, sender);
     break;
   case DELUGE_CMD_REQUEST:
+  case DELUGE_CMD_BULK_REQUEST:
     if(len >= sizeof(struct deluge_msg_request))
-      handle_request((struct deluge_msg_request *)msg);
+      handle_request((struct deluge_msg_request *)msg, sender);
     break;
   case DELUGE_CMD_PACKET:
     if(len >= sizeof(struct deluge_msg_packet))
@@ -685,6 +842,11 @@ PROCESS_THREAD(deluge_process, ev, data)
   }
 
 exit:
+#if DELUGE_BULK_TRANSFER
+  ctimer_stop(&bulk_timer);
+  bulk_release_tx(NULL);
+  bulk_release_rx();
+#endif
   unicast_close(&deluge_uc);
   broadcast_close(&deluge_broadcast);
   if(current_object.cfs_fd >= 0) {
@@ -83,6 +83,8 @@ PROCESS_NAME(deluge_process);
 #define DELUGE_CMD_REQUEST	2
 #define DELUGE_CMD_PACKET	3
 #define DELUGE_CMD_PROFILE	4
+/* A request from a node listening in cells reserved for the transfer. */
+#define DELUGE_CMD_BULK_REQUEST	5
 
 #define DELUGE_STATE_MAINTAIN	1
 #define DELUGE_STATE_RX		2
@@ -94,6 +96,27 @@ PROCESS_NAME(deluge_process);
 #define CONST_OMEGA		8
 #define ESTIMATED_TX_TIME	(CLOCK_SECOND)
 
+/* Bulk transfer mode, for scheduled MACs such as TSCH. Pages are
+   unicast to the requester instead of broadcast, and a node serves a
+   page as soon as it has it rather than once it has the whole object:
+   it forwards page N while it receives page N+1. A node sticks to one
+   source, and with DELUGE_CALLBACK_BULK_RESERVE and
+   DELUGE_CALLBACK_BULK_RELEASE, both ends of a transfer reserve MAC
+   cells for it. */
+#ifdef DELUGE_CONF_BULK_TRANSFER
+#define DELUGE_BULK_TRANSFER	DELUGE_CONF_BULK_TRANSFER
+#else
+#define DELUGE_BULK_TRANSFER	0
+#endif
+
+/* Random interval for bulk requests of the next page in jiffies. */
+#define T_BULK_R		(CLOCK_SECOND / 2)
+/* Interval between bulk requests for the same page in jiffies. */
+#define T_BULK_RETRY		(2 * ESTIMATED_TX_TIME)
+/* Cells reserved for sending are released after this long without
+   requests, in jiffies. */
+#define T_BULK_IDLE		(CLOCK_SECOND * 30)
+
 typedef uint8_t deluge_object_id_t;
 
 struct deluge_msg_summary {
@@ -48,6 +48,10 @@
 #include "deployment.h"
 #endif /* WITH_DEPLOYMENT */
 
+#if WITH_LOG_LATENCY
+#include "net/mac/tsch/tsch-private.h"
+#endif /* WITH_LOG_LATENCY */
+
 #if WITH_LOG
 
 #if WITH_RPL
@@ -147,6 +151,142 @@ log_appdataptr(void *dataptr)
   printf("\n");
 
 }
+#if WITH_LOG_LATENCY
+/* Per-flow end-to-end latency statistics, at the root */
+struct latency_flow {
+  uint16_t src;
+  uint16_t count;
+  uint16_t deadline_misses;
+  uint16_t max;
+  uint32_t sum;
+  uint16_t hist[LOG_LATENCY_HIST_BINS];
+};
+static struct latency_flow latency_flows[LOG_LATENCY_MAX_FLOWS];
+/* Per-hop queueing delay statistics (all flows), at the root */
+static uint32_t hop_queueing_sum[LOG_LATENCY_MAX_HOPS];
+static uint16_t hop_queueing_count[LOG_LATENCY_MAX_HOPS];
+
+/* Slots elapsed since generation, saturated to 16 bits */
+static uint16_t
+latency_since(uint32_t gen_asn)
+{
+  uint32_t diff = current_asn.ls4b - gen_asn;
+  return diff > 0xffff ? 0xffff : (uint16_t)diff;
+}
+/* Stamp the generation ASN and clear the trace */
+void
+log_latency_init(struct app_data *data)
+{
+  data->gen_asn = UIP_HTONL(current_asn.ls4b);
+  memset(data->trace, 0, sizeof(data->trace));
+}
+/* Stamp the enqueue ASN for the current hop */
+void
+log_latency_stamp_enqueue(void *dataptr)
+{
+  struct app_data data;
+  if(dataptr != NULL) {
+    appdata_copy(&data, dataptr);
+    if(data.hop < LOG_LATENCY_MAX_HOPS) {
+      data.trace[data.hop].enqueue = UIP_HTONS(latency_since(UIP_HTONL(data.gen_asn)));
+      appdata_copy(dataptr, &data);
+    }
+  }
+}
+/* Stamp the dequeue ASN for the current hop */
+void
+log_latency_stamp_dequeue(void *dataptr)
+{
+  struct app_data data;
+  if(dataptr != NULL) {
+    appdata_copy(&data, dataptr);
+    if(data.hop < LOG_LATENCY_MAX_HOPS) {
+      data.trace[data.hop].dequeue = UIP_HTONS(latency_since(UIP_HTONL(data.gen_asn)));
+      appdata_copy(dataptr, &data);
+    }
+  }
+}
+/* At the root: account a received packet */
+void
+log_latency_record(void *dataptr)
+{
+  struct app_data data;
+  struct latency_flow *f = NULL;
+  uint16_t latency;
+  uint16_t src;
+  int i;
+  int bin;
+
+  if(dataptr == NULL) {
+    return;
+  }
+  appdata_copy(&data, dataptr);
+  if(data.magic != UIP_HTONL(LOG_MAGIC)) {
+    return;
+  }
+  latency = latency_since(UIP_HTONL(data.gen_asn));
+  src = UIP_HTONS(data.src);
+
+  /* Look up the flow, or take a free entry, or replace the one with least packets */
+  for(i = 0; i < LOG_LATENCY_MAX_FLOWS; i++) {
+    if(latency_flows[i].count != 0 && latency_flows[i].src == src) {
+      f = &latency_flows[i];
+      break;
+    }
+    if(f == NULL || latency_flows[i].count < f->count) {
+      f = &latency_flows[i];
+    }
+  }
+  if(f->count == 0 || f->src != src) {
+    memset(f, 0, sizeof(struct latency_flow));
+    f->src = src;
+  }
+
+  /* Update flow statistics */
+  f->count++;
+  f->sum += latency;
+  f->max = MAX(f->max, latency);
+  if(latency > LOG_LATENCY_DEADLINE) {
+    f->deadline_misses++;
+  }
+  for(bin = 0; bin < LOG_LATENCY_HIST_BINS - 1 && ((uint32_t)latency + 1) >> (bin + 1) != 0; bin++);
+  f->hist[bin]++;
+
+  /* Update per-hop queueing delays */
+  for(i = 0; i < MIN(data.hop, LOG_LATENCY_MAX_HOPS); i++) {
+    uint16_t enqueue = UIP_HTONS(data.trace[i].enqueue);
+    uint16_t dequeue = UIP_HTONS(data.trace[i].dequeue);
+    if(dequeue >= enqueue) {
+      hop_queueing_sum[i] += dequeue - enqueue;
+      hop_queueing_count[i]++;
+    }
+  }
+}
+/* Print per-flow latency histograms and per-hop queueing delays */
+void
+log_latency_print()
+{
+  int i;
+  for(i = 0; i < LOG_LATENCY_MAX_FLOWS; i++) {
+    struct latency_flow *f = &latency_flows[i];
+    if(f->count != 0) {
+      int bin;
+      printf("Latency: flow %u n %u avg %lu max %u miss %u hist",
+          f->src, f->count, (unsigned long)(f->sum / f->count), f->max, f->deadline_misses);
+      for(bin = 0; bin < LOG_LATENCY_HIST_BINS; bin++) {
+        printf(" %u", f->hist[bin]);
+      }
+      printf("\n");
+    }
+  }
+  for(i = 0; i < LOG_LATENCY_MAX_HOPS; i++) {
+    if(hop_queueing_count[i] != 0) {
+      printf("Latency: hop %u n %u avg queueing %lu\n", i, hop_queueing_count[i],
+          (unsigned long)(hop_queueing_sum[i] / hop_queueing_count[i]));
+    }
+  }
+}
+#endif /* WITH_LOG_LATENCY */
 PROCESS(log_process, "Logging process");
 /* Starts logging process */
 void
@@ -169,6 +309,9 @@ PROCESS_THREAD(log_process, ev, data)
 #if WITH_RPL
     rpl_print_neighbor_list();
 #endif /* WITH_RPL */
+#if WITH_LOG_LATENCY
+    log_latency_print();
+#endif /* WITH_LOG_LATENCY */
   }
 
   PROCESS_END();
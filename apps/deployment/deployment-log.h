@@ -42,6 +42,42 @@
 /* Used to identify packets carrying RPL log */
 #define LOG_MAGIC 0xcafebabe
 
+#if WITH_LOG_LATENCY
+
+/* Max number of hops traced in a packet. Further hops are only
+ * accounted for in the end-to-end latency. */
+#ifdef LOG_CONF_LATENCY_MAX_HOPS
+#define LOG_LATENCY_MAX_HOPS LOG_CONF_LATENCY_MAX_HOPS
+#else
+#define LOG_LATENCY_MAX_HOPS 4
+#endif
+
+/* Max number of flows (sources) the root keeps latency statistics for */
+#ifdef LOG_CONF_LATENCY_MAX_FLOWS
+#define LOG_LATENCY_MAX_FLOWS LOG_CONF_LATENCY_MAX_FLOWS
+#else
+#define LOG_LATENCY_MAX_FLOWS 16
+#endif
+
+/* Number of latency histogram bins. Bin i counts latencies in [2^i-1, 2^(i+1)-1[
+ * slots, the last one counts everything above */
+#define LOG_LATENCY_HIST_BINS 12
+
+/* End-to-end deadline in slots; packets above are counted as misses */
+#ifdef LOG_CONF_LATENCY_DEADLINE
+#define LOG_LATENCY_DEADLINE LOG_CONF_LATENCY_DEADLINE
+#else
+#define LOG_LATENCY_DEADLINE 0xffff
+#endif
+
+/* Per-hop trace, in slots since the packet generation (network byte order) */
+struct app_hop_trace {
+  uint16_t enqueue; /* enqueued in the MAC at this hop */
+  uint16_t dequeue; /* last transmission attempt at this hop */
+};
+
+#endif /* WITH_LOG_LATENCY */
+
 /* Data structure copied at the end of all data packets, making it possible
  * to trace packets at every hop, from every layer. */
 struct app_data {
@@ -52,6 +88,10 @@ struct app_data {
   uint8_t hop;
   uint8_t ping;
   uint16_t dummy_for_padding;
+#if WITH_LOG_LATENCY
+  uint32_t gen_asn; /* ASN (4 lsb) at generation (network byte order) */
+  struct app_hop_trace trace[LOG_LATENCY_MAX_HOPS];
+#endif /* WITH_LOG_LATENCY */
 };
 
 /* Copy an appdata to another with no assumption that the addresses are aligned */
@@ -71,6 +111,24 @@ void log_start();
 /* Print all neighbors (RPL "parents"), their link metric and rank */
 void rpl_print_neighbor_list();
 
+#if WITH_LOG_LATENCY
+/* Stamp the generation ASN and clear the trace */
+void log_latency_init(struct app_data *data);
+/* Stamp the enqueue ASN for the current hop (dataptr may be unaligned) */
+void log_latency_stamp_enqueue(void *dataptr);
+/* Stamp the dequeue ASN for the current hop (dataptr may be unaligned) */
+void log_latency_stamp_dequeue(void *dataptr);
+/* At the root: account a received packet in the per-flow and per-hop statistics */
+void log_latency_record(void *dataptr);
+/* Print per-flow latency histograms and per-hop queueing delays */
+void log_latency_print();
+#define LOG_LATENCY_STAMP_ENQUEUE(dataptr) log_latency_stamp_enqueue(dataptr)
+#define LOG_LATENCY_STAMP_DEQUEUE(dataptr) log_latency_stamp_dequeue(dataptr)
+#else /* WITH_LOG_LATENCY */
+#define LOG_LATENCY_STAMP_ENQUEUE(dataptr)
+#define LOG_LATENCY_STAMP_DEQUEUE(dataptr)
+#endif /* WITH_LOG_LATENCY */
+
 #if WITH_DEPLOYMENT
 //#define LOG(...) printf(__VA_ARGS__)
 #define LOG(...) 
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Root-side topology store, as flat arrays indexed by node id
+ */
+
+#include <string.h>
+#include "lib/topology.h"
+
+/* 12 bytes per node. A node is in the store iff its lifetime is not 0. */
+static uint16_t parent[TOPOLOGY_MAX_NODES];
+static uint16_t first_child[TOPOLOGY_MAX_NODES];
+static uint16_t next_sibling[TOPOLOGY_MAX_NODES];
+static uint16_t prev_sibling[TOPOLOGY_MAX_NODES];
+static uint32_t lifetime[TOPOLOGY_MAX_NODES];
+static uint16_t num_nodes;
+
+#define VALID_ID(id) ((id) != TOPOLOGY_NONE && (id) < TOPOLOGY_MAX_NODES)
+/*---------------------------------------------------------------------------*/
+/* Unlinks a node from the children of its parent */
+static void
+unlink_node(uint16_t id)
+{
+  uint16_t p = parent[id];
+  if(p == TOPOLOGY_NONE) {
+    return;
+  }
+  if(prev_sibling[id] != TOPOLOGY_NONE) {
+    next_sibling[prev_sibling[id]] = next_sibling[id];
+  } else {
+    first_child[p] = next_sibling[id];
+  }
+  if(next_sibling[id] != TOPOLOGY_NONE) {
+    prev_sibling[next_sibling[id]] = prev_sibling[id];
+  }
+  parent[id] = TOPOLOGY_NONE;
+  next_sibling[id] = TOPOLOGY_NONE;
+  prev_sibling[id] = TOPOLOGY_NONE;
+}
+/*---------------------------------------------------------------------------*/
+void
+topology_init(void)
+{
+  memset(parent, 0, sizeof(parent));
+  memset(first_child, 0, sizeof(first_child));
+  memset(next_sibling, 0, sizeof(next_sibling));
+  memset(prev_sibling, 0, sizeof(prev_sibling));
+  memset(lifetime, 0, sizeof(lifetime));
+  num_nodes = 0;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+topology_num_nodes(void)
+{
+  return num_nodes;
+}
+/*---------------------------------------------------------------------------*/
+int
+topology_has_node(uint16_t id)
+{
+  return VALID_ID(id) && lifetime[id] != 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+topology_add_node(uint16_t id, uint32_t l)
+{
+  if(!VALID_ID(id) || l == 0) {
+    return 0;
+  }
+  if(lifetime[id] == 0) {
+    num_nodes++;
+  }
+  lifetime[id] = l;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+topology_set_parent(uint16_t id, uint16_t p)
+{
+  uint16_t a;
+  int hops;
+
+  if(!topology_has_node(id) || (p != TOPOLOGY_NONE && !topology_has_node(p))) {
+    return 0;
+  }
+  if(parent[id] == p) {
+    return 1;
+  }
+  /* Loop check: id must not be an ancestor of the new parent */
+  for(a = p, hops = 0; a != TOPOLOGY_NONE && hops < num_nodes; a = parent[a], hops++) {
+    if(a == id) {
+      return 0;
+    }
+  }
+
+  unlink_node(id);
+  if(p != TOPOLOGY_NONE) {
+    parent[id] = p;
+    next_sibling[id] = first_child[p];
+    if(first_child[p] != TOPOLOGY_NONE) {
+      prev_sibling[first_child[p]] = id;
+    }
+    first_child[p] = id;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+topology_remove_node(uint16_t id)
+{
+  uint16_t c;
+  uint16_t next;
+
+  if(!topology_has_node(id)) {
+    return;
+  }
+  unlink_node(id);
+  for(c = first_child[id]; c != TOPOLOGY_NONE; c = next) {
+    next = next_sibling[c];
+    parent[c] = TOPOLOGY_NONE;
+    next_sibling[c] = TOPOLOGY_NONE;
+    prev_sibling[c] = TOPOLOGY_NONE;
+  }
+  first_child[id] = TOPOLOGY_NONE;
+  lifetime[id] = 0;
+  num_nodes--;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+topology_get_parent(uint16_t id)
+{
+  return VALID_ID(id) ? parent[id] : TOPOLOGY_NONE;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+topology_first_child(uint16_t id)
+{
+  return VALID_ID(id) ? first_child[id] : TOPOLOGY_NONE;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+topology_next_sibling(uint16_t id)
+{
+  return VALID_ID(id) ? next_sibling[id] : TOPOLOGY_NONE;
+}
+/*---------------------------------------------------------------------------*/
+int
+topology_get_path(uint16_t root, uint16_t id, uint16_t *path, int max)
+{
+  uint16_t a;
+  int len;
+  int i;
+
+  if(!topology_has_node(id) || !topology_has_node(root) || id == root) {
+    return 0;
+  }
+  /* Walk up once for the length, then fill in from the end */
+  for(a = id, len = 0; a != root; a = parent[a], len++) {
+    if(a == TOPOLOGY_NONE || len >= max) {
+      return 0;
+    }
+  }
+  if(path != NULL) {
+    for(a = id, i = len - 1; i >= 0; a = parent[a], i--) {
+      path[i] = a;
+    }
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+void
+topology_age(uint32_t seconds, void (*removed)(uint16_t id))
+{
+  unsigned id;
+  for(id = 1; id < TOPOLOGY_MAX_NODES; id++) {
+    if(lifetime[id] == 0 || lifetime[id] == TOPOLOGY_INFINITE_LIFETIME) {
+      continue;
+    }
+    if(lifetime[id] <= seconds) {
+      topology_remove_node(id);
+      if(removed != NULL) {
+        removed(id);
+      }
+    } else {
+      lifetime[id] -= seconds;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
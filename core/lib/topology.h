@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Root-side topology store: the tree of a network, as flat
+ *         arrays indexed by node id. Each node has a parent and a
+ *         doubly-linked list of children, so that setting a parent is
+ *         O(1) plus a loop check, and a path is rebuilt in O(1) per hop.
+ *         Meant for a border router: the RPL non-storing root fills it,
+ *         a centralized scheduler can walk it.
+ */
+
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include "contiki-conf.h"
+
+/* Node ids range from 1 to TOPOLOGY_MAX_NODES - 1 */
+#ifdef TOPOLOGY_CONF_MAX_NODES
+#define TOPOLOGY_MAX_NODES TOPOLOGY_CONF_MAX_NODES
+#else
+#define TOPOLOGY_MAX_NODES 64
+#endif
+
+/* No node, or no parent */
+#define TOPOLOGY_NONE 0
+/* Lifetime of nodes that never expire, e.g. the root */
+#define TOPOLOGY_INFINITE_LIFETIME 0xffffffff
+
+void topology_init(void);
+/* Number of nodes in the store */
+uint16_t topology_num_nodes(void);
+/* Is the node in the store? */
+int topology_has_node(uint16_t id);
+/* Adds the node if needed and sets its lifetime, in seconds.
+ * Returns 0 for an invalid id. */
+int topology_add_node(uint16_t id, uint32_t lifetime);
+/* Sets the parent of a node already added. Returns 0, leaving the
+ * node unchanged, if the parent is unknown or would create a loop. */
+int topology_set_parent(uint16_t id, uint16_t parent);
+/* Removes a node. Its children stay, without parent. */
+void topology_remove_node(uint16_t id);
+uint16_t topology_get_parent(uint16_t id);
+uint16_t topology_first_child(uint16_t id);
+uint16_t topology_next_sibling(uint16_t id);
+/* Fills path[] with the nodes from the child of root down to id.
+ * Returns the number of hops, or 0 if id is not below root or the
+ * path is longer than max. With path NULL, only counts the hops. */
+int topology_get_path(uint16_t root, uint16_t id, uint16_t *path, int max);
+/* Ages the nodes by the given number of seconds, removes the expired
+ * ones. Calls the callback, if any, for each removed node. */
+void topology_age(uint32_t seconds, void (*removed)(uint16_t id));
+
+#endif /* __TOPOLOGY_H__ */
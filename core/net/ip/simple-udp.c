@@ -54,6 +54,17 @@ static uint8_t databuffer[UIP_BUFSIZE];
 
 #define UIP_IP_BUF   ((struct uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
+/*---------------------------------------------------------------------------*/
+/* Leave the room left in the queue to the next hop to forwarded traffic */
+static int
+simple_udp_congested(const uip_ipaddr_t *to)
+{
+#if NETSTACK_CONF_WITH_IPV6
+  return tcpip_is_congested_to(to);
+#else
+  return tcpip_is_congested();
+#endif
+}
 /*---------------------------------------------------------------------------*/
 static void
 init_simple_udp(void)
@@ -68,10 +79,11 @@ int
 simple_udp_send(struct simple_udp_connection *c,
                 const void *data, uint16_t datalen)
 {
-  if(c->udp_conn != NULL) {
-    uip_udp_packet_sendto(c->udp_conn, data, datalen,
-                          &c->remote_addr, UIP_HTONS(c->remote_port));
+  if(c->udp_conn == NULL || simple_udp_congested(&c->remote_addr)) {
+    return -1;
   }
+  uip_udp_packet_sendto(c->udp_conn, data, datalen,
+                        &c->remote_addr, UIP_HTONS(c->remote_port));
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -80,10 +92,11 @@ simple_udp_sendto(struct simple_udp_connection *c,
                   const void *data, uint16_t datalen,
                   const uip_ipaddr_t *to)
 {
-  if(c->udp_conn != NULL) {
-    uip_udp_packet_sendto(c->udp_conn, data, datalen,
-                          to, UIP_HTONS(c->remote_port));
+  if(c->udp_conn == NULL || simple_udp_congested(to)) {
+    return -1;
   }
+  uip_udp_packet_sendto(c->udp_conn, data, datalen,
+                        to, UIP_HTONS(c->remote_port));
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -93,13 +106,50 @@ simple_udp_sendto_port(struct simple_udp_connection *c,
 		       const uip_ipaddr_t *to,
 		       uint16_t port)
 {
-  if(c->udp_conn != NULL) {
-    uip_udp_packet_sendto(c->udp_conn, data, datalen,
-                          to, UIP_HTONS(port));
+  if(c->udp_conn == NULL || simple_udp_congested(to)) {
+    return -1;
   }
+  uip_udp_packet_sendto(c->udp_conn, data, datalen,
+                        to, UIP_HTONS(port));
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+#if NETSTACK_CONF_WITH_IPV6
+int
+simple_udp_sendto_batch(struct simple_udp_connection *c,
+                        const struct simple_udp_datagram *datagrams,
+                        int count, const uip_ipaddr_t *to)
+{
+  uip_ipaddr_t curaddr;
+  uint16_t curport;
+  int sent = 0;
+
+  if(c->udp_conn != NULL && to != NULL) {
+    /* Address the connection once for the whole batch */
+    uip_ipaddr_copy(&curaddr, &c->udp_conn->ripaddr);
+    curport = c->udp_conn->rport;
+    uip_ipaddr_copy(&c->udp_conn->ripaddr, to);
+    c->udp_conn->rport = UIP_HTONS(c->remote_port);
+
+    /* Also stop as soon as layer 2 reports congestion, leaving the room
+       left to forwarded traffic */
+    while(sent < count && !tcpip_is_congested_to(to)) {
+      uip_udp_packet_send(c->udp_conn, datagrams[sent].data,
+                          datagrams[sent].datalen);
+      if(!tcpip_output_accepted()) {
+        /* The next ones would not make it either */
+        break;
+      }
+      sent++;
+    }
+
+    uip_ipaddr_copy(&c->udp_conn->ripaddr, &curaddr);
+    c->udp_conn->rport = curport;
+  }
+  return sent;
+}
+#endif /* NETSTACK_CONF_WITH_IPV6 */
+/*---------------------------------------------------------------------------*/
 int
 simple_udp_register(struct simple_udp_connection *c,
                     uint16_t local_port,
@@ -49,6 +49,9 @@
  * The default Contiki UDP API is difficult to use. The simple-udp
  * module provides a significantly simpler API.
  *
+ * Nothing is sent while the next hop is congested, see
+ * tcpip_is_congested_to() and tcpip_congestion_event.
+ *
  * @{
  */
 
@@ -67,6 +70,12 @@ typedef void (* simple_udp_callback)(struct simple_udp_connection *c,
                                      uint16_t dest_port,
                                      const uint8_t *data, uint16_t datalen);
 
+/** A datagram of a batch, see simple_udp_sendto_batch() */
+struct simple_udp_datagram {
+  const void *data;
+  uint16_t datalen;
+};
+
 /** Simple UDP connection */
 struct simple_udp_connection {
   struct simple_udp_connection *next;
@@ -113,6 +122,10 @@ int simple_udp_register(struct simple_udp_connection *c,
  *     specified when the connection was registered with
  *     simple_udp_register().
  *
+ * \retval 0   If the packet was handed to the IP stack
+ * \retval -1  If it was dropped: no connection, or the next hop is
+ *             congested (see tcpip_is_congested_to())
+ *
  * \sa simple_udp_sendto()
  */
 int simple_udp_send(struct simple_udp_connection *c,
@@ -130,6 +143,9 @@ int simple_udp_send(struct simple_udp_connection *c,
  *     that were specified when the connection was registered
  *     with simple_udp_register().
  *
+ * \retval 0   If the packet was handed to the IP stack
+ * \retval -1  If it was dropped, see simple_udp_send()
+ *
  * \sa simple_udp_send()
  */
 int simple_udp_sendto(struct simple_udp_connection *c,
@@ -149,12 +165,45 @@ int simple_udp_sendto(struct simple_udp_connection *c,
  *     UDP ports that were specified when the connection was
  *     registered with simple_udp_register().
  *
+ * \retval 0   If the packet was handed to the IP stack
+ * \retval -1  If it was dropped, see simple_udp_send()
+ *
  * \sa simple_udp_sendto()
  */
 int simple_udp_sendto_port(struct simple_udp_connection *c,
 			   const void *data, uint16_t datalen,
 			   const uip_ipaddr_t *to, uint16_t to_port);
 
+/**
+ * \brief      Send a batch of UDP packets to a specified IP address
+ * \param c    A pointer to a struct simple_udp_connection
+ * \param datagrams The datagrams to be sent, in order
+ * \param count The number of datagrams
+ * \param to   The IP address of the receiver
+ * \return     The number of datagrams accepted by the link layer
+ *
+ *     This function sends count UDP packets to a specified IP
+ *     address, with the UDP ports that were specified when the
+ *     connection was registered with simple_udp_register(). It
+ *     stops at the first datagram the link layer does not accept,
+ *     e.g. because the MAC queue is full, or once the next hop is
+ *     congested (see tcpip_is_congested_to()), so that the caller can
+ *     send the remaining ones, starting with datagrams[return
+ *     value], later on. A datagram queued until neighbor discovery
+ *     completes counts as accepted.
+ *
+ *     With SICSLOWPAN_CONF_HC06_CACHE, only the first datagram is
+ *     compressed in full: the next ones reuse its 6LoWPAN header from
+ *     the flow cache, only the UDP checksum is updated.
+ *
+ * \sa simple_udp_sendto()
+ */
+#if NETSTACK_CONF_WITH_IPV6
+int simple_udp_sendto_batch(struct simple_udp_connection *c,
+                            const struct simple_udp_datagram *datagrams,
+                            int count, const uip_ipaddr_t *to);
+#endif /* NETSTACK_CONF_WITH_IPV6 */
+
 void simple_udp_init(void);
 
 #endif /* SIMPLE_UDP_H */
@@ -68,11 +68,16 @@ void uip_log(char *msg);
 extern struct uip_fallback_interface UIP_FALLBACK_INTERFACE;
 #endif
 
+#ifdef TCPIP_CALLBACK_NBR_CONGESTED
+int TCPIP_CALLBACK_NBR_CONGESTED(const linkaddr_t *addr);
+#endif
+
 #if UIP_CONF_IPV6_RPL
 #include "rpl/rpl.h"
 #endif
 
 process_event_t tcpip_event;
+process_event_t tcpip_congestion_event;
 #if UIP_CONF_ICMP6
 process_event_t tcpip_icmp6_event;
 #endif /* UIP_CONF_ICMP6 */
@@ -111,15 +116,20 @@ enum {
 
 static uint8_t (* outputfunc)(const uip_lladdr_t *a);
 
+/* Result of the last layer 2 output, see tcpip_output_accepted() */
+static uint8_t output_accepted;
+
 uint8_t
 tcpip_output(const uip_lladdr_t *a)
 {
   int ret;
   if(outputfunc != NULL) {
     ret = outputfunc(a);
+    output_accepted = ret != 0;
     return ret;
   }
   UIP_LOG("tcpip_output: Use tcpip_set_outputfunc() to set an output function");
+  output_accepted = 0;
   return 0;
 }
 
@@ -128,6 +138,12 @@ tcpip_set_outputfunc(uint8_t (*f)(const uip_lladdr_t *))
 {
   outputfunc = f;
 }
+
+uint8_t
+tcpip_output_accepted(void)
+{
+  return output_accepted;
+}
 #else
 
 static uint8_t (* outputfunc)(void);
@@ -367,6 +383,56 @@ tcpip_icmp6_call(uint8_t type)
 }
 #endif /* UIP_CONF_ICMP6 */
 /*---------------------------------------------------------------------------*/
+static uint8_t congested;
+
+void
+tcpip_set_congested(uint8_t c)
+{
+  if(c != congested) {
+    congested = c;
+    process_post(PROCESS_BROADCAST, tcpip_congestion_event, NULL);
+  }
+}
+
+uint8_t
+tcpip_is_congested(void)
+{
+  return congested;
+}
+#if NETSTACK_CONF_WITH_IPV6
+/*---------------------------------------------------------------------------*/
+uint8_t
+tcpip_is_congested_to(const uip_ipaddr_t *dest)
+{
+#ifdef TCPIP_CALLBACK_NBR_CONGESTED
+  uip_ipaddr_t *nexthop;
+  uip_ds6_route_t *route;
+  const uip_lladdr_t *lladdr;
+
+  if(uip_is_addr_mcast(dest)) {
+    return TCPIP_CALLBACK_NBR_CONGESTED(&linkaddr_null);
+  }
+  /* Next hop determination, as in tcpip_ipv6_output */
+  if(uip_ds6_is_addr_onlink((uip_ipaddr_t *)dest)) {
+    nexthop = (uip_ipaddr_t *)dest;
+  } else {
+#if UIP_CONF_ROUTER
+    route = uip_ds6_route_lookup((uip_ipaddr_t *)dest);
+#else
+    route = NULL;
+#endif
+    nexthop = route != NULL ? uip_ds6_route_nexthop(route) : uip_ds6_defrt_choose();
+  }
+  lladdr = nexthop != NULL ? uip_ds6_nbr_lladdr_from_ipaddr(nexthop) : NULL;
+  /* Unknown next hop: neighbor discovery first, nothing queued yet */
+  return lladdr != NULL
+    && TCPIP_CALLBACK_NBR_CONGESTED((const linkaddr_t *)lladdr);
+#else /* TCPIP_CALLBACK_NBR_CONGESTED */
+  return congested;
+#endif /* TCPIP_CALLBACK_NBR_CONGESTED */
+}
+#endif /* NETSTACK_CONF_WITH_IPV6 */
+/*---------------------------------------------------------------------------*/
 static void
 eventhandler(process_event_t ev, process_data_t data)
 {
@@ -541,6 +607,12 @@ tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
   uip_ipaddr_t *nexthop;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+  uip_ipaddr_t srh_nexthop;
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
+
+  /* Until handed to layer 2 */
+  output_accepted = 0;
 
   if(uip_len == 0) {
     return;
@@ -576,6 +648,14 @@ tcpip_ipv6_output(void)
       route = NULL;
 #endif
 
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+      /* RPL non-storing mode: the root inserts a source routing header,
+         the nodes follow it */
+      if(route == NULL && rpl_srh_get_next_hop(&srh_nexthop)) {
+        nexthop = &srh_nexthop;
+        LOGU("Tcpip: fw to %d (source route) (%u bytes)", LOG_NODEID_FROM_IPADDR(nexthop), uip_len);
+      } else
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
       /* No route was found - we send to the default route instead. */
       if(route == NULL) {
         PRINTF("tcpip_ipv6_output: no route found, using default route\n");
@@ -662,27 +742,33 @@ tcpip_ipv6_output(void)
         uip_len = 0;
         return;
       } else {
-#if UIP_CONF_IPV6_QUEUE_PKT
-        /* Copy outgoing pkt in the queuing buffer for later transmit. */
-        if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
-          memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
-          uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
-        }
-#endif
       /* RFC4861, 7.2.2:
        * "If the source address of the packet prompting the solicitation is the
        * same as one of the addresses assigned to the outgoing interface, that
        * address SHOULD be placed in the IP Source Address of the outgoing
        * solicitation.  Otherwise, any one of the addresses assigned to the
        * interface should be used."*/
-       if(uip_ds6_is_my_addr(&UIP_IP_BUF->srcipaddr)){
-          uip_nd6_ns_output(&UIP_IP_BUF->srcipaddr, NULL, &nbr->ipaddr);
+        uip_ipaddr_t ns_src;
+        int ns_src_is_mine = uip_ds6_is_my_addr(&UIP_IP_BUF->srcipaddr);
+        uint8_t queued = 0;
+        uip_ipaddr_copy(&ns_src, &UIP_IP_BUF->srcipaddr);
+#if UIP_CONF_IPV6_QUEUE_PKT
+        /* Queue outgoing pkt for later transmit. uip_buf may not hold
+           it anymore. */
+        queued = uip_packetqueue_store(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME);
+#endif
+        if(ns_src_is_mine) {
+          uip_nd6_ns_output(&ns_src, NULL, &nbr->ipaddr);
         } else {
           uip_nd6_ns_output(NULL, NULL, &nbr->ipaddr);
         }
 
         stimer_set(&nbr->sendns, uip_ds6_if.retrans_timer / 1000);
         nbr->nscount = 1;
+        /* A packet waiting for neighbor discovery counts as accepted:
+           it is sent on its own once the neighbor answers. Set after
+           the NS, whose output overwrote output_accepted. */
+        output_accepted = queued;
       }
 #endif /* UIP_ND6_SEND_NA */
     } else {
@@ -690,12 +776,10 @@ tcpip_ipv6_output(void)
       if(nbr->state == NBR_INCOMPLETE) {
         PRINTF("tcpip_ipv6_output: nbr cache entry incomplete\n");
 #if UIP_CONF_IPV6_QUEUE_PKT
-        /* Copy outgoing pkt in the queuing buffer for later transmit and set
-           the destination nbr to nbr. */
-        if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
-          memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
-          uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
-        }
+        /* Queue outgoing pkt for later transmit to nbr. Accepted, as
+           above. */
+        output_accepted = uip_packetqueue_store(&nbr->packethandle,
+                                                UIP_DS6_NBR_PACKET_LIFETIME);
 #endif /*UIP_CONF_IPV6_QUEUE_PKT*/
         uip_len = 0;
         return;
@@ -720,9 +804,7 @@ tcpip_ipv6_output(void)
        * to STALE, and you must both send a NA and the queued packet.
        */
       if(uip_packetqueue_buflen(&nbr->packethandle) != 0) {
-        uip_len = uip_packetqueue_buflen(&nbr->packethandle);
-        memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-        uip_packetqueue_free(&nbr->packethandle);
+        uip_packetqueue_restore(&nbr->packethandle);
         tcpip_output(uip_ds6_nbr_get_ll(nbr));
       }
 #endif /*UIP_CONF_IPV6_QUEUE_PKT*/
@@ -819,6 +901,7 @@ PROCESS_THREAD(tcpip_process, ev, data)
 #if UIP_CONF_ICMP6
   tcpip_icmp6_event = process_alloc_event();
 #endif /* UIP_CONF_ICMP6 */
+  tcpip_congestion_event = process_alloc_event();
   etimer_set(&periodic, CLOCK_SECOND / 2);
 
   uip_init();
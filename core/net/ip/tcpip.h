@@ -320,6 +320,43 @@ void tcpip_icmp6_call(uint8_t type);
  */
 CCIF extern process_event_t tcpip_event;
 
+/**
+ * The congestion event.
+ *
+ * This event is broadcast to all processes when layer 2 becomes
+ * congested or no longer is, see tcpip_set_congested(). Senders
+ * should then check tcpip_is_congested() and slow down or resume,
+ * e.g. sample less often.
+ */
+CCIF extern process_event_t tcpip_congestion_event;
+
+/**
+ * \brief Report whether layer 2 is congested, e.g. its queues
+ * above a high watermark
+ *
+ *             Called by the MAC layer, e.g. through
+ *             TSCH_CALLBACK_QUEUE_CONGESTION. Posts
+ *             tcpip_congestion_event on changes. simple-udp does not
+ *             send while tcpip_is_congested_to() the destination.
+ */
+void tcpip_set_congested(uint8_t congested);
+
+/**
+ * \brief Is layer 2 congested? See tcpip_set_congested()
+ */
+uint8_t tcpip_is_congested(void);
+
+/**
+ * \brief Is the next hop to a destination congested?
+ *
+ *             With TCPIP_CALLBACK_NBR_CONGESTED, a function of the MAC
+ *             layer that tells whether the queue to a link-layer
+ *             address is full enough, the answer is per next hop, so
+ *             that a dead parent does not block traffic to other
+ *             neighbors. Otherwise, tcpip_is_congested().
+ */
+uint8_t tcpip_is_congested_to(const uip_ipaddr_t *dest);
+
 /**
  * \name TCP/IP packet processing
  * @{
@@ -353,6 +390,18 @@ void tcpip_set_outputfunc(uint8_t (* f)(void));
  */
 #if NETSTACK_CONF_WITH_IPV6
 void tcpip_ipv6_output(void);
+
+/**
+ * \brief Whether the last packet sent was accepted by layer 2
+ * \retval 0 The packet was dropped, e.g. for lack of a route, or
+ *           refused by layer 2, e.g. because its queue was full
+ * \retval 1 Layer 2 accepted the packet for transmission, or it was
+ *           queued until neighbor discovery completes
+ *
+ *             Lets a sender that produces several packets in a row
+ *             stop when layer 2 cannot take more.
+ */
+uint8_t tcpip_output_accepted(void);
 #endif
 
 /**
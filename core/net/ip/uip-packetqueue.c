@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "net/ip/uip.h"
 
@@ -24,6 +25,9 @@ packet_timedout(void *ptr)
   struct uip_packetqueue_handle *h = ptr;
 
   PRINTF("uip_packetqueue_free timed out %p\n", h);
+#if UIP_PACKET_POOL
+  uip_pktbuf_free(h->packet->buf);
+#endif /* UIP_PACKET_POOL */
   memb_free(&packets_memb, h->packet);
   h->packet = NULL;
 }
@@ -44,6 +48,15 @@ uip_packetqueue_alloc(struct uip_packetqueue_handle *handle, clock_time_t lifeti
     return NULL;
   }
   handle->packet = memb_alloc(&packets_memb);
+#if UIP_PACKET_POOL
+  if(handle->packet != NULL) {
+    handle->packet->buf = uip_pktbuf_alloc();
+    if(handle->packet->buf == NULL) {
+      memb_free(&packets_memb, handle->packet);
+      handle->packet = NULL;
+    }
+  }
+#endif /* UIP_PACKET_POOL */
   if(handle->packet != NULL) {
     ctimer_set(&handle->packet->lifetimer, lifetime,
                packet_timedout, handle);
@@ -59,6 +72,9 @@ uip_packetqueue_free(struct uip_packetqueue_handle *handle)
   PRINTF("uip_packetqueue_free %p\n", handle);
   if(handle->packet != NULL) {
     ctimer_stop(&handle->packet->lifetimer);
+#if UIP_PACKET_POOL
+    uip_pktbuf_free(handle->packet->buf);
+#endif /* UIP_PACKET_POOL */
     memb_free(&packets_memb, handle->packet);
     handle->packet = NULL;
   }
@@ -67,7 +83,11 @@ uip_packetqueue_free(struct uip_packetqueue_handle *handle)
 uint8_t *
 uip_packetqueue_buf(struct uip_packetqueue_handle *h)
 {
+#if UIP_PACKET_POOL
+  return h->packet != NULL? &h->packet->buf->u8[UIP_LLH_LEN]: NULL;
+#else /* UIP_PACKET_POOL */
   return h->packet != NULL? h->packet->queue_buf: NULL;
+#endif /* UIP_PACKET_POOL */
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
@@ -84,3 +104,35 @@ uip_packetqueue_set_buflen(struct uip_packetqueue_handle *h, uint16_t len)
   }
 }
 /*---------------------------------------------------------------------------*/
+int
+uip_packetqueue_store(struct uip_packetqueue_handle *h, clock_time_t lifetime)
+{
+  if(uip_packetqueue_alloc(h, lifetime) == NULL) {
+    return 0;
+  }
+#if UIP_PACKET_POOL
+  /* The queue takes uip_buf, and uip_buf the empty buffer of the queue */
+  h->packet->buf = uip_pktbuf_swap(h->packet->buf);
+#else /* UIP_PACKET_POOL */
+  memcpy(h->packet->queue_buf, &uip_buf[UIP_LLH_LEN], uip_len);
+#endif /* UIP_PACKET_POOL */
+  h->packet->queue_buf_len = uip_len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_packetqueue_restore(struct uip_packetqueue_handle *h)
+{
+  if(h->packet == NULL) {
+    return 0;
+  }
+  uip_len = h->packet->queue_buf_len;
+#if UIP_PACKET_POOL
+  h->packet->buf = uip_pktbuf_swap(h->packet->buf);
+#else /* UIP_PACKET_POOL */
+  memcpy(&uip_buf[UIP_LLH_LEN], h->packet->queue_buf, uip_len);
+#endif /* UIP_PACKET_POOL */
+  uip_packetqueue_free(h);
+  return uip_len;
+}
+/*---------------------------------------------------------------------------*/
@@ -7,7 +7,11 @@ struct uip_packetqueue_handle;
 
 struct uip_packetqueue_packet {
   struct uip_ds6_queued_packet *next;
+#if UIP_PACKET_POOL
+  uip_buf_t *buf;
+#else /* UIP_PACKET_POOL */
   uint8_t queue_buf[UIP_BUFSIZE - UIP_LLH_LEN];
+#endif /* UIP_PACKET_POOL */
   uint16_t queue_buf_len;
   struct ctimer lifetimer;
   struct uip_packetqueue_handle *handle;
@@ -31,5 +35,10 @@ uint8_t *uip_packetqueue_buf(struct uip_packetqueue_handle *h);
 uint16_t uip_packetqueue_buflen(struct uip_packetqueue_handle *h);
 void uip_packetqueue_set_buflen(struct uip_packetqueue_handle *h, uint16_t len);
 
+/* Queues the packet in uip_buf, returns 0 if there is no room for it */
+int uip_packetqueue_store(struct uip_packetqueue_handle *h, clock_time_t lifetime);
+/* Moves the queued packet to uip_buf and sets uip_len, returns uip_len */
+uint16_t uip_packetqueue_restore(struct uip_packetqueue_handle *h);
+
 
 #endif /* UIP_PACKETQUEUE_H */
@@ -518,8 +518,29 @@ typedef union {
   uint8_t u8[UIP_BUFSIZE];
 } uip_buf_t;
 
+#if UIP_PACKET_POOL
+CCIF extern uip_buf_t *uip_bufptr;
+#define uip_buf (uip_bufptr->u8)
+
+/**
+ * Allocates a buffer from the packet pool, NULL if none is left.
+ */
+uip_buf_t *uip_pktbuf_alloc(void);
+
+/**
+ * Returns a buffer to the packet pool.
+ */
+void uip_pktbuf_free(uip_buf_t *buf);
+
+/**
+ * Makes buf the uip_buf, and returns the previous one. This moves a
+ * packet in or out of uip_buf without copying it.
+ */
+uip_buf_t *uip_pktbuf_swap(uip_buf_t *buf);
+#else /* UIP_PACKET_POOL */
 CCIF extern uip_buf_t uip_aligned_buf;
 #define uip_buf (uip_aligned_buf.u8)
+#endif /* UIP_PACKET_POOL */
 
 
 /** @} */
@@ -2222,6 +2243,30 @@ uint16_t uip_udpchksum(void);
  */
 uint16_t uip_icmp6chksum(void);
 
+/**
+ * Update a checksum after one 16-bit word it covers has changed,
+ * without summing the packet again (RFC 1624).
+ *
+ * All three values are taken as they are in the packet, i.e., in
+ * network byte order. Used by the IPv6 stack.
+ *
+ * \param chksum The checksum field before the change.
+ * \param old_word The 16-bit word before the change.
+ * \param new_word The 16-bit word after the change.
+ *
+ * \return The new value of the checksum field.
+ */
+uint16_t uip_chksum_update(uint16_t chksum, uint16_t old_word, uint16_t new_word);
+
+#if UIP_ARCH_CHKSUM_WORDS
+/**
+ * Architecture-specific inner loop of the IPv6 checksum: the plain
+ * 32-bit sum of n 16-bit words as they are in memory. words is 16-bit
+ * aligned. Enabled by defining UIP_ARCH_CHKSUM_WORDS to 1.
+ */
+uint32_t uip_arch_chksum_words(const uint16_t *words, uint16_t n);
+#endif /* UIP_ARCH_CHKSUM_WORDS */
+
 
 #endif /* UIP_H_ */
 
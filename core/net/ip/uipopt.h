@@ -175,6 +175,28 @@
 #define UIP_BUFSIZE (UIP_CONF_BUFFER_SIZE)
 #endif /* UIP_CONF_BUFFER_SIZE */
 
+/**
+ * Packet buffer pool (IPv6 only). uip_buf is then one of
+ * UIP_PACKET_POOL_SIZE buffers, and the packets that wait in the stack
+ * (queued during address resolution, or being reassembled by 6LoWPAN)
+ * keep their own buffer, handed over to and from uip_buf without
+ * copying. The pool replaces the dedicated buffers of the queue and of
+ * the reassembly contexts.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_PACKET_POOL
+#define UIP_PACKET_POOL UIP_CONF_PACKET_POOL
+#else /* UIP_CONF_PACKET_POOL */
+#define UIP_PACKET_POOL 0
+#endif /* UIP_CONF_PACKET_POOL */
+
+#ifdef UIP_CONF_PACKET_POOL_SIZE
+#define UIP_PACKET_POOL_SIZE UIP_CONF_PACKET_POOL_SIZE
+#else /* UIP_CONF_PACKET_POOL_SIZE */
+#define UIP_PACKET_POOL_SIZE 4
+#endif /* UIP_CONF_PACKET_POOL_SIZE */
+
 
 /**
  * Determines if statistics support should be compiled in.
@@ -584,6 +606,58 @@ void uip_log(char *msg);
 #define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS 1
 #endif
 
+/**
+ * Do we learn address contexts from 6LoWPAN Context Options, in RAs
+ * and RPL DIOs, and advertise ours in DIOs (default: no). Contexts
+ * then have a lifetime, and a prefix of 64 to 128 bits.
+ */
+#ifdef SICSLOWPAN_CONF_DYNAMIC_CONTEXTS
+#define SICSLOWPAN_DYNAMIC_CONTEXTS (SICSLOWPAN_CONF_DYNAMIC_CONTEXTS)
+#else
+#define SICSLOWPAN_DYNAMIC_CONTEXTS 0
+#endif
+
+/**
+ * With dynamic contexts, does the RPL root allocate /128 contexts to
+ * the addresses it most often sees carried inline, e.g. external
+ * servers (default: no)
+ */
+#if defined(SICSLOWPAN_CONF_CONTEXT_ALLOC) && SICSLOWPAN_DYNAMIC_CONTEXTS
+#define SICSLOWPAN_CONTEXT_ALLOC (SICSLOWPAN_CONF_CONTEXT_ALLOC)
+#else
+#define SICSLOWPAN_CONTEXT_ALLOC 0
+#endif
+
+/**
+ * Number of inline addresses per minute, as seen by the root, for
+ * which a context is allocated
+ */
+#ifdef SICSLOWPAN_CONF_CONTEXT_ALLOC_THRESHOLD
+#define SICSLOWPAN_CONTEXT_ALLOC_THRESHOLD (SICSLOWPAN_CONF_CONTEXT_ALLOC_THRESHOLD)
+#else
+#define SICSLOWPAN_CONTEXT_ALLOC_THRESHOLD 8
+#endif
+
+/**
+ * Lifetime of an allocated context, in minutes, refreshed while in
+ * use. Must be longer than the largest DIO interval.
+ */
+#ifdef SICSLOWPAN_CONF_CONTEXT_ALLOC_LIFETIME
+#define SICSLOWPAN_CONTEXT_ALLOC_LIFETIME (SICSLOWPAN_CONF_CONTEXT_ALLOC_LIFETIME)
+#else
+#define SICSLOWPAN_CONTEXT_ALLOC_LIFETIME 30
+#endif
+
+/**
+ * Time, in minutes, for which the root advertises a new context
+ * before compressing with it, so that it reaches the network first
+ */
+#ifdef SICSLOWPAN_CONF_CONTEXT_ALLOC_WAIT
+#define SICSLOWPAN_CONTEXT_ALLOC_WAIT (SICSLOWPAN_CONF_CONTEXT_ALLOC_WAIT)
+#else
+#define SICSLOWPAN_CONTEXT_ALLOC_WAIT 2
+#endif
+
 /**
  * Do we support 6lowpan fragmentation
  */
@@ -591,6 +665,56 @@ void uip_log(char *msg);
 #define SICSLOWPAN_CONF_FRAG  0
 #endif
 
+/**
+ * How many fragmented packets can be reassembled concurrently. Each
+ * reassembly context has its own UIP_BUFSIZE buffer (default: 1)
+ */
+#ifdef SICSLOWPAN_CONF_REASS_CONTEXTS
+#define SICSLOWPAN_REASS_CONTEXTS (SICSLOWPAN_CONF_REASS_CONTEXTS)
+#else
+#define SICSLOWPAN_REASS_CONTEXTS 1
+#endif
+
+/**
+ * Do routers forward fragments as they arrive, instead of reassembling
+ * the packet and fragmenting it again (default: no)
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARDING
+#define SICSLOWPAN_FRAG_FORWARDING (SICSLOWPAN_CONF_FRAG_FORWARDING)
+#else
+#define SICSLOWPAN_FRAG_FORWARDING 0
+#endif
+
+/**
+ * With fragment forwarding, how many packets can be forwarded
+ * concurrently, i.e. the size of the fragment switching table
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FWD_ENTRIES
+#define SICSLOWPAN_FRAG_FWD_ENTRIES (SICSLOWPAN_CONF_FRAG_FWD_ENTRIES)
+#else
+#define SICSLOWPAN_FRAG_FWD_ENTRIES 4
+#endif
+
+/**
+ * With IPHC, how many flows keep their compressed header, to be
+ * reused by the next packets of the flow (default: 0, no cache)
+ */
+#ifdef SICSLOWPAN_CONF_HC06_CACHE
+#define SICSLOWPAN_HC06_CACHE (SICSLOWPAN_CONF_HC06_CACHE)
+#else
+#define SICSLOWPAN_HC06_CACHE 0
+#endif
+
+/**
+ * Longest compressed header kept in the IPHC flow cache. Flows with
+ * longer headers, e.g. with full inline addresses, are not cached.
+ */
+#ifdef SICSLOWPAN_CONF_HC06_CACHE_HDR_LEN
+#define SICSLOWPAN_HC06_CACHE_HDR_LEN (SICSLOWPAN_CONF_HC06_CACHE_HDR_LEN)
+#else
+#define SICSLOWPAN_HC06_CACHE_HDR_LEN 16
+#endif
+
 /** @} */
 
 /*------------------------------------------------------------------------------*/
@@ -198,20 +198,50 @@ struct trickle_param {
  */
 #define SEQ_VAL_ADD(s, n) (((s) + (n)) % 0x8000)
 /*---------------------------------------------------------------------------*/
+/* Message Sets: bitmaps over the indices of the buffered messages */
+#if ROLL_TM_BUFF_NUM <= 8
+typedef uint8_t mcast_set_t;
+#elif ROLL_TM_BUFF_NUM <= 16
+typedef uint16_t mcast_set_t;
+#elif ROLL_TM_BUFF_NUM <= 32
+typedef uint32_t mcast_set_t;
+#else
+#error "ROLL_TM_BUFF_NUM must be at most 32"
+#endif
+
+/**
+ * \brief The set holding buffered message i only
+ */
+#define MCAST_SET_BIT(i) ((mcast_set_t)1 << (i))
+
+/**
+ * \brief The set of all buffered messages
+ */
+#define MCAST_SET_ALL ((mcast_set_t)(MCAST_SET_BIT(ROLL_TM_BUFF_NUM - 1) * 2 - 1))
+/*---------------------------------------------------------------------------*/
 /* Sliding Windows */
 struct sliding_window {
   seed_id_t seed_id;
   int16_t lower_bound;          /* lolipop */
   int16_t upper_bound;          /* lolipop */
   int16_t min_listed;           /* lolipop */
-  uint8_t flags;                /* Is used, Trickle param, Is listed */
+  mcast_set_t msgs;             /* Our buffered messages */
+  mcast_set_t listed;           /* Those listed in current ICMP message */
+  uint8_t flags;                /* Is used, Trickle param */
   uint8_t count;
+  uint8_t next;                 /* Next window in our hash bucket */
 };
 
+#if (ROLL_TM_WIN_BUCKETS & (ROLL_TM_WIN_BUCKETS - 1)) != 0
+#error "ROLL_TM_WIN_BUCKETS must be a power of two"
+#endif
+
+/* End of a hash bucket's window chain */
+#define WINDOW_NONE 0xFF
+
 #define SLIDING_WINDOW_U_BIT 0x80       /* Is used */
 #define SLIDING_WINDOW_M_BIT 0x40       /* Window trickle parametrization */
 #define SLIDING_WINDOW_L_BIT 0x20       /* Current ICMP message lists us */
-#define SLIDING_WINDOW_B_BIT 0x10       /* Used when updating bounds */
 
 /**
  * \brief Is Occupied sliding window location w
@@ -230,7 +260,6 @@ struct sliding_window {
  * w: pointer to a sliding window
  */
 #define SLIDING_WINDOW_IS_USED_CLR(w) ((w)->flags &= ~SLIDING_WINDOW_U_BIT)
-#define window_free(w) SLIDING_WINDOW_IS_USED_CLR(w)
 
 /**
  * \brief Set 'Is Seen' bit for window w
@@ -280,14 +309,19 @@ struct mcast_packet {
   uint16_t buff_len;
   uint16_t seq_val;             /* host-byte order */
   struct sliding_window *sw;    /* Pointer to the SW this packet belongs to */
-  uint8_t flags;                /* Is-Used, Must Send, Is Listed */
+  uint8_t flags;                /* Is-Used, Must Send */
   uint8_t buff[UIP_BUFSIZE - UIP_LLH_LEN];
 };
 
 /* Flag bits */
 #define MCAST_PACKET_U_BIT       0x80   /* Is Used */
 #define MCAST_PACKET_S_BIT       0x20   /* Must Send Next Pass */
-#define MCAST_PACKET_L_BIT       0x10   /* Is listed in ICMP message */
+
+/**
+ * \brief Index of packet p in the buffer, its bit in message sets
+ * p: pointer to a packet buffer
+ */
+#define MCAST_PACKET_INDEX(p) ((uint8_t)((p) - buffered_msgs))
 
 /* Fetch a pointer to the Seed ID of a buffered message p */
 #if ROLL_TM_SHORT_SEEDS
@@ -342,19 +376,15 @@ struct mcast_packet {
  * \brief Is the message p listed in current ICMP message?
  * p: pointer to a struct mcast_packet
  */
-#define MCAST_PACKET_IS_LISTED(p) ((p)->flags & MCAST_PACKET_L_BIT)
-
-/**
- * \brief Set 'Is Listed' bit for message p
- * p: pointer to a struct mcast_packet
- */
-#define MCAST_PACKET_LISTED_SET(p) ((p)->flags |= MCAST_PACKET_L_BIT)
+#define MCAST_PACKET_IS_LISTED(p) \
+    ((p)->sw->listed & MCAST_SET_BIT(MCAST_PACKET_INDEX(p)))
 
 /**
- * \brief Clear 'Is Listed' bit for message p
+ * \brief Add message p to its window's listed set
  * p: pointer to a struct mcast_packet
  */
-#define MCAST_PACKET_LISTED_CLR(p) ((p)->flags &= ~MCAST_PACKET_L_BIT)
+#define MCAST_PACKET_LISTED_SET(p) \
+    ((p)->sw->listed |= MCAST_SET_BIT(MCAST_PACKET_INDEX(p)))
 
 /**
  * \brief Free a multicast packet buffer
@@ -448,6 +478,10 @@ static struct roll_tm_stats stats;
 static struct trickle_param t[2];
 static struct sliding_window windows[ROLL_TM_WINS];
 static struct mcast_packet buffered_msgs[ROLL_TM_BUFF_NUM];
+/* Free buffers */
+static mcast_set_t free_msgs;
+/* Heads of the window chains, by hash of Seed ID and M */
+static uint8_t win_buckets[ROLL_TM_WIN_BUCKETS];
 /*---------------------------------------------------------------------------*/
 /* Temporary Stores */
 /*---------------------------------------------------------------------------*/
@@ -475,7 +509,9 @@ extern uint16_t uip_slen;
 /*---------------------------------------------------------------------------*/
 static void icmp_input(void);
 static void icmp_output(void);
-static void window_update_bounds(void);
+static void window_update_bounds(struct sliding_window *);
+static void window_free(struct sliding_window *);
+static void buffer_free(struct mcast_packet *);
 static void reset_trickle_timer(uint8_t);
 static void handle_timer(void *);
 /*---------------------------------------------------------------------------*/
@@ -483,6 +519,23 @@ static void handle_timer(void *);
 UIP_ICMP6_HANDLER(roll_tm_icmp_handler, ICMP6_ROLL_TM,
                   UIP_ICMP6_HANDLER_CODE_ANY, icmp_input);
 /*---------------------------------------------------------------------------*/
+/* Index of the first message in non-empty set s */
+static uint8_t
+mcast_set_first(mcast_set_t s)
+{
+#ifdef __GNUC__
+  return __builtin_ctzl(s);
+#else
+  uint8_t i = 0;
+
+  while(!(s & 1)) {
+    s >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+/*---------------------------------------------------------------------------*/
 /* Return a random number in [I/2, I), for a timer with Imin when the timer's
  * current number of doublings is d */
 static clock_time_t
@@ -543,6 +596,7 @@ handle_timer(void *ptr)
   struct trickle_param *param;
   clock_time_t diff_last;       /* Time diff from last pass */
   clock_time_t diff_start;      /* Time diff from interval start */
+  mcast_set_t set;
   uint8_t m;
 
   param = (struct trickle_param *)ptr;
@@ -578,10 +632,9 @@ handle_timer(void *ptr)
      (unsigned long)diff_last, (unsigned long)diff_start);
 
   /* Handle all buffered messages */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)
-       && (SLIDING_WINDOW_GET_M(locmpptr->sw) == m)) {
+  for(set = ~free_msgs & MCAST_SET_ALL; set != 0; set &= set - 1) {
+    locmpptr = &buffered_msgs[mcast_set_first(set)];
+    if(SLIDING_WINDOW_GET_M(locmpptr->sw) == m) {
 
       /*
        * if()
@@ -609,17 +662,17 @@ handle_timer(void *ptr)
                      TRICKLE_ACTIVE(param));
 
       if(locmpptr->dwell > TRICKLE_DWELL(param)) {
-        locmpptr->sw->count--;
+        locswptr = locmpptr->sw;
+        buffer_free(locmpptr);
         PRINTF("ROLL TM: M=%u Free Packet %u (%lu > %lu), Window now at %u\n",
                m, locmpptr->seq_val, locmpptr->dwell,
-               TRICKLE_DWELL(param), locmpptr->sw->count);
-        if(locmpptr->sw->count == 0) {
+               TRICKLE_DWELL(param), locswptr->count);
+        if(locswptr->count == 0) {
           PRINTF("ROLL TM: M=%u Free Window ", m);
-          PRINT_SEED(&locmpptr->sw->seed_id);
+          PRINT_SEED(&locswptr->seed_id);
           PRINTF("\n");
-          window_free(locmpptr->sw);
+          window_free(locswptr);
         }
-        MCAST_PACKET_FREE(locmpptr);
       } else if(MCAST_PACKET_TTL(locmpptr) > 0) {
         /* Handle multicast transmissions */
         if(locmpptr->active < TRICKLE_ACTIVE(param) &&
@@ -651,7 +704,10 @@ handle_timer(void *ptr)
   param->inconsistency = 0;
   param->c = 0;
 
-  window_update_bounds();
+  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
+      iterswptr--) {
+    window_update_bounds(iterswptr);
+  }
 
   /* Temporarily store 'now' in t_next */
   param->t_next = clock_time();
@@ -687,9 +743,24 @@ reset_trickle_timer(uint8_t index)
   ctimer_set(&t[index].ct, t[index].t_next, handle_timer, (void *)&t[index]);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Hash bucket of a Seed ID and M. The last two bytes of a Seed ID (the end
+ * of the IID for long ones) are the ones that differ most between seeds
+ */
+static uint8_t
+window_hash(const seed_id_t *s, uint8_t m)
+{
+  const uint8_t *b = (const uint8_t *)s;
+
+  return (b[sizeof(seed_id_t) - 2] ^ b[sizeof(seed_id_t) - 1] ^ m)
+         & (ROLL_TM_WIN_BUCKETS - 1);
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
-window_allocate()
+window_allocate(seed_id_t *s, uint8_t m)
 {
+  uint8_t *bucket;
+
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     if(!SLIDING_WINDOW_IS_USED(iterswptr)) {
@@ -697,22 +768,54 @@ window_allocate()
       iterswptr->lower_bound = -1;
       iterswptr->upper_bound = -1;
       iterswptr->min_listed = -1;
+      iterswptr->msgs = 0;
+      iterswptr->listed = 0;
+      iterswptr->flags = 0;
+      if(m) {
+        SLIDING_WINDOW_M_SET(iterswptr);
+      }
+      SLIDING_WINDOW_IS_USED_SET(iterswptr);
+      seed_id_cpy(&iterswptr->seed_id, s);
+
+      /* Insert at the head of its bucket */
+      bucket = &win_buckets[window_hash(s, m)];
+      iterswptr->next = *bucket;
+      *bucket = (uint8_t)(iterswptr - windows);
       return iterswptr;
     }
   }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static void
+window_free(struct sliding_window *w)
+{
+  uint8_t *i;
+
+  /* Unlink from its bucket */
+  for(i = &win_buckets[window_hash(&w->seed_id, SLIDING_WINDOW_GET_M(w))];
+      *i != WINDOW_NONE; i = &windows[*i].next) {
+    if(&windows[*i] == w) {
+      *i = w->next;
+      break;
+    }
+  }
+  SLIDING_WINDOW_IS_USED_CLR(w);
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_lookup(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
+  uint8_t i;
+
+  for(i = win_buckets[window_hash(s, m)]; i != WINDOW_NONE;
+      i = windows[i].next) {
+    iterswptr = &windows[i];
     VERBOSE_PRINTF("ROLL TM: M=%u (%u) ", SLIDING_WINDOW_GET_M(iterswptr), m);
     VERBOSE_PRINT_SEED(&iterswptr->seed_id);
     VERBOSE_PRINTF("\n");
-    if(seed_id_cmp(s, &iterswptr->seed_id) &&
-       SLIDING_WINDOW_GET_M(iterswptr) == m) {
+    if(SLIDING_WINDOW_GET_M(iterswptr) == m &&
+       seed_id_cmp(s, &iterswptr->seed_id)) {
       return iterswptr;
     }
   }
@@ -720,37 +823,43 @@ window_lookup(seed_id_t *s, uint8_t m)
 }
 /*---------------------------------------------------------------------------*/
 static void
-window_update_bounds()
+window_update_bounds(struct sliding_window *w)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    iterswptr->lower_bound = -1;
-  }
+  mcast_set_t set;
 
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      iterswptr = locmpptr->sw;
-      VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
-                     iterswptr->lower_bound, iterswptr->upper_bound,
-                     locmpptr->seq_val);
-      if(iterswptr->lower_bound < 0
-         || SEQ_VAL_IS_LT(locmpptr->seq_val, iterswptr->lower_bound)) {
-        iterswptr->lower_bound = locmpptr->seq_val;
-      }
-      if(iterswptr->upper_bound < 0 ||
-         SEQ_VAL_IS_GT(locmpptr->seq_val, iterswptr->upper_bound)) {
-        iterswptr->upper_bound = locmpptr->seq_val;
-      }
+  w->lower_bound = -1;
+
+  for(set = w->msgs; set != 0; set &= set - 1) {
+    locmpptr = &buffered_msgs[mcast_set_first(set)];
+    VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
+                   w->lower_bound, w->upper_bound, locmpptr->seq_val);
+    if(w->lower_bound < 0
+       || SEQ_VAL_IS_LT(locmpptr->seq_val, w->lower_bound)) {
+      w->lower_bound = locmpptr->seq_val;
+    }
+    if(w->upper_bound < 0 ||
+       SEQ_VAL_IS_GT(locmpptr->seq_val, w->upper_bound)) {
+      w->upper_bound = locmpptr->seq_val;
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Remove buffered message p from its window and return it to the free set */
+static void
+buffer_free(struct mcast_packet *p)
+{
+  p->sw->msgs &= ~MCAST_SET_BIT(MCAST_PACKET_INDEX(p));
+  p->sw->count--;
+  free_msgs |= MCAST_SET_BIT(MCAST_PACKET_INDEX(p));
+  MCAST_PACKET_FREE(p);
+}
+/*---------------------------------------------------------------------------*/
 static struct mcast_packet *
 buffer_reclaim()
 {
   struct sliding_window *largest = windows;
   struct mcast_packet *rv;
+  mcast_set_t set;
 
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
@@ -759,7 +868,7 @@ buffer_reclaim()
     }
   }
 
-  if(largest->count == 1) {
+  if(largest->count <= 1) {
     /* Can't reclaim last entry for a window and this is the largest window */
     return NULL;
   }
@@ -769,15 +878,13 @@ buffer_reclaim()
   PRINTF(" M=%u, count was %u\n",
          SLIDING_WINDOW_GET_M(largest), largest->count);
   /* Find the packet at the lowest bound for the largest window */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == largest) &&
-       SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
+  for(set = largest->msgs; set != 0; set &= set - 1) {
+    locmpptr = &buffered_msgs[mcast_set_first(set)];
+    if(SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
       rv = locmpptr;
       PRINTF("ROLL TM: Reclaim seq. val %u\n", locmpptr->seq_val);
-      MCAST_PACKET_FREE(rv);
-      largest->count--;
-      window_update_bounds();
+      buffer_free(rv);
+      window_update_bounds(largest);
       VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
                      largest->lower_bound, largest->upper_bound);
       return rv;
@@ -791,13 +898,10 @@ buffer_reclaim()
 static struct mcast_packet *
 buffer_allocate()
 {
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(!MCAST_PACKET_IS_USED(locmpptr)) {
-      return locmpptr;
-    }
+  if(free_msgs == 0) {
+    return NULL;
   }
-  return NULL;
+  return &buffered_msgs[mcast_set_first(free_msgs)];
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -806,6 +910,7 @@ icmp_output()
   struct sequence_list_header *sl;
   uint8_t *buffer;
   uint16_t payload_len;
+  mcast_set_t set;
 
   PRINTF("ROLL TM: ICMPv6 Out\n");
 
@@ -837,18 +942,15 @@ icmp_output()
 
       buffer = (uint8_t *)sl + sizeof(struct sequence_list_header);
 
-      for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-          locmpptr >= buffered_msgs; locmpptr--) {
-        if(MCAST_PACKET_IS_USED(locmpptr) &&
-           locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
-          if(locmpptr->sw == iterswptr) {
-            sl->seq_len++;
-            PRINTF(", %u", locmpptr->seq_val);
-            *buffer = (uint8_t)(locmpptr->seq_val >> 8);
-            buffer++;
-            *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
-            buffer++;
-          }
+      for(set = iterswptr->msgs; set != 0; set &= set - 1) {
+        locmpptr = &buffered_msgs[mcast_set_first(set)];
+        if(locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
+          sl->seq_len++;
+          PRINTF(", %u", locmpptr->seq_val);
+          *buffer = (uint8_t)(locmpptr->seq_val >> 8);
+          buffer++;
+          *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
+          buffer++;
         }
       }
       PRINTF(", Len=%u\n", sl->seq_len);
@@ -901,6 +1003,7 @@ accept(uint8_t in)
   seed_id_t *seed_ptr;
   uint8_t m;
   uint16_t seq_val;
+  mcast_set_t set;
 
   PRINTF("ROLL TM: Multicast I/O\n");
 
@@ -983,16 +1086,16 @@ accept(uint8_t in)
       UIP_MCAST6_STATS_ADD(mcast_dropped);
       return UIP_MCAST6_DROP;
     }
-    for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-        locmpptr >= buffered_msgs; locmpptr--) {
-      if(MCAST_PACKET_IS_USED(locmpptr) &&
-         locmpptr->sw == locswptr &&
-         SLIDING_WINDOW_GET_M(locmpptr->sw) == m &&
-         SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
-        /* Seen before , drop */
-        PRINTF("ROLL TM: Seen before\n");
-        UIP_MCAST6_STATS_ADD(mcast_dropped);
-        return UIP_MCAST6_DROP;
+    /* Past the upper bound, it is new: no need to look */
+    if(!SEQ_VAL_IS_GT(seq_val, locswptr->upper_bound)) {
+      for(set = locswptr->msgs; set != 0; set &= set - 1) {
+        if(SEQ_VAL_IS_EQ(seq_val,
+                         buffered_msgs[mcast_set_first(set)].seq_val)) {
+          /* Seen before , drop */
+          PRINTF("ROLL TM: Seen before\n");
+          UIP_MCAST6_STATS_ADD(mcast_dropped);
+          return UIP_MCAST6_DROP;
+        }
       }
     }
   }
@@ -1002,7 +1105,7 @@ accept(uint8_t in)
   /* We have not seen this message before */
   /* Allocate a window if we have to */
   if(!locswptr) {
-    locswptr = window_allocate();
+    locswptr = window_allocate(seed_ptr, m);
     PRINTF("ROLL TM: New seed\n");
   }
   if(!locswptr) {
@@ -1025,9 +1128,9 @@ accept(uint8_t in)
     PRINTF("ROLL TM: Buffer reclaim failed\n");
     if(locswptr->count == 0) {
       window_free(locswptr);
-      UIP_MCAST6_STATS_ADD(mcast_dropped);
-      return UIP_MCAST6_DROP;
     }
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
   }
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
@@ -1036,13 +1139,6 @@ accept(uint8_t in)
 #endif
 
   /* We have a window and we have a buffer. Accept this message */
-  /* Set the seed ID and correct M for this window */
-  SLIDING_WINDOW_M_CLR(locswptr);
-  if(m) {
-    SLIDING_WINDOW_M_SET(locswptr);
-  }
-  SLIDING_WINDOW_IS_USED_SET(locswptr);
-  seed_id_cpy(&locswptr->seed_id, seed_ptr);
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
   PRINTF(" M=%u, count=%u\n",
@@ -1068,6 +1164,8 @@ accept(uint8_t in)
   locmpptr->buff_len = uip_len;
   locmpptr->seq_val = seq_val;
   MCAST_PACKET_USED_SET(locmpptr);
+  free_msgs &= ~MCAST_SET_BIT(MCAST_PACKET_INDEX(locmpptr));
+  locswptr->msgs |= MCAST_SET_BIT(MCAST_PACKET_INDEX(locmpptr));
 
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
@@ -1103,6 +1201,7 @@ icmp_input()
   uint16_t *seq_ptr;
   uint16_t *end_ptr;
   uint16_t val;
+  mcast_set_t set;
 
 #if UIP_CONF_IPV6_CHECKS
   if(!uip_is_addr_link_local(&UIP_IP_BUF->srcipaddr)) {
@@ -1141,16 +1240,11 @@ icmp_input()
 
   ROLL_TM_STATS_ADD(icmp_in);
 
-  /* Reset Is-Listed bit for all windows */
+  /* Reset Is-Listed bit and listed messages for all windows */
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     SLIDING_WINDOW_LISTED_CLR(iterswptr);
-  }
-
-  /* Reset Is-Listed bit for all cached packets */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    MCAST_PACKET_LISTED_CLR(locmpptr);
+    iterswptr->listed = 0;
   }
 
   locslhptr = (struct sequence_list_header *)UIP_ICMP_PAYLOAD;
@@ -1227,23 +1321,21 @@ icmp_input()
 
           inconsistency = 1;
           /* Check if the advertised sequence is in our buffer */
-          for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-              locmpptr >= buffered_msgs; locmpptr--) {
-            if(MCAST_PACKET_IS_USED(locmpptr) && locmpptr->sw == locswptr) {
-              if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
-
-                inconsistency = 0;
-                MCAST_PACKET_LISTED_SET(locmpptr);
-                PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
-
-                /* Update lowest seq. num listed for this window
-                 * We need this to check for "we have new" */
-                if(locswptr->min_listed == -1 ||
-                   SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
-                  locswptr->min_listed = val;
-                }
-                break;
+          for(set = locswptr->msgs; set != 0; set &= set - 1) {
+            locmpptr = &buffered_msgs[mcast_set_first(set)];
+            if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
+
+              inconsistency = 0;
+              MCAST_PACKET_LISTED_SET(locmpptr);
+              PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
+
+              /* Update lowest seq. num listed for this window
+               * We need this to check for "we have new" */
+              if(locswptr->min_listed == -1 ||
+                 SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
+                locswptr->min_listed = val;
               }
+              break;
             }
           }
           if(inconsistency) {
@@ -1270,35 +1362,33 @@ icmp_input()
 
   /* Check for "We have new */
   PRINTF("ROLL TM: ICMPv6 In, Check our buffer\n");
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      locswptr = locmpptr->sw;
-      PRINTF("ROLL TM: ICMPv6 In, ");
-      PRINTF("Check %u, Seed L: %u, This L: %u Min L: %d\n",
-             locmpptr->seq_val, SLIDING_WINDOW_IS_LISTED(locswptr),
-             MCAST_PACKET_IS_LISTED(locmpptr), locswptr->min_listed);
-
-      /* Point to the sliding window's trickle param */
-      loctpptr = &t[SLIDING_WINDOW_GET_M(locswptr)];
-      if(!SLIDING_WINDOW_IS_LISTED(locswptr)) {
-        /* If a buffered packet's Seed ID was not listed */
-        PRINTF("ROLL TM: Inconsistency - Seed ID ");
-        PRINT_SEED(&locswptr->seed_id);
-        PRINTF(" was not listed\n");
+  for(set = ~free_msgs & MCAST_SET_ALL; set != 0; set &= set - 1) {
+    locmpptr = &buffered_msgs[mcast_set_first(set)];
+    locswptr = locmpptr->sw;
+    PRINTF("ROLL TM: ICMPv6 In, ");
+    PRINTF("Check %u, Seed L: %u, This L: %u Min L: %d\n",
+           locmpptr->seq_val, SLIDING_WINDOW_IS_LISTED(locswptr),
+           MCAST_PACKET_IS_LISTED(locmpptr), locswptr->min_listed);
+
+    /* Point to the sliding window's trickle param */
+    loctpptr = &t[SLIDING_WINDOW_GET_M(locswptr)];
+    if(!SLIDING_WINDOW_IS_LISTED(locswptr)) {
+      /* If a buffered packet's Seed ID was not listed */
+      PRINTF("ROLL TM: Inconsistency - Seed ID ");
+      PRINT_SEED(&locswptr->seed_id);
+      PRINTF(" was not listed\n");
+      loctpptr->inconsistency = 1;
+      MCAST_PACKET_SEND_SET(locmpptr);
+    } else {
+      /* This packet was not listed but a prior one was */
+      if(!MCAST_PACKET_IS_LISTED(locmpptr) &&
+         (locswptr->min_listed >= 0) &&
+         SEQ_VAL_IS_GT(locmpptr->seq_val, locswptr->min_listed)) {
+        PRINTF("ROLL TM: Inconsistency - ");
+        PRINTF("Seq. %u was not listed but %u was\n",
+               locmpptr->seq_val, locswptr->min_listed);
         loctpptr->inconsistency = 1;
         MCAST_PACKET_SEND_SET(locmpptr);
-      } else {
-        /* This packet was not listed but a prior one was */
-        if(!MCAST_PACKET_IS_LISTED(locmpptr) &&
-           (locswptr->min_listed >= 0) &&
-           SEQ_VAL_IS_GT(locmpptr->seq_val, locswptr->min_listed)) {
-          PRINTF("ROLL TM: Inconsistency - ");
-          PRINTF("Seq. %u was not listed but %u was\n",
-                 locmpptr->seq_val, locswptr->min_listed);
-          loctpptr->inconsistency = 1;
-          MCAST_PACKET_SEND_SET(locmpptr);
-        }
       }
     }
   }
@@ -1419,6 +1509,8 @@ init()
   memset(windows, 0, sizeof(windows));
   memset(buffered_msgs, 0, sizeof(buffered_msgs));
   memset(t, 0, sizeof(t));
+  memset(win_buckets, WINDOW_NONE, sizeof(win_buckets));
+  free_msgs = MCAST_SET_ALL;
 
   ROLL_TM_STATS_INIT();
   UIP_MCAST6_STATS_INIT(&stats);
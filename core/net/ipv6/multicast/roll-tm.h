@@ -166,11 +166,22 @@
 #define ROLL_TM_WINS 2
 #endif
 /*---------------------------------------------------------------------------*/
+/*
+ * Number of hash buckets for sliding window lookups by Seed ID and M.
+ * Must be a power of two, at most 128
+ */
+#ifdef ROLL_TM_CONF_WIN_BUCKETS
+#define ROLL_TM_WIN_BUCKETS ROLL_TM_CONF_WIN_BUCKETS
+#else
+#define ROLL_TM_WIN_BUCKETS 4
+#endif
+/*---------------------------------------------------------------------------*/
 /*
  * Maximum Number of Buffered Multicast Messages
  * This buffer is shared across all Seed IDs, therefore a new very active Seed
  * may eventually occupy all slots. It would make little sense (if any) to
  * define support for fewer buffered messages than seeds*2
+ * Message sets are bitmaps over the buffer: at most 32
  */
 #ifdef ROLL_TM_CONF_BUFF_NUM
 #define ROLL_TM_BUFF_NUM ROLL_TM_CONF_BUFF_NUM
@@ -68,6 +68,9 @@
 #include "net/rime/rime.h"
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl.h"
+#endif /* UIP_CONF_IPV6_RPL */
 
 #include <stdio.h>
 
@@ -152,6 +155,8 @@ void uip_log(char *msg);
 #define UIP_UDP_BUF          ((struct uip_udp_hdr *)&uip_buf[UIP_LLIPH_LEN])
 #define UIP_TCP_BUF          ((struct uip_tcp_hdr *)&uip_buf[UIP_LLIPH_LEN])
 #define UIP_ICMP_BUF          ((struct uip_icmp_hdr *)&uip_buf[UIP_LLIPH_LEN])
+/* First option of a hop-by-hop header */
+#define UIP_HBHO_OPT_RPL_BUF  ((struct uip_ext_hdr_opt_rpl *)&uip_buf[UIP_LLIPH_LEN + 2])
 /** @} */
 
 
@@ -211,9 +216,14 @@ static int packetbuf_payload_len;
 static uint8_t uncomp_hdr_len;
 
 /**
- * the result of the last transmitted fragment
+ * the result of the last transmitted fragment, MAC_TX_DEFERRED until the
+ * MAC reports it
  */
 static int last_tx_status;
+/** Whether the MAC refused the last frame right away, e.g. queue full */
+#define LAST_TX_REFUSED() ((last_tx_status == MAC_TX_COLLISION) || \
+                           (last_tx_status == MAC_TX_ERR) ||       \
+                           (last_tx_status == MAC_TX_ERR_FATAL))
 /** @} */
 
 #if SICSLOWPAN_CONF_FRAG
@@ -221,35 +231,85 @@ static int last_tx_status;
  *  @{
  */
 
-static uint16_t sicslowpan_len;
-
 /**
- * The buffer used for the 6lowpan reassembly.
- * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * A reassembly context. Fragments are matched to a context by
+ * (sender, tag, size).
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
+struct sicslowpan_reass {
+  /**
+   * The buffer used for the 6lowpan reassembly.
+   * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
+   * It has a fix size as we do not use dynamic memory allocation.
+   * With UIP_PACKET_POOL, it is a buffer of the pool, NULL if none.
+   */
+#if UIP_PACKET_POOL
+  uip_buf_t *buf;
+#define REASS_BUF(r) ((r)->buf->u8)
+#else /* UIP_PACKET_POOL */
+  uip_buf_t buf;
+#define REASS_BUF(r) ((r)->buf.u8)
+#endif /* UIP_PACKET_POOL */
+  /** The total length of the IPv6 packet in the buffer, 0 if the context is free */
+  uint16_t len;
+  /**
+   * length of the ip packet already received.
+   * It includes IP and transport headers.
+   */
+  uint16_t processed;
+  /** The tag in the fragments being merged. */
+  uint16_t tag;
+  /** The source address of the fragments being merged */
+  linkaddr_t sender;
+  /** Reassembly %process %timer. */
+  struct timer timer;
+};
+
+/** The pool of reassembly contexts */
+static struct sicslowpan_reass reass_contexts[SICSLOWPAN_REASS_CONTEXTS];
 
-/** The total length of the IPv6 packet in the sicslowpan_buf. */
+/** The context of the fragment being processed, NULL if not a fragment */
+static struct sicslowpan_reass *reass;
 
 /**
- * length of the ip packet already sent / received.
- * It includes IP and transport headers.
+ * The buffer the packet being processed is uncompressed into: the buffer of
+ * its reassembly context, or directly uip_buf if it is not fragmented.
  */
-static uint16_t processed_ip_in_len;
+static uint8_t *sicslowpan_buf;
+#define sicslowpan_len (reass->len)
+#define processed_ip_in_len (reass->processed)
 
 /** Datagram tag to be put in the fragments I send. */
 static uint16_t my_tag;
 
-/** When reassembling, the tag in the fragments being merged. */
-static uint16_t reass_tag;
+/** Reassembly statistics */
+struct sicslowpan_reass_stats sicslowpan_reass_stats;
 
-/** When reassembling, the source address of the fragments being merged */
-linkaddr_t frag_sender;
+#if SICSLOWPAN_FRAG_FORWARDING
+/**
+ * An entry of the fragment switching table: the fragments of a packet
+ * (sender, tag, size) we are forwarding fragment by fragment are sent to
+ * next_hop with our own tag.
+ */
+struct sicslowpan_frag_fwd {
+  /** The previous hop */
+  linkaddr_t sender;
+  /** The next hop */
+  linkaddr_t next_hop;
+  /** The tag in the fragments we receive */
+  uint16_t tag;
+  /** The tag in the fragments we send */
+  uint16_t out_tag;
+  /** The size of the packet, 0 if the entry is free */
+  uint16_t size;
+  /** length of the ip packet already forwarded */
+  uint16_t processed;
+  /** Expiration %timer */
+  struct timer timer;
+};
 
-/** Reassembly %process %timer. */
-static struct timer reass_timer;
+/** The fragment switching table */
+static struct sicslowpan_frag_fwd frag_fwd_table[SICSLOWPAN_FRAG_FWD_ENTRIES];
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
 
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
@@ -328,6 +388,30 @@ static struct sicslowpan_addr_context *context;
 /** pointer to the byte where to write next inline field. */
 static uint8_t *hc06_ptr;
 
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+/**
+ * A flow of the IPHC cache: the compressed header of the last packet
+ * sent with the same IPv6 header (but for the payload length), UDP
+ * ports and link-layer destination. Only the UDP checksum differs
+ * from one packet of the flow to the next.
+ */
+struct hc06_flow {
+  /** IPv6 header: version to flow label, then next header to dest. */
+  uint8_t ip_hdr[4 + UIP_IPH_LEN - 6];
+  /** UDP ports, if UDP */
+  uint8_t ports[4];
+  linkaddr_t link_destaddr;
+  /** The compressed header, 0 length if the entry is free */
+  uint8_t hdr[SICSLOWPAN_HC06_CACHE_HDR_LEN];
+  uint8_t hdr_len;
+  uint8_t uncomp_hdr_len;
+};
+
+static struct hc06_flow hc06_flows[SICSLOWPAN_HC06_CACHE];
+/** The entry replaced by the next new flow */
+static uint8_t hc06_flow_next;
+#endif /* SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR) */
+
 /* Uncompression of linklocal */
 /*   0 -> 16 bytes from packet  */
 /*   1 -> 2 bytes from prefix - bunch of zeroes and 8 from packet */
@@ -368,12 +452,33 @@ addr_context_lookup_by_prefix(uip_ipaddr_t *ipaddr)
 /* Remove code to avoid warnings and save flash if no context is used */
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
   int i;
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+  /* Longest match among the contexts usable for compression */
+  struct sicslowpan_addr_context *best = NULL;
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    if((addr_contexts[i].used == 1) &&
+       (addr_contexts[i].flags & SICSLOWPAN_CONTEXT_COMPRESS) &&
+       (best == NULL || addr_contexts[i].prefix_len > best->prefix_len) &&
+       uip_ipaddr_prefixcmp(&addr_contexts[i].prefix, ipaddr,
+                            addr_contexts[i].prefix_len)) {
+      best = &addr_contexts[i];
+    }
+  }
+#if SICSLOWPAN_CONTEXT_ALLOC
+  if(best != NULL && (best->flags & SICSLOWPAN_CONTEXT_ALLOCATED)) {
+    /* Allocated context in use: keep it */
+    best->lifetime = SICSLOWPAN_CONTEXT_ALLOC_LIFETIME;
+  }
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+  return best;
+#else /* SICSLOWPAN_DYNAMIC_CONTEXTS */
   for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
     if((addr_contexts[i].used == 1) &&
        uip_ipaddr_prefixcmp(&addr_contexts[i].prefix, ipaddr, 64)) {
       return &addr_contexts[i];
     }
   }
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
 #endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
   return NULL;
 }
@@ -388,6 +493,13 @@ addr_context_lookup_by_number(uint8_t number)
   for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
     if((addr_contexts[i].used == 1) &&
        addr_contexts[i].number == number) {
+#if SICSLOWPAN_CONTEXT_ALLOC
+      if((addr_contexts[i].flags & SICSLOWPAN_CONTEXT_ALLOCATED)
+         && (addr_contexts[i].flags & SICSLOWPAN_CONTEXT_COMPRESS)) {
+        /* Allocated context in use: keep it */
+        addr_contexts[i].lifetime = SICSLOWPAN_CONTEXT_ALLOC_LIFETIME;
+      }
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
       return &addr_contexts[i];
     }
   }
@@ -395,6 +507,335 @@ addr_context_lookup_by_number(uint8_t number)
   return NULL;
 }
 /*--------------------------------------------------------------------*/
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+/**
+ * \brief Drops all cached flows. To be called whenever the compression
+ * of a header may change, i.e. when address contexts change.
+ */
+static void
+hc06_cache_flush(void)
+{
+  memset(hc06_flows, 0, sizeof(hc06_flows));
+  hc06_flow_next = 0;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Finds the flow of the packet in uip_buf, NULL if none */
+static struct hc06_flow *
+hc06_cache_lookup(const linkaddr_t *link_destaddr)
+{
+  struct hc06_flow *f;
+  for(f = hc06_flows; f < hc06_flows + SICSLOWPAN_HC06_CACHE; f++) {
+    if(f->hdr_len > 0
+       && !memcmp(f->ip_hdr + 4, &UIP_IP_BUF->proto, UIP_IPH_LEN - 6)
+       && !memcmp(f->ip_hdr, &UIP_IP_BUF->vtc, 4)
+       && (UIP_IP_BUF->proto != UIP_PROTO_UDP
+           || !memcmp(f->ports, &UIP_UDP_BUF->srcport, 4))
+       && linkaddr_cmp(&f->link_destaddr, link_destaddr)) {
+      return f;
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Keeps the header just compressed, replacing the oldest flow */
+static void
+hc06_cache_add(const linkaddr_t *link_destaddr)
+{
+  struct hc06_flow *f;
+  if(packetbuf_hdr_len > SICSLOWPAN_HC06_CACHE_HDR_LEN) {
+    return;
+  }
+  f = &hc06_flows[hc06_flow_next];
+  hc06_flow_next = (hc06_flow_next + 1) % SICSLOWPAN_HC06_CACHE;
+  memcpy(f->ip_hdr, &UIP_IP_BUF->vtc, 4);
+  memcpy(f->ip_hdr + 4, &UIP_IP_BUF->proto, UIP_IPH_LEN - 6);
+  memcpy(f->ports, &UIP_UDP_BUF->srcport, 4);
+  linkaddr_copy(&f->link_destaddr, link_destaddr);
+  memcpy(f->hdr, packetbuf_ptr, packetbuf_hdr_len);
+  f->hdr_len = packetbuf_hdr_len;
+  f->uncomp_hdr_len = uncomp_hdr_len;
+}
+#endif /* SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR) */
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+/** Ages the contexts every minute */
+static struct ctimer context_timer;
+/** Set when the contexts change, for RPL to advertise them */
+static uint8_t context_update;
+
+#if SICSLOWPAN_CONTEXT_ALLOC
+/** An address seen inline at the root, candidate for a context */
+struct context_candidate {
+  uip_ipaddr_t addr;
+  /* Packets seen, halved every minute */
+  uint8_t count;
+};
+#define CONTEXT_CANDIDATES 4
+static struct context_candidate context_candidates[CONTEXT_CANDIDATES];
+static uint8_t context_alloc_enabled;
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+/*--------------------------------------------------------------------*/
+static void
+context_changed(void)
+{
+  context_update = 1;
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+  /* Cached headers may have been compressed with the old contexts */
+  hc06_cache_flush();
+#endif
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_context_updated(void)
+{
+  int ret = context_update;
+  context_update = 0;
+  return ret;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Overwrites the bits of an uncompressed address covered by
+ * the context beyond the first 64
+ */
+static void
+context_overlay(uip_ipaddr_t *ipaddr, const struct sicslowpan_addr_context *c)
+{
+  if(c->prefix_len > 64) {
+    memcpy(&ipaddr->u8[8], &c->prefix[8], (c->prefix_len - 64) >> 3);
+  }
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_context_input(const uint8_t *opt, int len)
+{
+  struct sicslowpan_addr_context *c;
+  uint8_t prefix_len;
+  uint8_t flags;
+  uint16_t lifetime;
+  int i;
+
+  /* Context Length | Res | C | CID | Reserved (16) | Valid Lifetime (16) | Prefix */
+  if(len < 6) {
+    return 0;
+  }
+  prefix_len = opt[0];
+  flags = (opt[1] & 0x10) ? SICSLOWPAN_CONTEXT_COMPRESS : 0;
+  lifetime = (opt[4] << 8) | opt[5];
+  if(prefix_len < 64 || prefix_len > 128 || (prefix_len & 7) != 0
+     || len < 6 + (prefix_len >> 3)) {
+    PRINTF("sicslowpan: unsupported context length %u\n", prefix_len);
+    return 0;
+  }
+
+  c = addr_context_lookup_by_number(opt[1] & 0x0f);
+  if(lifetime == 0) {
+    if(c != NULL) {
+      c->used = 0;
+      context_changed();
+    }
+    return 1;
+  }
+  if(c == NULL) {
+    for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+      if(addr_contexts[i].used == 0) {
+        c = &addr_contexts[i];
+        break;
+      }
+    }
+    if(c == NULL) {
+      PRINTF("sicslowpan: no room for context %u\n", opt[1] & 0x0f);
+      return 0;
+    }
+  }
+  if(c->used == 0 || c->prefix_len != prefix_len || c->flags != flags
+     || memcmp(c->prefix, opt + 6, prefix_len >> 3)) {
+    memset(c->prefix, 0, sizeof(c->prefix));
+    memcpy(c->prefix, opt + 6, prefix_len >> 3);
+    c->used = 1;
+    c->number = opt[1] & 0x0f;
+    c->prefix_len = prefix_len;
+    c->flags = flags;
+    context_changed();
+  }
+  c->lifetime = lifetime;
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_context_output(int i, uint8_t *opt)
+{
+  struct sicslowpan_addr_context *c;
+  uint16_t lifetime;
+  int prefix_bytes;
+
+  if(i < 0 || i >= SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS
+     || addr_contexts[i].used == 0) {
+    return 0;
+  }
+  c = &addr_contexts[i];
+  lifetime = c->lifetime;
+  if((c->flags & (SICSLOWPAN_CONTEXT_ALLOCATED | SICSLOWPAN_CONTEXT_RETIRING))
+     == SICSLOWPAN_CONTEXT_ALLOCATED) {
+    /* Not yet or still in use: receivers must keep it at least as
+       long as we may use it */
+    lifetime = SICSLOWPAN_CONTEXT_ALLOC_LIFETIME + SICSLOWPAN_CONTEXT_ALLOC_WAIT;
+  }
+  prefix_bytes = c->prefix_len > 64 ? 16 : 8;
+  opt[0] = c->prefix_len;
+  opt[1] = ((c->flags & SICSLOWPAN_CONTEXT_COMPRESS) ? 0x10 : 0) | c->number;
+  opt[2] = 0;
+  opt[3] = 0;
+  opt[4] = lifetime >> 8;
+  opt[5] = lifetime & 0xff;
+  memcpy(opt + 6, c->prefix, prefix_bytes);
+  return 6 + prefix_bytes;
+}
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_CONTEXT_ALLOC
+void
+sicslowpan_context_alloc_enable(int enable)
+{
+  context_alloc_enabled = enable;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Allocates a /128 context to addr. Returns 0 if none is free. */
+static int
+context_alloc(const uip_ipaddr_t *addr)
+{
+  struct sicslowpan_addr_context *c = NULL;
+  uint16_t numbers = 0;
+  uint8_t number;
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    if(addr_contexts[i].used) {
+      numbers |= 1 << addr_contexts[i].number;
+    } else if(c == NULL) {
+      c = &addr_contexts[i];
+    }
+  }
+  for(number = 0; number < 16 && (numbers & (1 << number)); number++);
+  if(c == NULL || number == 16) {
+    return 0;
+  }
+  c->used = 1;
+  c->number = number;
+  c->prefix_len = 128;
+  memcpy(c->prefix, addr, 16);
+  /* Advertised first, used for compression once it had time to spread */
+  c->flags = SICSLOWPAN_CONTEXT_ALLOCATED;
+  c->lifetime = SICSLOWPAN_CONTEXT_ALLOC_WAIT;
+  context_changed();
+  PRINTF("sicslowpan: allocated context %u to ", number);
+  PRINT6ADDR(addr);
+  PRINTF("\n");
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/** \brief An address was carried inline: count it, allocate a context
+ * if it is frequent enough */
+static void
+context_alloc_note(const uip_ipaddr_t *addr)
+{
+  struct context_candidate *cand;
+  struct context_candidate *min;
+
+  if(!context_alloc_enabled || uip_is_addr_mcast(addr)
+     || uip_is_addr_link_local(addr) || uip_is_addr_unspecified(addr)) {
+    return;
+  }
+  min = &context_candidates[0];
+  for(cand = context_candidates; cand < context_candidates + CONTEXT_CANDIDATES;
+      cand++) {
+    if(uip_ipaddr_cmp(&cand->addr, addr)) {
+      break;
+    }
+    if(cand->count < min->count) {
+      min = cand;
+    }
+  }
+  if(cand == context_candidates + CONTEXT_CANDIDATES) {
+    /* Replace the least frequent candidate */
+    cand = min;
+    uip_ipaddr_copy(&cand->addr, addr);
+    cand->count = 0;
+  }
+  if(++cand->count >= SICSLOWPAN_CONTEXT_ALLOC_THRESHOLD
+     && context_alloc(addr)) {
+    memset(cand, 0, sizeof(*cand));
+  }
+}
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+/*--------------------------------------------------------------------*/
+static void
+context_periodic(void *ptr)
+{
+  struct sicslowpan_addr_context *c;
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    c = &addr_contexts[i];
+    if(c->used == 0 || c->lifetime == SICSLOWPAN_CONTEXT_INFINITE_LIFETIME
+       || --c->lifetime > 0) {
+      continue;
+    }
+#if SICSLOWPAN_CONTEXT_ALLOC
+    if(c->flags & SICSLOWPAN_CONTEXT_ALLOCATED) {
+      if(!(c->flags & (SICSLOWPAN_CONTEXT_COMPRESS | SICSLOWPAN_CONTEXT_RETIRING))) {
+        /* Advertised long enough: start using it */
+        c->flags |= SICSLOWPAN_CONTEXT_COMPRESS;
+        c->lifetime = SICSLOWPAN_CONTEXT_ALLOC_LIFETIME;
+        context_changed();
+        continue;
+      } else if(c->flags & SICSLOWPAN_CONTEXT_COMPRESS) {
+        /* Unused: stop using it, but keep the number reserved until
+           the other nodes have dropped it */
+        c->flags = SICSLOWPAN_CONTEXT_ALLOCATED | SICSLOWPAN_CONTEXT_RETIRING;
+        c->lifetime = SICSLOWPAN_CONTEXT_ALLOC_LIFETIME + SICSLOWPAN_CONTEXT_ALLOC_WAIT;
+        context_changed();
+        continue;
+      }
+    }
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+    PRINTF("sicslowpan: context %u expired\n", c->number);
+    c->used = 0;
+    context_changed();
+  }
+
+#if SICSLOWPAN_CONTEXT_ALLOC
+  for(i = 0; i < CONTEXT_CANDIDATES; i++) {
+    context_candidates[i].count >>= 1;
+  }
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+
+  ctimer_reset(&context_timer);
+}
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+/**
+ * \brief Context bookkeeping of a packet whose header came from the
+ * flow cache, as compress_hdr_hc06() does it for the others: keeps
+ * the contexts in use alive and counts the addresses carried inline
+ */
+static void
+hc06_cache_note_contexts(void)
+{
+  if(!uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)
+     && addr_context_lookup_by_prefix(&UIP_IP_BUF->srcipaddr) == NULL) {
+#if SICSLOWPAN_CONTEXT_ALLOC
+    context_alloc_note(&UIP_IP_BUF->srcipaddr);
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+  }
+  if(!uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)
+     && addr_context_lookup_by_prefix(&UIP_IP_BUF->destipaddr) == NULL) {
+#if SICSLOWPAN_CONTEXT_ALLOC
+    context_alloc_note(&UIP_IP_BUF->destipaddr);
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+  }
+}
+#endif /* SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR) */
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+/*--------------------------------------------------------------------*/
 static uint8_t
 compress_addr_64(uint8_t bitpos, uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
 {
@@ -412,6 +853,19 @@ compress_addr_64(uint8_t bitpos, uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
     return 1 << bitpos; /* 64-bits */
   }
 }
+/*--------------------------------------------------------------------*/
+/* Compresses an address that matches the current context */
+static uint8_t
+compress_addr_context(uint8_t bitpos, uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
+{
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+  if(context->prefix_len == 128) {
+    /* The context is the whole address */
+    return 3 << bitpos; /* 0-bits */
+  }
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+  return compress_addr_64(bitpos, ipaddr, lladdr);
+}
 
 /*-------------------------------------------------------------------- */
 /* Uncompress addresses based on a prefix and a postfix with zeroes in
@@ -494,6 +948,9 @@ static void
 compress_hdr_hc06(linkaddr_t *link_destaddr)
 {
   uint8_t tmp, iphc0, iphc1;
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+  struct hc06_flow *flow;
+#endif
 #if DEBUG
   { uint16_t ndx;
     PRINTF("before compression (%d): ", UIP_IP_BUF->len[1]);
@@ -505,6 +962,26 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
   }
 #endif
 
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+  flow = hc06_cache_lookup(link_destaddr);
+  if(flow != NULL) {
+    /* Same header as the last packet of the flow: the UDP checksum,
+       if compressed, is the last field */
+    memcpy(packetbuf_ptr, flow->hdr, flow->hdr_len);
+    if(flow->hdr[0] & SICSLOWPAN_IPHC_NH_C) {
+      memcpy(packetbuf_ptr + flow->hdr_len - 2, &UIP_UDP_BUF->udpchksum, 2);
+    }
+    hc06_ptr = packetbuf_ptr + flow->hdr_len;
+    uncomp_hdr_len = flow->uncomp_hdr_len;
+    packetbuf_hdr_len = flow->hdr_len;
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+    /* Last, as allocating a context flushes the cache */
+    hc06_cache_note_contexts();
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+    return;
+  }
+#endif /* SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR) */
+
   hc06_ptr = packetbuf_ptr + 2;
   /*
    * As we copy some bit-length fields, in the IPHC encoding bytes,
@@ -633,8 +1110,8 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
     PACKETBUF_IPHC_BUF[2] |= context->number << 4;
     /* compession compare with this nodes address (source) */
 
-    iphc1 |= compress_addr_64(SICSLOWPAN_IPHC_SAM_BIT,
-                              &UIP_IP_BUF->srcipaddr, &uip_lladdr);
+    iphc1 |= compress_addr_context(SICSLOWPAN_IPHC_SAM_BIT,
+                                   &UIP_IP_BUF->srcipaddr, &uip_lladdr);
     /* No context found for this address */
   } else if(uip_is_addr_link_local(&UIP_IP_BUF->srcipaddr) &&
 	    UIP_IP_BUF->destipaddr.u16[1] == 0 &&
@@ -644,6 +1121,9 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
                               &UIP_IP_BUF->srcipaddr, &uip_lladdr);
   } else {
     /* send the full address => SAC = 0, SAM = 00 */
+#if SICSLOWPAN_CONTEXT_ALLOC
+    context_alloc_note(&UIP_IP_BUF->srcipaddr);
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
     iphc1 |= SICSLOWPAN_IPHC_SAM_00; /* 128-bits */
     memcpy(hc06_ptr, &UIP_IP_BUF->srcipaddr.u16[0], 16);
     hc06_ptr += 16;
@@ -684,7 +1164,7 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
       PACKETBUF_IPHC_BUF[2] |= context->number;
       /* compession compare with link adress (destination) */
 
-      iphc1 |= compress_addr_64(SICSLOWPAN_IPHC_DAM_BIT,
+      iphc1 |= compress_addr_context(SICSLOWPAN_IPHC_DAM_BIT,
 	       &UIP_IP_BUF->destipaddr, (uip_lladdr_t *)link_destaddr);
       /* No context found for this address */
     } else if(uip_is_addr_link_local(&UIP_IP_BUF->destipaddr) &&
@@ -695,6 +1175,9 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
                &UIP_IP_BUF->destipaddr, (uip_lladdr_t *)link_destaddr);
     } else {
       /* send the full address */
+#if SICSLOWPAN_CONTEXT_ALLOC
+      context_alloc_note(&UIP_IP_BUF->destipaddr);
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
       iphc1 |= SICSLOWPAN_IPHC_DAM_00; /* 128-bits */
       memcpy(hc06_ptr, &UIP_IP_BUF->destipaddr.u16[0], 16);
       hc06_ptr += 16;
@@ -764,6 +1247,9 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
   PACKETBUF_IPHC_BUF[1] = iphc1;
 
   packetbuf_hdr_len = hc06_ptr - packetbuf_ptr;
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+  hc06_cache_add(link_destaddr);
+#endif
   return;
 }
 
@@ -875,10 +1361,20 @@ uncompress_hdr_hc06(uint16_t ip_len)
     uncompress_addr(&SICSLOWPAN_IP_BUF->srcipaddr,
                     tmp != 0 ? context->prefix : NULL, unc_ctxconf[tmp],
                     (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+    if(tmp != 0) {
+      context_overlay(&SICSLOWPAN_IP_BUF->srcipaddr, context);
+    }
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
   } else {
     /* no compression and link local */
     uncompress_addr(&SICSLOWPAN_IP_BUF->srcipaddr, llprefix, unc_llconf[tmp],
                     (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+#if SICSLOWPAN_CONTEXT_ALLOC
+    if(tmp == 0) {
+      context_alloc_note(&SICSLOWPAN_IP_BUF->srcipaddr);
+    }
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
   }
 
   /* Destination address */
@@ -921,11 +1417,19 @@ uncompress_hdr_hc06(uint16_t ip_len)
       uncompress_addr(&SICSLOWPAN_IP_BUF->destipaddr, context->prefix,
                       unc_ctxconf[tmp],
                       (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+      context_overlay(&SICSLOWPAN_IP_BUF->destipaddr, context);
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
     } else {
       /* not context based => link local M = 0, DAC = 0 - same as SAC */
       uncompress_addr(&SICSLOWPAN_IP_BUF->destipaddr, llprefix,
                       unc_llconf[tmp],
                       (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+#if SICSLOWPAN_CONTEXT_ALLOC
+      if(tmp == 0) {
+        context_alloc_note(&SICSLOWPAN_IP_BUF->destipaddr);
+      }
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
     }
   }
   uncomp_hdr_len += UIP_IPH_LEN;
@@ -1358,6 +1862,7 @@ send_packet(linkaddr_t *dest)
 
   /* Provide a callback function to receive the result of
      a packet transmission. */
+  last_tx_status = MAC_TX_DEFERRED;
   NETSTACK_LLSEC.send(&packet_sent, NULL);
 
   /* If we are sending multiple packets in a row, we need to let the
@@ -1524,9 +2029,7 @@ output(const uip_lladdr_t *localdest)
     q = NULL;
 
     /* Check tx result. */
-    if((last_tx_status == MAC_TX_COLLISION) ||
-       (last_tx_status == MAC_TX_ERR) ||
-       (last_tx_status == MAC_TX_ERR_FATAL)) {
+    if(LAST_TX_REFUSED()) {
       PRINTFO("error in fragment tx, dropping subsequent fragments.\n");
       return 0;
     }
@@ -1571,9 +2074,7 @@ output(const uip_lladdr_t *localdest)
       processed_ip_out_len += packetbuf_payload_len;
 
       /* Check tx result. */
-      if((last_tx_status == MAC_TX_COLLISION) ||
-         (last_tx_status == MAC_TX_ERR) ||
-         (last_tx_status == MAC_TX_ERR_FATAL)) {
+      if(LAST_TX_REFUSED()) {
         PRINTFO("error in fragment tx, dropping subsequent fragments.\n");
         return 0;
       }
@@ -1592,10 +2093,357 @@ output(const uip_lladdr_t *localdest)
            uip_len - uncomp_hdr_len);
     packetbuf_set_datalen(uip_len - uncomp_hdr_len + packetbuf_hdr_len);
     send_packet(&dest);
+    if(LAST_TX_REFUSED()) {
+      PRINTFO("sicslowpan output: refused by the MAC\n");
+      return 0;
+    }
   }
   return 1;
 }
 
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_CONF_FRAG
+/** \brief Frees a reassembly context */
+static void
+reass_free(struct sicslowpan_reass *r)
+{
+  r->len = 0;
+  r->processed = 0;
+#if UIP_PACKET_POOL
+  uip_pktbuf_free(r->buf);
+  r->buf = NULL;
+#endif /* UIP_PACKET_POOL */
+}
+/*--------------------------------------------------------------------*/
+/** \brief Frees the reassembly contexts that timed out */
+static void
+reass_expire(void)
+{
+  int i;
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    if(reass_contexts[i].len > 0 && timer_expired(&reass_contexts[i].timer)) {
+      PRINTFI("sicslowpan input: reassembly timed out (tag %d)\n",
+              reass_contexts[i].tag);
+      reass_free(&reass_contexts[i]);
+      sicslowpan_reass_stats.timeouts++;
+    }
+  }
+#if SICSLOWPAN_FRAG_FORWARDING
+  for(i = 0; i < SICSLOWPAN_FRAG_FWD_ENTRIES; i++) {
+    if(frag_fwd_table[i].size > 0 && timer_expired(&frag_fwd_table[i].timer)) {
+      PRINTFI("sicslowpan input: fragment forwarding timed out (tag %d)\n",
+              frag_fwd_table[i].tag);
+      frag_fwd_table[i].size = 0;
+      sicslowpan_reass_stats.timeouts++;
+    }
+  }
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+}
+/*--------------------------------------------------------------------*/
+/** \brief Returns the reassembly context of a fragment, NULL if none */
+static struct sicslowpan_reass *
+reass_lookup(const linkaddr_t *sender, uint16_t tag, uint16_t size)
+{
+  int i;
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    if(reass_contexts[i].len == size
+       && reass_contexts[i].tag == tag
+       && linkaddr_cmp(&reass_contexts[i].sender, sender)) {
+      return &reass_contexts[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Allocates a reassembly context for a new packet (first fragment).
+ *
+ * An unfinished packet from the same sender is discarded, as the sender
+ * has moved on to another packet. If no context is free, we discard the
+ * oldest one: this lessens the negative impacts of too high
+ * SICSLOWPAN_REASS_MAXAGE.
+ */
+static struct sicslowpan_reass *
+reass_alloc(const linkaddr_t *sender, uint16_t tag, uint16_t size)
+{
+  struct sicslowpan_reass *r = NULL;
+  struct sicslowpan_reass *oldest = NULL;
+  int i;
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    struct sicslowpan_reass *c = &reass_contexts[i];
+    if(c->len > 0 && linkaddr_cmp(&c->sender, sender)) {
+      if(c->tag != tag || c->len != size) {
+        sicslowpan_reass_stats.aborts++;
+      }
+      reass_free(c);
+    }
+    if(c->len == 0) {
+      if(r == NULL) {
+        r = c;
+      }
+    } else if(oldest == NULL
+              || timer_remaining(&c->timer) < timer_remaining(&oldest->timer)) {
+      oldest = c;
+    }
+  }
+  if(r == NULL) {
+    PRINTFI("sicslowpan input: no free reassembly context, discarding tag %d\n",
+            oldest->tag);
+    r = oldest;
+    reass_free(r);
+    sicslowpan_reass_stats.aborts++;
+  }
+  r->len = size;
+  r->tag = tag;
+  linkaddr_copy(&r->sender, sender);
+  timer_set(&r->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
+  sicslowpan_reass_stats.started++;
+  return r;
+}
+#if SICSLOWPAN_FRAG_FORWARDING
+/*--------------------------------------------------------------------*/
+/** \brief Returns the switching table entry of a fragment, NULL if none */
+static struct sicslowpan_frag_fwd *
+frag_fwd_lookup(const linkaddr_t *sender, uint16_t tag, uint16_t size)
+{
+  int i;
+  for(i = 0; i < SICSLOWPAN_FRAG_FWD_ENTRIES; i++) {
+    if(frag_fwd_table[i].size == size
+       && frag_fwd_table[i].tag == tag
+       && linkaddr_cmp(&frag_fwd_table[i].sender, sender)) {
+      return &frag_fwd_table[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Returns a free switching table entry for a new packet, NULL if
+ * none. An unfinished packet from the same sender is discarded.
+ */
+static struct sicslowpan_frag_fwd *
+frag_fwd_alloc(const linkaddr_t *sender)
+{
+  struct sicslowpan_frag_fwd *e = NULL;
+  int i;
+  for(i = 0; i < SICSLOWPAN_FRAG_FWD_ENTRIES; i++) {
+    if(frag_fwd_table[i].size > 0
+       && linkaddr_cmp(&frag_fwd_table[i].sender, sender)) {
+      frag_fwd_table[i].size = 0;
+      sicslowpan_reass_stats.aborts++;
+    }
+    if(frag_fwd_table[i].size == 0 && e == NULL) {
+      e = &frag_fwd_table[i];
+    }
+  }
+  return e;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Sends the packetbuf to the link-layer address dest, with the
+ * same attributes as in output()
+ */
+static void
+frag_fwd_send(linkaddr_t *dest)
+{
+#ifndef WITHOUT_MAC_TX_ATTR
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
+                     SICSLOWPAN_MAX_MAC_TRANSMISSIONS);
+#endif /* WITHOUT_MAC_TX_ATTR */
+  send_packet(dest);
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forwards a first fragment to the next hop without reassembling
+ * the packet, and adds the packet to the switching table.
+ *
+ * The uncompressed headers and the payload of the fragment are in
+ * uip_buf. The fragment is forwarded only if the packet is to be routed
+ * and its headers can be updated in place, i.e. without changing its
+ * size. Otherwise, the packet is reassembled and forwarded by the IP
+ * layer as usual, as received: the fit is checked before the RPL option
+ * is verified and updated, as the IP layer would.
+ *
+ * \param tag The tag of the received fragment
+ * \param size The size of the packet
+ * \param len The length of the packet in uip_buf
+ * \return 1 if the fragment was forwarded or dropped, 0 otherwise
+ */
+static int
+frag_fwd_first(uint16_t tag, uint16_t size, uint16_t len)
+{
+  struct sicslowpan_frag_fwd *e;
+  uip_ipaddr_t *nexthop;
+  uip_ds6_route_t *route;
+  const uip_lladdr_t *lladdr;
+  linkaddr_t sender;
+  linkaddr_t dest;
+  int framer_hdrlen;
+  int max_payload;
+
+  /* Only forward what the IP layer would route without ICMP error */
+  if(uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr)
+     || uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)
+     || uip_is_addr_link_local(&UIP_IP_BUF->destipaddr)
+     || uip_is_addr_link_local(&UIP_IP_BUF->srcipaddr)
+     || uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)
+     || UIP_IP_BUF->ttl <= 1) {
+    return 0;
+  }
+#if UIP_CONF_IPV6_RPL
+  /* The RPL option can be updated in place, but not inserted */
+  if(UIP_IP_BUF->proto != UIP_PROTO_HBHO
+     || len < UIP_IPH_LEN + sizeof(struct uip_hbho_hdr)
+        + sizeof(struct uip_ext_hdr_opt_rpl)
+     || UIP_HBHO_OPT_RPL_BUF->opt_type != UIP_EXT_HDR_OPT_RPL) {
+    return 0;
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+
+  /* Next hop determination, as in tcpip_ipv6_output */
+  if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)) {
+    nexthop = &UIP_IP_BUF->destipaddr;
+  } else {
+#if UIP_CONF_ROUTER
+    route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+#else
+    route = NULL;
+#endif
+    nexthop = route != NULL ? uip_ds6_route_nexthop(route) : uip_ds6_defrt_choose();
+  }
+  lladdr = nexthop != NULL ? uip_ds6_nbr_lladdr_from_ipaddr(nexthop) : NULL;
+  if(lladdr == NULL) {
+    return 0;
+  }
+
+  linkaddr_copy(&sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+
+  /* Compress the headers for the next hop, with the hop limit they will
+     carry. The RPL option is not compressed, its update below does not
+     change their length. */
+  UIP_IP_BUF->ttl--;
+  linkaddr_copy(&dest, (const linkaddr_t *)lladdr);
+  uncomp_hdr_len = 0;
+  packetbuf_hdr_len = 0;
+  packetbuf_clear();
+  packetbuf_ptr = packetbuf_dataptr();
+  packetbuf_set_attr(PACKETBUF_ATTR_PROTO, UIP_IP_BUF->proto);
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1
+  compress_hdr_hc1(&dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
+  compress_hdr_ipv6(&dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
+  compress_hdr_hc06(&dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+  framer_hdrlen = NETSTACK_FRAMER.length();
+  if(framer_hdrlen < 0) {
+    framer_hdrlen = 21;
+  }
+  max_payload = MAC_MAX_PAYLOAD - framer_hdrlen - NETSTACK_LLSEC.get_overhead();
+  e = NULL;
+  if(uncomp_hdr_len > len
+     || SICSLOWPAN_FRAG1_HDR_LEN + packetbuf_hdr_len + len - uncomp_hdr_len > max_payload) {
+    /* The compressed headers grew, the fragment does not fit anymore */
+    PRINTFI("sicslowpan input: first fragment too large to be forwarded\n");
+  } else {
+    e = frag_fwd_lookup(&sender, tag, size);
+    if(e == NULL) {
+      e = frag_fwd_alloc(&sender);
+    }
+  }
+  if(e == NULL) {
+    /* The packet will be reassembled, restore it and its sender */
+    UIP_IP_BUF->ttl++;
+    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+    return 0;
+  }
+  if(e->size == 0) {
+    e->out_tag = my_tag++;
+  }
+
+#if UIP_CONF_IPV6_RPL
+  /* As the IP layer does on input then on output. Both may drop the
+     packet, the following fragments are then orphans. */
+  uip_ext_len = 0;
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+  if(rpl_verify_header(2)) {
+    PRINTFI("sicslowpan input: first fragment dropped by RPL\n");
+    return 1;
+  }
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_null);
+  if(rpl_update_header_empty() || rpl_update_header_final(nexthop)) {
+    PRINTFI("sicslowpan input: first fragment dropped by RPL\n");
+    return 1;
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+
+  /* FRAG1 dispatch + header, then the payload of the received fragment */
+  memmove(packetbuf_ptr + SICSLOWPAN_FRAG1_HDR_LEN, packetbuf_ptr, packetbuf_hdr_len);
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+        ((SICSLOWPAN_DISPATCH_FRAG1 << 8) | size));
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, e->out_tag);
+  packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
+  memcpy(packetbuf_ptr + packetbuf_hdr_len,
+         (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, len - uncomp_hdr_len);
+  packetbuf_set_datalen(packetbuf_hdr_len + len - uncomp_hdr_len);
+
+  linkaddr_copy(&e->sender, &sender);
+  linkaddr_copy(&e->next_hop, &dest);
+  e->tag = tag;
+  e->size = size;
+  e->processed = len;
+  timer_set(&e->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
+  sicslowpan_reass_stats.forwarded++;
+
+  PRINTFI("sicslowpan input: forwarding first fragment (tag %d -> %d)\n",
+          tag, e->out_tag);
+  frag_fwd_send(&dest);
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forwards a subsequent fragment if its packet is in the switching
+ * table. Only the tag is changed.
+ * \return 1 if the fragment was forwarded, 0 otherwise
+ */
+static int
+frag_fwd_next(uint16_t tag, uint16_t size)
+{
+  uint8_t *frag;
+  uint16_t frag_len;
+  struct sicslowpan_frag_fwd *e;
+
+  e = frag_fwd_lookup(packetbuf_addr(PACKETBUF_ADDR_SENDER), tag, size);
+  if(e == NULL) {
+    return 0;
+  }
+
+  /* The FRAGN header keeps its size, the tag is rewritten in place */
+  frag = packetbuf_dataptr();
+  frag_len = packetbuf_datalen();
+  SET16(frag, PACKETBUF_FRAG_TAG, e->out_tag);
+  e->processed += frag_len - SICSLOWPAN_FRAGN_HDR_LEN;
+  PRINTFI("sicslowpan input: forwarding fragment (tag %d -> %d, %d/%d)\n",
+          tag, e->out_tag, e->processed, e->size);
+  if(e->processed >= e->size) {
+    /* Last fragment */
+    e->size = 0;
+  }
+
+  /* Drop the attributes and the received frame header, the fragment is
+     moved down to the start of the data */
+  packetbuf_clear();
+  memmove(packetbuf_dataptr(), frag, frag_len);
+  packetbuf_set_datalen(frag_len);
+  frag_fwd_send(&e->next_hop);
+  return 1;
+}
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+#endif /* SICSLOWPAN_CONF_FRAG */
 /*--------------------------------------------------------------------*/
 /** \brief Process a received 6lowpan packet.
  *  \param r The MAC layer
@@ -1643,11 +2491,11 @@ input(void)
      want to query us for it later. */
   last_rssi = (signed short)packetbuf_attr(PACKETBUF_ATTR_RSSI);
 #if SICSLOWPAN_CONF_FRAG
-  /* if reassembly timed out, cancel it */
-  if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
+  /* cancel the reassemblies that timed out */
+  reass_expire();
+  reass = NULL;
+  /* Non-fragmented packets are uncompressed directly in uip_buf */
+  sicslowpan_buf = uip_buf;
   /*
    * Since we don't support the mesh and broadcast header, the first header
    * we look for is the fragmentation header
@@ -1663,7 +2511,6 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
-      /*      printf("frag1 %d %d\n", reass_tag, frag_tag);*/
       first_fragment = 1;
       is_fragment = 1;
       break;
@@ -1679,77 +2526,44 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
-
-      /* If this is the last fragment, we may shave off any extrenous
-         bytes at the end. We must be liberal in what we accept. */
-      PRINTFI("last_fragment?: processed_ip_in_len %d packetbuf_payload_len %d frag_size %d\n",
-              processed_ip_in_len, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
-
-      if(processed_ip_in_len + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
-        last_fragment = 1;
-      }
       is_fragment = 1;
       break;
     default:
       break;
   }
 
-  /* We are currently reassembling a packet, but have just received the first
-   * fragment of another packet. We can either ignore it and hope to receive
-   * the rest of the under-reassembly packet fragments, or we can discard the
-   * previous packet altogether, and start reassembling the new packet.
-   *
-   * We discard the previous packet, and start reassembling the new packet.
-   * This lessens the negative impacts of too high SICSLOWPAN_REASS_MAXAGE.
-   */
-#define PRIORITIZE_NEW_PACKETS 1
-#if PRIORITIZE_NEW_PACKETS
-
-  if(!is_fragment) {
-    /* Prioritize non-fragment packets too. */
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  } else if(processed_ip_in_len > 0 && first_fragment
-      && !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
-#endif /* PRIORITIZE_NEW_PACKETS */
-
-  if(processed_ip_in_len > 0) {
-    /* reassembly is ongoing */
-    /*    printf("frag %d %d\n", reass_tag, frag_tag);*/
-    if((frag_size > 0 &&
-        (frag_size != sicslowpan_len ||
-         reass_tag  != frag_tag ||
-         !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))))  ||
-       frag_size == 0) {
-      /*
-       * the packet is a fragment that does not belong to the packet
-       * being reassembled or the packet is not a fragment.
-       */
-      PRINTFI("sicslowpan input: Dropping 6lowpan packet that is not a fragment of the packet currently being reassembled\n");
+  if(is_fragment) {
+    if(frag_size == 0 || frag_size > UIP_BUFSIZE) {
+      PRINTFI("sicslowpan input: Dropping fragment of invalid size %d\n", frag_size);
       return;
     }
-  } else {
-    /*
-     * reassembly is off
-     * start it if we received a fragment
-     */
-    if((frag_size > 0) && (frag_size <= UIP_BUFSIZE)) {
-      /* We are currently not reassembling a packet, but have received a packet fragment
-       * that is not the first one. */
-      if(is_fragment && !first_fragment) {
+    if(!first_fragment) {
+#if SICSLOWPAN_FRAG_FORWARDING
+      if(frag_fwd_next(frag_tag, frag_size)) {
         return;
       }
-
-      sicslowpan_len = frag_size;
-      reass_tag = frag_tag;
-      timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
-      PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
-             sicslowpan_len, reass_tag);
-      linkaddr_copy(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+      reass = reass_lookup(packetbuf_addr(PACKETBUF_ADDR_SENDER), frag_tag, frag_size);
+      if(reass == NULL) {
+        /*
+         * the packet is a fragment that does not belong to any packet
+         * being reassembled.
+         */
+        PRINTFI("sicslowpan input: Dropping 6lowpan fragment that is not part of a packet being reassembled\n");
+        sicslowpan_reass_stats.orphans++;
+        return;
+      }
+      /* If this is the last fragment, we may shave off any extrenous
+         bytes at the end. We must be liberal in what we accept. */
+      PRINTFI("last_fragment?: processed_ip_in_len %d packetbuf_payload_len %d frag_size %d\n",
+              processed_ip_in_len, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
+      if(processed_ip_in_len + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
+        last_fragment = 1;
+      }
+      sicslowpan_buf = REASS_BUF(reass);
     }
+    /* The first fragment is uncompressed in uip_buf, and copied to a
+     * reassembly context below */
   }
 
   if(packetbuf_hdr_len == SICSLOWPAN_FRAGN_HDR_LEN) {
@@ -1811,25 +2625,49 @@ input(void)
   {
     int req_size = UIP_LLH_LEN + uncomp_hdr_len + (uint16_t)(frag_offset << 3)
         + packetbuf_payload_len;
-    if(req_size > sizeof(sicslowpan_buf)) {
+    if(req_size > UIP_BUFSIZE) {
       PRINTF(
           "SICSLOWPAN: packet dropped, minimum required SICSLOWPAN_IP_BUF size: %d+%d+%d+%d=%d (current size: %d)\n",
           UIP_LLH_LEN, uncomp_hdr_len, (uint16_t)(frag_offset << 3),
-          packetbuf_payload_len, req_size, sizeof(sicslowpan_buf));
+          packetbuf_payload_len, req_size, UIP_BUFSIZE);
       return;
     }
   }
 
   memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
   
-  /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
+  /* update processed_ip_in_len if fragment, uip_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
-  if(frag_size > 0) {
-    /* Add the size of the header only for the first fragment. */
-    if(first_fragment != 0) {
-      processed_ip_in_len += uncomp_hdr_len;
+  if(first_fragment) {
+    uint16_t len = uncomp_hdr_len + packetbuf_payload_len;
+#if SICSLOWPAN_FRAG_FORWARDING
+    if(len < frag_size && frag_fwd_first(frag_tag, frag_size, len)) {
+      return;
     }
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+    /* Start reassembling a new packet */
+    reass = reass_alloc(packetbuf_addr(PACKETBUF_ADDR_SENDER), frag_tag, frag_size);
+    PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
+           frag_size, frag_tag);
+#if UIP_PACKET_POOL
+    {
+      /* The context takes uip_buf, uip_buf a new buffer */
+      uip_buf_t *buf = uip_pktbuf_alloc();
+      if(buf == NULL) {
+        reass_free(reass);
+        reass = NULL;
+        sicslowpan_reass_stats.aborts++;
+        return;
+      }
+      reass->buf = uip_pktbuf_swap(buf);
+    }
+#else /* UIP_PACKET_POOL */
+    memcpy(REASS_BUF(reass), uip_buf, UIP_LLH_LEN + len);
+#endif /* UIP_PACKET_POOL */
+    sicslowpan_buf = REASS_BUF(reass);
+    processed_ip_in_len = len;
+  } else if(reass != NULL) {
     /* For the last fragment, we are OK if there is extrenous bytes at
        the end of the packet. */
     if(last_fragment != 0) {
@@ -1837,53 +2675,57 @@ input(void)
     } else {
       processed_ip_in_len += packetbuf_payload_len;
     }
-    PRINTF("processed_ip_in_len %d, packetbuf_payload_len %d\n", processed_ip_in_len, packetbuf_payload_len);
-
-  } else {
-#endif /* SICSLOWPAN_CONF_FRAG */
-    sicslowpan_len = packetbuf_payload_len + uncomp_hdr_len;
-#if SICSLOWPAN_CONF_FRAG
   }
+  if(reass != NULL) {
+    PRINTF("processed_ip_in_len %d, packetbuf_payload_len %d, sicslowpan_len %d\n",
+           processed_ip_in_len, packetbuf_payload_len, sicslowpan_len);
 
-  /*
-   * If we have a full IP packet in sicslowpan_buf, deliver it to
-   * the IP stack
-   */
-  PRINTF("sicslowpan_init processed_ip_in_len %d, sicslowpan_len %d\n",
-         processed_ip_in_len, sicslowpan_len);
-  if(processed_ip_in_len == 0 || (processed_ip_in_len == sicslowpan_len)) {
+    /*
+     * Wait until we have a full IP packet in sicslowpan_buf, then
+     * deliver it to the IP stack
+     */
+    if(processed_ip_in_len < sicslowpan_len) {
+      return;
+    }
     PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
            sicslowpan_len);
+#if UIP_PACKET_POOL
+    /* uip_buf takes the buffer of the context, which frees the previous one */
+    reass->buf = uip_pktbuf_swap(reass->buf);
+#else /* UIP_PACKET_POOL */
     memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
+#endif /* UIP_PACKET_POOL */
     uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+    reass_free(reass);
+    sicslowpan_reass_stats.completed++;
+  } else
 #endif /* SICSLOWPAN_CONF_FRAG */
+  {
+    /* Not a fragment: the packet was uncompressed in uip_buf directly */
+    uip_len = packetbuf_payload_len + uncomp_hdr_len;
+  }
 
 #if DEBUG
-    {
-      uint16_t ndx;
-      PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
-      for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
-        uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
-        PRINTF("%02x", data);
-      }
-      PRINTF("\n");
+  {
+    uint16_t ndx;
+    PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
+    for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
+      uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
+      PRINTF("%02x", data);
     }
+    PRINTF("\n");
+  }
 #endif
 
-    /* if callback is set then set attributes and call */
-    if(callback) {
-      set_packet_attrs();
-      packetbuf_set_attr(PACKETBUF_ATTR_PROTO,
-            UIP_IP_BUF->proto);
-      callback->input_callback();
-    }
-
-    tcpip_input();
-#if SICSLOWPAN_CONF_FRAG
+  /* if callback is set then set attributes and call */
+  if(callback) {
+    set_packet_attrs();
+    packetbuf_set_attr(PACKETBUF_ATTR_PROTO,
+          UIP_IP_BUF->proto);
+    callback->input_callback();
   }
-#endif /* SICSLOWPAN_CONF_FRAG */
+
+  tcpip_input();
 }
 /** @} */
 
@@ -1915,6 +2757,9 @@ sicslowpan_init(void)
   addr_contexts[0].prefix[1] = 0xaa;
 #endif
 #endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
+#if SICSLOWPAN_HC06_CACHE && !defined(SICSLOWPAN_NH_COMPRESSOR)
+  hc06_cache_flush();
+#endif
 
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 1
   {
@@ -1942,6 +2787,22 @@ sicslowpan_init(void)
   }
 #endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 1 */
 
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+  /* The preinitialized contexts are permanent /64s, the others are
+     learnt from 6CO options */
+  {
+    int i;
+    for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+      if(addr_contexts[i].used) {
+        addr_contexts[i].prefix_len = 64;
+        addr_contexts[i].flags = SICSLOWPAN_CONTEXT_COMPRESS;
+        addr_contexts[i].lifetime = SICSLOWPAN_CONTEXT_INFINITE_LIFETIME;
+      }
+    }
+  }
+  ctimer_set(&context_timer, 60 * CLOCK_SECOND, context_periodic, NULL);
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+
 #endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
 }
 /*--------------------------------------------------------------------*/
@@ -217,14 +217,35 @@
 
 /**
  * \brief An address context for IPHC address compression
- * each context can have upto 8 bytes
+ * each context can have upto 8 bytes, 16 with dynamic contexts
  */
 struct sicslowpan_addr_context {
   uint8_t used; /* possibly use as prefix-length */
   uint8_t number;
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+  /* Prefix length in bits, a multiple of 8 from 64 to 128 */
+  uint8_t prefix_len;
+  /* SICSLOWPAN_CONTEXT_* flags */
+  uint8_t flags;
+  /* Remaining lifetime in minutes */
+  uint16_t lifetime;
+  uint8_t prefix[16];
+#else /* SICSLOWPAN_DYNAMIC_CONTEXTS */
   uint8_t prefix[8];
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
 };
 
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+/* The context may be used for compression (C flag of the 6CO) */
+#define SICSLOWPAN_CONTEXT_COMPRESS  0x01
+/* The context was allocated by this node, the root */
+#define SICSLOWPAN_CONTEXT_ALLOCATED 0x02
+/* An allocated context no longer used, advertised until it expires */
+#define SICSLOWPAN_CONTEXT_RETIRING  0x04
+/* Lifetime of contexts that never expire */
+#define SICSLOWPAN_CONTEXT_INFINITE_LIFETIME 0xffff
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+
 /**
  * \name Address compressibility test functions
  * @{
@@ -319,8 +340,49 @@ struct sicslowpan_nh_compressor {
 
 };
 
+#if SICSLOWPAN_CONF_FRAG
+/**
+ * \brief 6lowpan reassembly statistics
+ */
+struct sicslowpan_reass_stats {
+  uint16_t started;   /**< Packets for which reassembly started (first fragment) */
+  uint16_t completed; /**< Packets fully reassembled and passed to the IP stack */
+  uint16_t timeouts;  /**< Reassemblies cancelled after SICSLOWPAN_REASS_MAXAGE */
+  uint16_t aborts;    /**< Reassemblies cancelled for a new packet (no free
+                           context, or the sender moved on to another packet) */
+  uint16_t orphans;   /**< Fragments dropped as not part of any reassembly */
+  uint16_t forwarded; /**< Packets forwarded fragment by fragment */
+};
+
+extern struct sicslowpan_reass_stats sicslowpan_reass_stats;
+#endif /* SICSLOWPAN_CONF_FRAG */
+
 int sicslowpan_get_last_rssi(void);
 
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+/**
+ * \brief Adds, updates or removes a context from the body of a 6LoWPAN
+ * Context Option (RFC 6775), i.e. starting at the Context Length field
+ * \return 1 if the option was valid and, unless removing, stored
+ */
+int sicslowpan_context_input(const uint8_t *opt, int len);
+/**
+ * \brief Writes the 6CO body of the context in slot i
+ * \return The length written, 0 if the slot is free
+ */
+int sicslowpan_context_output(int i, uint8_t *opt);
+/**
+ * \brief Have the contexts changed since the last call?
+ */
+int sicslowpan_context_updated(void);
+#if SICSLOWPAN_CONTEXT_ALLOC
+/**
+ * \brief Enables context allocation, on the root only
+ */
+void sicslowpan_context_alloc_enable(int enable);
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
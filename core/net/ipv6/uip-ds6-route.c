@@ -54,6 +54,17 @@ MEMB(neighborroutememb, struct uip_ds6_route_neighbor_route, UIP_DS6_ROUTE_NB);
 LIST(routelist);
 MEMB(routememb, uip_ds6_route_t, UIP_DS6_ROUTE_NB);
 
+#if UIP_DS6_ROUTE_HASH
+/* Host routes are also chained in hash buckets, keyed on the
+   interface identifier. Routes to shorter prefixes are chained on
+   their own, for the longest-prefix fallback. */
+#if UIP_DS6_ROUTE_HASH_SIZE & (UIP_DS6_ROUTE_HASH_SIZE - 1)
+#error UIP_DS6_ROUTE_HASH_SIZE must be a power of two
+#endif
+static uip_ds6_route_t *route_hash[UIP_DS6_ROUTE_HASH_SIZE];
+static uip_ds6_route_t *prefix_routes;
+#endif /* UIP_DS6_ROUTE_HASH */
+
 #endif /* UIP_DS6_ROUTE_NB > 0 */
 
 /* Default routes are held on the defaultrouterlist and their
@@ -148,6 +159,10 @@ uip_ds6_route_init(void)
 #if UIP_DS6_ROUTE_NB > 0
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_HASH
+  memset(route_hash, 0, sizeof(route_hash));
+  prefix_routes = NULL;
+#endif /* UIP_DS6_ROUTE_HASH */
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
 #endif /* UIP_DS6_ROUTE_NB > 0 */
@@ -204,23 +219,74 @@ uip_ds6_route_num_routes(void)
   return num_routes;
 }
 /*---------------------------------------------------------------------------*/
-uip_ds6_route_t *
-uip_ds6_route_lookup(uip_ipaddr_t *addr)
+#if UIP_DS6_ROUTE_HASH
+static uint8_t
+route_hash_index(const uip_ipaddr_t *addr)
+{
+  uint8_t h;
+  h = addr->u8[8] ^ addr->u8[10] ^ addr->u8[12] ^ addr->u8[14];
+  h = (h << 3) ^ addr->u8[9] ^ addr->u8[11] ^ addr->u8[13] ^ addr->u8[15];
+  return h & (UIP_DS6_ROUTE_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t **
+route_hash_chain(const uip_ds6_route_t *r)
+{
+  return r->length < 128 ? &prefix_routes
+    : &route_hash[route_hash_index(&r->ipaddr)];
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_hash_add(uip_ds6_route_t *r)
+{
+  uip_ds6_route_t **chain = route_hash_chain(r);
+  r->hash_next = *chain;
+  *chain = r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_hash_rm(uip_ds6_route_t *r)
+{
+  uip_ds6_route_t **p;
+  for(p = route_hash_chain(r); *p != NULL; p = &(*p)->hash_next) {
+    if(*p == r) {
+      *p = r->hash_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+route_hash_lookup(const uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r;
+  for(r = route_hash[route_hash_index(addr)]; r != NULL; r = r->hash_next) {
+    if(uip_ipaddr_cmp(addr, &r->ipaddr)) {
+      return r;
+    }
+  }
+  return NULL;
+}
+#endif /* UIP_DS6_ROUTE_HASH */
+/*---------------------------------------------------------------------------*/
+/* Longest-prefix match, over all routes or, with the hash, over the
+   prefix routes only */
+static uip_ds6_route_t *
+route_list_lookup(uip_ipaddr_t *addr)
 {
   uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
   uint8_t longestmatch;
 
-  PRINTF("uip-ds6-route: Looking up route for ");
-  PRINT6ADDR(addr);
-  PRINTF("\n");
-
-
   found_route = NULL;
   longestmatch = 0;
+#if UIP_DS6_ROUTE_HASH
+  for(r = prefix_routes; r != NULL; r = r->hash_next) {
+#else /* UIP_DS6_ROUTE_HASH */
   for(r = uip_ds6_route_head();
       r != NULL;
       r = uip_ds6_route_next(r)) {
+#endif /* UIP_DS6_ROUTE_HASH */
     if(r->length >= longestmatch &&
        uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
       longestmatch = r->length;
@@ -231,6 +297,27 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
       }
     }
   }
+  return found_route;
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_lookup(uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *found_route;
+
+  PRINTF("uip-ds6-route: Looking up route for ");
+  PRINT6ADDR(addr);
+  PRINTF("\n");
+
+#if UIP_DS6_ROUTE_HASH
+  /* A host route is the longest match: try the hash first */
+  found_route = route_hash_lookup(addr);
+  if(found_route == NULL) {
+    found_route = route_list_lookup(addr);
+  }
+#else /* UIP_DS6_ROUTE_HASH */
+  found_route = route_list_lookup(addr);
+#endif /* UIP_DS6_ROUTE_HASH */
 
   if(found_route != NULL) {
     PRINTF("uip-ds6-route: Found route: ");
@@ -242,6 +329,10 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     PRINTF("uip-ds6-route: No route found\n");
   }
 
+#if !UIP_DS6_ROUTE_HASH
+  /* With the hash, the list is not walked on lookups and moving the
+     route would cost a walk: the list stays ordered by when routes
+     were added, i.e. last refreshed by a DAO. */
   if(found_route != NULL && found_route != list_head(routelist)) {
     /* If we found a route, we put it at the start of the routeslist
        list. The list is ordered by how recently we looked them up:
@@ -251,6 +342,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     list_remove(routelist, found_route);
     list_push(routelist, found_route);
   }
+#endif /* !UIP_DS6_ROUTE_HASH */
 
   return found_route;
 }
@@ -366,6 +458,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+#if UIP_DS6_ROUTE_HASH
+  route_hash_add(r);
+#endif /* UIP_DS6_ROUTE_HASH */
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -404,6 +499,9 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the route from the route list */
     list_remove(routelist, route);
+#if UIP_DS6_ROUTE_HASH
+    route_hash_rm(route);
+#endif /* UIP_DS6_ROUTE_HASH */
 
     /* Find the corresponding neighbor_route and remove it. */
     for(neighbor_route = list_head(route->neighbor_routes->route_list);
@@ -81,6 +81,23 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB UIP_CONF_MAX_ROUTES
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/* Hash index of the host (/128) routes, for routers with many
+   downward routes. Lookups of other addresses walk the prefix
+   routes only. The route list is then kept in the order routes were
+   added (refreshed), not looked up. */
+#ifdef UIP_DS6_ROUTE_CONF_HASH
+#define UIP_DS6_ROUTE_HASH UIP_DS6_ROUTE_CONF_HASH
+#else
+#define UIP_DS6_ROUTE_HASH 0
+#endif
+
+/* Number of hash buckets, a power of two */
+#ifdef UIP_DS6_ROUTE_CONF_HASH_SIZE
+#define UIP_DS6_ROUTE_HASH_SIZE UIP_DS6_ROUTE_CONF_HASH_SIZE
+#else
+#define UIP_DS6_ROUTE_HASH_SIZE 16
+#endif
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
@@ -91,6 +108,10 @@ typedef struct rpl_route_entry {
   void *dag;
   uint8_t learned_from;
   uint8_t nopath_received;
+#if RPL_DAO_AGGREGATION
+  /* clock_seconds() when last forwarded upwards, 0 if it has to be */
+  uint32_t dao_forwarded;
+#endif /* RPL_DAO_AGGREGATION */
 } rpl_route_entry_t;
 #endif /* UIP_DS6_ROUTE_STATE_TYPE */
 
@@ -109,6 +130,10 @@ typedef struct uip_ds6_route {
      belong to the neighbor table entry that this routing table entry
      uses. */
   struct uip_ds6_route_neighbor_routes *neighbor_routes;
+#if UIP_DS6_ROUTE_HASH
+  /* Next host route in the same hash bucket, or next prefix route */
+  struct uip_ds6_route *hash_next;
+#endif
   uip_ipaddr_t ipaddr;
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   UIP_DS6_ROUTE_STATE_TYPE state;
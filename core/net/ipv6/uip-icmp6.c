@@ -123,6 +123,9 @@ echo_request_input(void)
 #if UIP_CONF_IPV6_RPL
   uint8_t temp_ext_len;
 #endif /* UIP_CONF_IPV6_RPL */
+  uint16_t chksum;
+  uint16_t type_code;
+  uint8_t src_changed = 0;
   /*
    * we send an echo reply. It is trivial if there was no extension
    * headers in the request otherwise we need to remove the extension
@@ -134,12 +137,20 @@ echo_request_input(void)
   PRINT6ADDR(&UIP_IP_BUF->destipaddr);
   PRINTF("\n");
 
+  /* Neither the hop limit nor the extension headers are covered by the
+     checksum, and swapping the addresses leaves the pseudo-header sum
+     as is: unless a new source is picked, the reply checksum is the
+     request one updated for the type (RFC 1624) */
+  chksum = UIP_ICMP_BUF->icmpchksum;
+  type_code = UIP_HTONS((UIP_ICMP_BUF->type << 8) | UIP_ICMP_BUF->icode);
+
   /* IP header */
   UIP_IP_BUF->ttl = uip_ds6_if.cur_hop_limit;
 
   if(uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)){
     uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &UIP_IP_BUF->srcipaddr);
     uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
+    src_changed = 1;
   } else {
     uip_ipaddr_copy(&tmp_ipaddr, &UIP_IP_BUF->srcipaddr);
     uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
@@ -192,8 +203,13 @@ echo_request_input(void)
   /* Note: now UIP_ICMP_BUF points to the beginning of the echo reply */
   UIP_ICMP_BUF->type = ICMP6_ECHO_REPLY;
   UIP_ICMP_BUF->icode = 0;
-  UIP_ICMP_BUF->icmpchksum = 0;
-  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+  if(src_changed) {
+    UIP_ICMP_BUF->icmpchksum = 0;
+    UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+  } else {
+    UIP_ICMP_BUF->icmpchksum = uip_chksum_update(chksum, type_code,
+                                                 UIP_HTONS(ICMP6_ECHO_REPLY << 8));
+  }
 
   PRINTF("Sending Echo Reply to");
   PRINT6ADDR(&UIP_IP_BUF->destipaddr);
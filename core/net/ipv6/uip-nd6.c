@@ -72,6 +72,7 @@
 #include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/sicslowpan.h"
 #include "lib/random.h"
 
 /*------------------------------------------------------------------*/
@@ -542,9 +543,7 @@ na_input(void)
     return;
     }*/
   if(uip_packetqueue_buflen(&nbr->packethandle) != 0) {
-    uip_len = uip_packetqueue_buflen(&nbr->packethandle);
-    memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-    uip_packetqueue_free(&nbr->packethandle);
+    uip_packetqueue_restore(&nbr->packethandle);
     return;
   }
   
@@ -938,6 +937,13 @@ ra_input(void)
         /* End of autonomous flag related processing */
       }
       break;
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+    case UIP_ND6_OPT_6CO:
+      PRINTF("Processing 6CO option in RA\n");
+      sicslowpan_context_input((uint8_t *)UIP_ND6_OPT_HDR_BUF + UIP_ND6_OPT_DATA_OFFSET,
+                               (UIP_ND6_OPT_HDR_BUF->len << 3) - UIP_ND6_OPT_HDR_LEN);
+      break;
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
     default:
       PRINTF("ND option not supported in RA");
       break;
@@ -974,9 +980,7 @@ ra_input(void)
     return;
     }*/
   if(nbr != NULL && uip_packetqueue_buflen(&nbr->packethandle) != 0) {
-    uip_len = uip_packetqueue_buflen(&nbr->packethandle);
-    memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-    uip_packetqueue_free(&nbr->packethandle);
+    uip_packetqueue_restore(&nbr->packethandle);
     return;
   }
 
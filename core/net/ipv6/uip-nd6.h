@@ -134,6 +134,7 @@
 #define UIP_ND6_OPT_PREFIX_INFO         3
 #define UIP_ND6_OPT_REDIRECTED_HDR      4
 #define UIP_ND6_OPT_MTU                 5
+#define UIP_ND6_OPT_6CO                 34 /* 6LoWPAN Context (RFC 6775) */
 /** @} */
 
 /** \name ND6 option types */
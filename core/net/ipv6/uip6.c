@@ -166,7 +166,14 @@ uint8_t uip_ext_opt_offset = 0;
  */
 /** Packet buffer for incoming and outgoing packets */
 #ifndef UIP_CONF_EXTERNAL_BUFFER
+#if UIP_PACKET_POOL
+/* uip_buf is the first buffer of the pool at startup */
+static uip_buf_t pktbufs[UIP_PACKET_POOL_SIZE];
+static uint8_t pktbuf_used[UIP_PACKET_POOL_SIZE] = { 1 };
+uip_buf_t *uip_bufptr = &pktbufs[0];
+#else /* UIP_PACKET_POOL */
 uip_buf_t uip_aligned_buf;
+#endif /* UIP_PACKET_POOL */
 #endif /* UIP_CONF_EXTERNAL_BUFFER */
 
 /* The uip_appdata pointer points to application data. */
@@ -298,37 +305,82 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #endif /* UIP_ARCH_ADD32 && UIP_TCP */
 
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum_update(uint16_t chksum, uint16_t old_word, uint16_t new_word)
+{
+  uint32_t sum;
+
+  /* RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m') */
+  sum = (uint16_t)~chksum + (uint16_t)~old_word + (uint32_t)new_word;
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum += sum >> 16;
+  return ~(uint16_t)sum;
+}
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
+#if UIP_ARCH_CHKSUM_WORDS
+#define chksum_words uip_arch_chksum_words
+#else /* UIP_ARCH_CHKSUM_WORDS */
+/* Sum of n 16-bit words as they are in memory, with the carries kept in
+   the upper half. Up to 65535 words cannot overflow. */
+static uint32_t
+chksum_words(const uint16_t *words, uint16_t n)
+{
+  uint32_t acc = 0;
+
+  while(n >= 4) {
+    acc += words[0];
+    acc += words[1];
+    acc += words[2];
+    acc += words[3];
+    words += 4;
+    n -= 4;
+  }
+  while(n > 0) {
+    acc += *words++;
+    n--;
+  }
+  return acc;
+}
+#endif /* UIP_ARCH_CHKSUM_WORDS */
+/*---------------------------------------------------------------------------*/
 static uint16_t
 chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
-  uint16_t t;
+  uint32_t acc;
   const uint8_t *dataptr;
   const uint8_t *last_byte;
 
-  dataptr = data;
-  last_byte = data + len - 1;
-  
-  while(dataptr < last_byte) {   /* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
+  if(((uintptr_t)data & 1) == 0) {
+    /* Word at a time. The one's complement sum does not depend on byte
+       order (RFC 1071), so the words are summed as they are in memory and
+       the folded result is converted once. */
+    acc = chksum_words((const uint16_t *)data, len >> 1);
+    acc = (acc & 0xffff) + (acc >> 16);
+    acc = (acc & 0xffff) + (acc >> 16);
+    acc = uip_ntohs((uint16_t)acc);
+    dataptr = data + (len & ~1);
+  } else {
+    acc = 0;
+    dataptr = data;
+    last_byte = data + len - 1;
+    while(dataptr < last_byte) {   /* At least two more bytes */
+      acc += ((uint16_t)dataptr[0] << 8) | dataptr[1];
+      dataptr += 2;
     }
-    dataptr += 2;
   }
-  
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
+
+  if(len & 1) {
+    acc += (uint16_t)dataptr[0] << 8;
   }
 
+  acc += sum;
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc += acc >> 16;
+
   /* Return sum in host byte order. */
-  return sum;
+  return (uint16_t)acc;
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
@@ -406,6 +458,38 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_PACKET_POOL && !defined(UIP_CONF_EXTERNAL_BUFFER)
+uip_buf_t *
+uip_pktbuf_alloc(void)
+{
+  int i;
+  for(i = 0; i < UIP_PACKET_POOL_SIZE; i++) {
+    if(!pktbuf_used[i]) {
+      pktbuf_used[i] = 1;
+      return &pktbufs[i];
+    }
+  }
+  UIP_LOG("packet pool exhausted");
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_pktbuf_free(uip_buf_t *buf)
+{
+  if(buf != NULL) {
+    pktbuf_used[buf - pktbufs] = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uip_buf_t *
+uip_pktbuf_swap(uip_buf_t *buf)
+{
+  uip_buf_t *prev = uip_bufptr;
+  uip_bufptr = buf;
+  return prev;
+}
+#endif /* UIP_PACKET_POOL && !defined(UIP_CONF_EXTERNAL_BUFFER) */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -1345,6 +1429,21 @@ uip_process(uint8_t flag)
          */
 
         PRINTF("Processing Routing header\n");
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+        /* RPL source routing header: forward to the next address */
+        if(rpl_process_srh_header()) {
+          if(UIP_IP_BUF->ttl <= 1) {
+            uip_icmp6_error_output(ICMP6_TIME_EXCEEDED,
+                                   ICMP6_TIME_EXCEED_TRANSIT, 0);
+            UIP_STAT(++uip_stat.ip.drop);
+            goto send;
+          }
+          UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+          uip_ext_len = 0;
+          UIP_STAT(++uip_stat.ip.forwarded);
+          goto send;
+        }
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
         if(UIP_ROUTING_BUF->seg_left > 0) {
           uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, UIP_IPH_LEN + uip_ext_len + 2);
           UIP_STAT(++uip_stat.ip.drop);
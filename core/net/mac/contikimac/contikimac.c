@@ -69,6 +69,13 @@
 #ifndef WITH_FAST_SLEEP
 #define WITH_FAST_SLEEP              1
 #endif
+/* Unicast stream packets keep the receiver awake for the next one,
+   which then goes out without waking it up again */
+#ifdef CONTIKIMAC_CONF_WITH_BURST_RESERVATION
+#define WITH_BURST_RESERVATION       CONTIKIMAC_CONF_WITH_BURST_RESERVATION
+#else /* CONTIKIMAC_CONF_WITH_BURST_RESERVATION */
+#define WITH_BURST_RESERVATION       0
+#endif /* CONTIKIMAC_CONF_WITH_BURST_RESERVATION */
 /* Radio does CSMA and autobackoff */
 #ifndef RDC_CONF_HARDWARE_CSMA
 #define RDC_CONF_HARDWARE_CSMA       0
@@ -201,6 +208,16 @@ static int we_are_receiving_burst = 0;
 //#define MAX_PHASE_STROBE_TIME              RTIMER_ARCH_SECOND / 60
 #define MAX_PHASE_STROBE_TIME              GUARD_TIME_MULTIPLICATOR * (RTIMER_ARCH_SECOND / 60)
 
+/* PHASE_LOCK_MIN_MARGIN is how early we expect a neighbor we have a
+   phase lock with: the encounter is the strobe it acked, one strobe
+   after the CCA checks that woke it up. */
+#define PHASE_LOCK_MIN_MARGIN              (4 * CHECK_TIME + INTER_PACKET_INTERVAL)
+
+/* BURST_RESERVATION_TIME is how long the receiver of a frame with the
+   pending bit is known to wait for the next one: half of its
+   INTER_PACKET_DEADLINE, which is counted in coarser clock ticks. */
+#define BURST_RESERVATION_TIME             (RTIMER_ARCH_SECOND / 64)
+
 #define ACK_LEN 3
 
 #include <stdio.h>
@@ -244,6 +261,13 @@ static struct timer broadcast_rate_timer;
 static int broadcast_rate_counter;
 #endif /* CONTIKIMAC_CONF_BROADCAST_RATE_LIMIT */
 
+#if WITH_BURST_RESERVATION
+/* The neighbor waiting for the next packet of our burst, and until when */
+static linkaddr_t reserved_receiver;
+static rtimer_clock_t reserved_until;
+static clock_time_t reserved_at;
+#endif /* WITH_BURST_RESERVATION */
+
 /*---------------------------------------------------------------------------*/
 static void
 on(void)
@@ -494,6 +518,24 @@ broadcast_rate_drop(void)
 #endif /* CONTIKIMAC_CONF_BROADCAST_RATE_LIMIT */
 }
 /*---------------------------------------------------------------------------*/
+#if WITH_BURST_RESERVATION
+static int
+is_stream(void)
+{
+  return packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
+    PACKETBUF_ATTR_PACKET_TYPE_STREAM && !packetbuf_holds_broadcast();
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_reserved(const linkaddr_t *receiver)
+{
+  /* reserved_at keeps a wrapped rtimer from extending the reservation */
+  return clock_time() - reserved_at <= INTER_PACKET_DEADLINE &&
+    RTIMER_CLOCK_LT(RTIMER_NOW(), reserved_until) &&
+    linkaddr_cmp(receiver, &reserved_receiver);
+}
+#endif /* WITH_BURST_RESERVATION */
+/*---------------------------------------------------------------------------*/
 static int
 send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
 	    struct rdc_buf_list *buf_list,
@@ -512,6 +554,10 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   int ret;
   uint8_t contikimac_was_on;
   uint8_t seqno;
+  rtimer_clock_t phase_strobe_time = MAX_PHASE_STROBE_TIME;
+#if WITH_PHASE_OPTIMIZATION && PHASE_LOCK
+  rtimer_clock_t phase_margin;
+#endif /* WITH_PHASE_OPTIMIZATION && PHASE_LOCK */
   
   /* Exit if RDC and radio were explicitly turned off */
    if(!contikimac_is_on && !contikimac_keep_radio_on) {
@@ -564,6 +610,11 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
 
   if(!packetbuf_attr(PACKETBUF_ATTR_IS_CREATED_AND_SECURED)) {
     packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+#if WITH_BURST_RESERVATION
+    if(is_stream()) {
+      packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
+    }
+#endif /* WITH_BURST_RESERVATION */
     if(NETSTACK_FRAMER.create_and_secure() < 0) {
       PRINTF("contikimac: framer failed\n");
       return MAC_TX_ERR_FATAL;
@@ -572,12 +623,32 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   
   transmit_len = packetbuf_totlen();
   NETSTACK_RADIO.prepare(packetbuf_hdrptr(), transmit_len);
+
+#if WITH_BURST_RESERVATION
+  if(!is_broadcast && !is_receiver_awake &&
+     is_reserved(packetbuf_addr(PACKETBUF_ADDR_RECEIVER))) {
+    /* Still awake after our last packet */
+    is_receiver_awake = 1;
+  }
+#endif /* WITH_BURST_RESERVATION */
   
   if(!is_broadcast && !is_receiver_awake) {
 #if WITH_PHASE_OPTIMIZATION
+#if PHASE_LOCK
+    phase_margin = phase_lock_margin(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                                     PHASE_LOCK_MIN_MARGIN,
+                                     GUARD_TIME - CHECK_TIME_TX);
+    /* Strobe from phase_margin before the expected encounter to
+       phase_margin after it */
+    phase_strobe_time = MIN(MAX_PHASE_STROBE_TIME, 2 * phase_margin + CHECK_TIME);
+    ret = phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                     CYCLE_TIME, CHECK_TIME_TX + phase_margin,
+                     mac_callback, mac_callback_ptr, buf_list);
+#else /* PHASE_LOCK */
     ret = phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
                      CYCLE_TIME, GUARD_TIME,
                      mac_callback, mac_callback_ptr, buf_list);
+#endif /* PHASE_LOCK */
     if(ret == PHASE_DEFERRED) {
       return MAC_TX_DEFERRED;
     }
@@ -673,7 +744,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     watchdog_periodic();
 
     if(!is_broadcast && (is_receiver_awake || is_known_receiver) &&
-       !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + MAX_PHASE_STROBE_TIME)) {
+       !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + phase_strobe_time)) {
       PRINTF("miss to %d\n", packetbuf_addr(PACKETBUF_ADDR_RECEIVER)->u8[0]);
       break;
     }
@@ -768,6 +839,19 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     ret = MAC_TX_OK;
   }
 
+#if WITH_BURST_RESERVATION
+  if(ret == MAC_TX_OK && !is_broadcast &&
+     packetbuf_attr(PACKETBUF_ATTR_PENDING)) {
+    linkaddr_copy(&reserved_receiver, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    reserved_until = encounter_time + BURST_RESERVATION_TIME;
+    reserved_at = clock_time();
+  } else if(ret == MAC_TX_NOACK &&
+            is_reserved(packetbuf_addr(PACKETBUF_ADDR_RECEIVER))) {
+    /* The receiver went back to sleep */
+    reserved_until = RTIMER_NOW();
+  }
+#endif /* WITH_BURST_RESERVATION */
+
 #if WITH_PHASE_OPTIMIZATION
   if(is_known_receiver && got_strobe_ack) {
     PRINTF("no miss %d wake-ups %d\n",
@@ -832,6 +916,11 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
       if(next != NULL) {
         packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
       }
+#if WITH_BURST_RESERVATION
+      if(is_stream()) {
+        packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
+      }
+#endif /* WITH_BURST_RESERVATION */
       packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
       if(NETSTACK_FRAMER.create_and_secure() < 0) {
         PRINTF("contikimac: framer failed\n");
@@ -51,6 +51,9 @@
 #include "lib/list.h"
 #include "lib/memb.h"
 
+#include "net/nbr-table.h"
+#include "sys/timer.h"
+
 #include <string.h>
 
 #include <stdio.h>
@@ -84,6 +87,15 @@
 #error Change CSMA_CONF_MAX_MAC_TRANSMISSIONS in contiki-conf.h or in your Makefile.
 #endif /* CSMA_CONF_MAX_MAC_TRANSMISSIONS < 1 */
 
+/* With the scheduler, the neighbor queues are kept in a neighbor table
+   and served by a single timer in weighted round-robin, instead of
+   every queue running its own timer */
+#ifdef CSMA_CONF_WITH_SCHEDULER
+#define CSMA_WITH_SCHEDULER CSMA_CONF_WITH_SCHEDULER
+#else
+#define CSMA_WITH_SCHEDULER 0
+#endif /* CSMA_CONF_WITH_SCHEDULER */
+
 /* Packet metadata */
 struct qbuf_metadata {
   mac_callback_t sent;
@@ -93,9 +105,15 @@ struct qbuf_metadata {
 
 /* Every neighbor has its own packet queue */
 struct neighbor_queue {
+#if CSMA_WITH_SCHEDULER
+  struct timer transmit_timer;
+  uint8_t sending;
+  uint8_t weight;
+#else /* CSMA_WITH_SCHEDULER */
   struct neighbor_queue *next;
   linkaddr_t addr;
   struct ctimer transmit_timer;
+#endif /* CSMA_WITH_SCHEDULER */
   uint8_t transmissions;
   uint8_t collisions, deferrals;
   LIST_STRUCT(queued_packet_list);
@@ -116,18 +134,80 @@ struct neighbor_queue {
 #endif /* CSMA_CONF_MAX_PACKET_PER_NEIGHBOR */
 
 #define MAX_QUEUED_PACKETS QUEUEBUF_NUM
+
+/* The weight of a neighbor, at least 1: the number of times in a row it
+   is served when it gets the turn, and its share of the packet pool
+   when several neighbors have packets. E.g. a router may favor its
+   preferred parent. */
+#ifdef CSMA_CONF_SCHEDULER_WEIGHT
+#define CSMA_SCHEDULER_WEIGHT(addr) CSMA_CONF_SCHEDULER_WEIGHT(addr)
+#else
+#define CSMA_SCHEDULER_WEIGHT(addr) 1
+#endif /* CSMA_CONF_SCHEDULER_WEIGHT */
+
+/* The packets of the shared pool that only neighbors holding less than
+   their share may take, so that a busy neighbor cannot fill the whole
+   pool */
+#ifdef CSMA_CONF_SCHEDULER_RESERVED_PACKETS
+#define CSMA_SCHEDULER_RESERVED_PACKETS CSMA_CONF_SCHEDULER_RESERVED_PACKETS
+#else
+#define CSMA_SCHEDULER_RESERVED_PACKETS (MAX_QUEUED_PACKETS / 4)
+#endif /* CSMA_CONF_SCHEDULER_RESERVED_PACKETS */
+
+#if CSMA_WITH_SCHEDULER
+NBR_TABLE(struct neighbor_queue, neighbor_queues);
+/* The broadcast queue is kept out of the neighbor table: it is no
+   neighbor, and adding it to a full table would evict a real one */
+static struct neighbor_queue broadcast_queue;
+static uint8_t broadcast_queue_used;
+static struct ctimer scheduler_timer;
+/* The neighbor that has the turn, and how many more times it is served */
+static struct neighbor_queue *turn;
+static uint8_t turn_credit;
+/* The sum of the weights of the neighbors that have packets */
+static uint16_t total_weight;
+#else /* CSMA_WITH_SCHEDULER */
 MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
+LIST(neighbor_list);
+#endif /* CSMA_WITH_SCHEDULER */
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
-LIST(neighbor_list);
 
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 
+#if CSMA_WITH_SCHEDULER
+/*---------------------------------------------------------------------------*/
+/* Iterates over the queues: the broadcast one, if used, then those of
+   the neighbor table */
+static struct neighbor_queue *
+queue_head(void)
+{
+  if(broadcast_queue_used) {
+    return &broadcast_queue;
+  }
+  return nbr_table_head(neighbor_queues);
+}
+/*---------------------------------------------------------------------------*/
+static struct neighbor_queue *
+queue_next(struct neighbor_queue *n)
+{
+  if(n == &broadcast_queue) {
+    return nbr_table_head(neighbor_queues);
+  }
+  return nbr_table_next(neighbor_queues, n);
+}
+#endif /* CSMA_WITH_SCHEDULER */
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
 {
+#if CSMA_WITH_SCHEDULER
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    return broadcast_queue_used ? &broadcast_queue : NULL;
+  }
+  return nbr_table_get_from_lladdr(neighbor_queues, addr);
+#else /* CSMA_WITH_SCHEDULER */
   struct neighbor_queue *n = list_head(neighbor_list);
   while(n != NULL) {
     if(linkaddr_cmp(&n->addr, addr)) {
@@ -136,6 +216,91 @@ neighbor_queue_from_addr(const linkaddr_t *addr)
     n = list_item_next(n);
   }
   return NULL;
+#endif /* CSMA_WITH_SCHEDULER */
+}
+/*---------------------------------------------------------------------------*/
+static struct neighbor_queue *
+neighbor_queue_add(const linkaddr_t *addr)
+{
+  struct neighbor_queue *n;
+#if CSMA_WITH_SCHEDULER
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    n = &broadcast_queue;
+    broadcast_queue_used = 1;
+  } else {
+    /* Locked as long as it has packets, so that the neighbor table does
+       not reuse the entry */
+    n = nbr_table_add_lladdr(neighbor_queues, addr);
+    if(n != NULL) {
+      nbr_table_lock(neighbor_queues, n);
+    }
+  }
+  if(n != NULL) {
+    n->sending = 0;
+    timer_set(&n->transmit_timer, 0);
+    n->weight = CSMA_SCHEDULER_WEIGHT(addr);
+    if(n->weight == 0) {
+      n->weight = 1;
+    }
+    total_weight += n->weight;
+  }
+#else /* CSMA_WITH_SCHEDULER */
+  n = memb_alloc(&neighbor_memb);
+  if(n != NULL) {
+    linkaddr_copy(&n->addr, addr);
+  }
+#endif /* CSMA_WITH_SCHEDULER */
+  if(n != NULL) {
+    /* Init neighbor entry */
+    n->transmissions = 0;
+    n->collisions = 0;
+    n->deferrals = 0;
+    /* Init packet list for this neighbor */
+    LIST_STRUCT_INIT(n, queued_packet_list);
+#if !CSMA_WITH_SCHEDULER
+    /* Add neighbor to the list */
+    list_add(neighbor_list, n);
+#endif /* !CSMA_WITH_SCHEDULER */
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_queue_remove(struct neighbor_queue *n)
+{
+#if CSMA_WITH_SCHEDULER
+  if(n == turn) {
+    /* The next neighbor gets the turn */
+    turn = queue_next(n);
+    turn_credit = 0;
+  }
+  total_weight -= n->weight;
+  if(n == &broadcast_queue) {
+    broadcast_queue_used = 0;
+  } else {
+    nbr_table_remove(neighbor_queues, n);
+  }
+#else /* CSMA_WITH_SCHEDULER */
+  ctimer_stop(&n->transmit_timer);
+  list_remove(neighbor_list, n);
+  memb_free(&neighbor_memb, n);
+#endif /* CSMA_WITH_SCHEDULER */
+}
+/*---------------------------------------------------------------------------*/
+static int
+neighbor_queue_has_room(struct neighbor_queue *n)
+{
+  int len = list_length(n->queued_packet_list);
+#if CSMA_WITH_SCHEDULER
+  /* Above its share of the unreserved pool, a neighbor leaves the last
+     free packets to the others */
+  if(len >= (MAX_QUEUED_PACKETS - CSMA_SCHEDULER_RESERVED_PACKETS)
+            * n->weight / total_weight
+     && memb_numfree(&packet_memb) <= CSMA_SCHEDULER_RESERVED_PACKETS) {
+    return 0;
+  }
+#endif /* CSMA_WITH_SCHEDULER */
+  return len < CSMA_MAX_PACKET_PER_NEIGHBOR;
 }
 /*---------------------------------------------------------------------------*/
 static clock_time_t
@@ -165,10 +330,104 @@ transmit_packet_list(void *ptr)
       PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
           list_length(n->queued_packet_list));
       /* Send packets in the neighbor's list */
+#if CSMA_WITH_SCHEDULER
+      n->sending = 1;
+#endif /* CSMA_WITH_SCHEDULER */
       NETSTACK_RDC.send_list(packet_sent, n, q);
     }
   }
 }
+#if CSMA_WITH_SCHEDULER
+/*---------------------------------------------------------------------------*/
+static int
+is_ready(struct neighbor_queue *n)
+{
+  return !n->sending && timer_expired(&n->transmit_timer);
+}
+/*---------------------------------------------------------------------------*/
+/* The first ready neighbor from the one that has the turn, included,
+   wrapping around the queues */
+static struct neighbor_queue *
+next_ready(void)
+{
+  struct neighbor_queue *n;
+
+  for(n = turn; n != NULL; n = queue_next(n)) {
+    if(is_ready(n)) {
+      return n;
+    }
+  }
+  for(n = queue_head(); n != NULL && n != turn; n = queue_next(n)) {
+    if(is_ready(n)) {
+      return n;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void transmit_next(void *ptr);
+
+/* Sets the scheduler timer to the first neighbor transmission */
+static void
+schedule(void)
+{
+  struct neighbor_queue *n;
+  struct neighbor_queue *first = NULL;
+  clock_time_t wait = 0;
+  clock_time_t remaining;
+
+  for(n = queue_head(); n != NULL; n = queue_next(n)) {
+    if(n->sending) {
+      continue;
+    }
+    remaining = timer_expired(&n->transmit_timer) ?
+      0 : timer_remaining(&n->transmit_timer);
+    if(first == NULL || remaining < wait) {
+      first = n;
+      wait = remaining;
+      if(wait == 0) {
+        break;
+      }
+    }
+  }
+  if(first != NULL) {
+    ctimer_set(&scheduler_timer, wait, transmit_next, NULL);
+  } else {
+    ctimer_stop(&scheduler_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+transmit_next(void *ptr)
+{
+  struct neighbor_queue *n = next_ready();
+
+  if(n != NULL) {
+    if(n != turn || turn_credit == 0) {
+      turn = n;
+      turn_credit = n->weight;
+    }
+    if(--turn_credit == 0) {
+      /* Used up: the next neighbor gets the turn */
+      turn = queue_next(n);
+    }
+    transmit_packet_list(n);
+  }
+  schedule();
+}
+#endif /* CSMA_WITH_SCHEDULER */
+/*---------------------------------------------------------------------------*/
+/* Sets the next transmission of a neighbor queue in time clock ticks */
+static void
+transmit_later(struct neighbor_queue *n, clock_time_t time)
+{
+#if CSMA_WITH_SCHEDULER
+  timer_set(&n->transmit_timer, time);
+  schedule();
+#else /* CSMA_WITH_SCHEDULER */
+  ctimer_set(&n->transmit_timer, time, transmit_packet_list, n);
+#endif /* CSMA_WITH_SCHEDULER */
+}
 /*---------------------------------------------------------------------------*/
 static void
 free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
@@ -188,13 +447,10 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
       n->collisions = 0;
       n->deferrals = 0;
       /* Set a timer for next transmissions */
-      ctimer_set(&n->transmit_timer, default_timebase(),
-                 transmit_packet_list, n);
+      transmit_later(n, default_timebase());
     } else {
       /* This was the last packet in the queue, we free the neighbor */
-      ctimer_stop(&n->transmit_timer);
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
+      neighbor_queue_remove(n);
     }
   }
 }
@@ -216,6 +472,9 @@ packet_sent(void *ptr, int status, int num_transmissions)
   if(n == NULL) {
     return;
   }
+#if CSMA_WITH_SCHEDULER
+  n->sending = 0;
+#endif /* CSMA_WITH_SCHEDULER */
   switch(status) {
   case MAC_TX_OK:
   case MAC_TX_NOACK:
@@ -285,8 +544,7 @@ packet_sent(void *ptr, int status, int num_transmissions)
 
         if(n->transmissions < metadata->max_transmissions) {
           PRINTF("csma: retransmitting with time %lu %p\n", time, q);
-          ctimer_set(&n->transmit_timer, time,
-                     transmit_packet_list, n);
+          transmit_later(n, time);
           /* This is needed to correctly attribute energy that we spent
              transmitting this packet. */
           queuebuf_update_attr_from_packetbuf(q->buf);
@@ -339,23 +597,12 @@ send_packet(mac_callback_t sent, void *ptr)
   n = neighbor_queue_from_addr(addr);
   if(n == NULL) {
     /* Allocate a new neighbor entry */
-    n = memb_alloc(&neighbor_memb);
-    if(n != NULL) {
-      /* Init neighbor entry */
-      linkaddr_copy(&n->addr, addr);
-      n->transmissions = 0;
-      n->collisions = 0;
-      n->deferrals = 0;
-      /* Init packet list for this neighbor */
-      LIST_STRUCT_INIT(n, queued_packet_list);
-      /* Add neighbor to the list */
-      list_add(neighbor_list, n);
-    }
+    n = neighbor_queue_add(addr);
   }
 
   if(n != NULL) {
     /* Add packet to the neighbor's queue */
-    if(list_length(n->queued_packet_list) < CSMA_MAX_PACKET_PER_NEIGHBOR) {
+    if(neighbor_queue_has_room(n)) {
       q = memb_alloc(&packet_memb);
       if(q != NULL) {
         q->ptr = memb_alloc(&metadata_memb);
@@ -393,7 +640,7 @@ send_packet(mac_callback_t sent, void *ptr)
                    list_length(n->queued_packet_list), memb_numfree(&packet_memb));
             /* If q is the first packet in the neighbor's queue, send asap */
             if(list_head(n->queued_packet_list) == q) {
-              ctimer_set(&n->transmit_timer, 0, transmit_packet_list, n);
+              transmit_later(n, 0);
             }
             return;
           }
@@ -405,8 +652,7 @@ send_packet(mac_callback_t sent, void *ptr)
       }
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
       if(list_length(n->queued_packet_list) == 0) {
-        list_remove(neighbor_list, n);
-        memb_free(&neighbor_memb, n);
+        neighbor_queue_remove(n);
       }
     } else {
       LOGP("csma: Neighbor queue full\n");
@@ -454,7 +700,11 @@ init(void)
 {
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
+#if CSMA_WITH_SCHEDULER
+  nbr_table_register(neighbor_queues, NULL);
+#else /* CSMA_WITH_SCHEDULER */
   memb_init(&neighbor_memb);
+#endif /* CSMA_WITH_SCHEDULER */
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -52,9 +52,34 @@
 #define PHASE_DRIFT_CORRECT 0
 #endif
 
+#if PHASE_LOCK
+/* Drift left once the estimate is applied, in ppm: the margin grows by
+   this much with the time since the last encounter */
+#ifdef PHASE_CONF_LOCK_PPM
+#define PHASE_LOCK_PPM PHASE_CONF_LOCK_PPM
+#else
+#define PHASE_LOCK_PPM 20
+#endif
+/* Encounters within the margin before it is narrowed */
+#define PHASE_LOCK_MIN_LOCKS  2
+/* Older phases are not trusted to be locked */
+#define PHASE_LOCK_MAX_AGE    (CLOCK_SECOND * 300)
+/* Shorter intervals say more about the strobe an encounter was acked
+   on than about the drift */
+#define PHASE_LOCK_DRIFT_AGE  (CLOCK_SECOND * 16)
+/* Drift in 1/DRIFT_SCALE rtimer ticks per second */
+#define DRIFT_SCALE           16
+#define DRIFT_MAX             (64 * DRIFT_SCALE)
+#endif /* PHASE_LOCK */
+
 struct phase {
   rtimer_clock_t time;
-#if PHASE_DRIFT_CORRECT
+#if PHASE_LOCK
+  rtimer_clock_t expected;
+  clock_time_t sync;
+  int16_t drift;
+  uint8_t locks;
+#elif PHASE_DRIFT_CORRECT
   rtimer_clock_t drift;
 #endif
   uint8_t noacks;
@@ -89,6 +114,52 @@ NBR_TABLE(struct phase, nbr_phase);
 #define PRINTDEBUG(...)
 #endif
 /*---------------------------------------------------------------------------*/
+#if PHASE_LOCK
+/* The phase of the last encounter, moved by the drift since */
+static rtimer_clock_t
+drifted_phase(struct phase *e)
+{
+  clock_time_t age = clock_time() - e->sync;
+  if(age > PHASE_LOCK_MAX_AGE) {
+    age = PHASE_LOCK_MAX_AGE;
+  }
+  return e->time + (int32_t)e->drift * (int32_t)age /
+    (DRIFT_SCALE * (int32_t)CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+/* Compares an encounter with the one phase_wait() expected, and
+   corrects the drift with the error */
+static void
+lock_update(struct phase *e, rtimer_clock_t time)
+{
+  clock_time_t age = clock_time() - e->sync;
+  int32_t error;
+  int32_t drift;
+
+  if(RTIMER_CLOCK_LT(time, e->expected)) {
+    error = -(int32_t)(rtimer_clock_t)(e->expected - time);
+  } else {
+    error = (rtimer_clock_t)(time - e->expected);
+  }
+  if(age >= PHASE_LOCK_DRIFT_AGE && age <= PHASE_LOCK_MAX_AGE) {
+    /* A quarter of the error, as the acked strobe adds jitter */
+    drift = e->drift + error * DRIFT_SCALE * CLOCK_SECOND / (int32_t)age / 4;
+    if(drift > DRIFT_MAX) {
+      drift = DRIFT_MAX;
+    } else if(drift < -DRIFT_MAX) {
+      drift = -DRIFT_MAX;
+    }
+    e->drift = drift;
+  }
+  if(e->locks < 0xff) {
+    e->locks++;
+  }
+  PRINTF("phase lock error %ld drift %d locks %u\n",
+         (long)error, e->drift, e->locks);
+  e->sync = clock_time();
+}
+#endif /* PHASE_LOCK */
+/*---------------------------------------------------------------------------*/
 void
 phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
              int mac_status)
@@ -99,7 +170,9 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
   e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
   if(e != NULL) {
     if(mac_status == MAC_TX_OK) {
-#if PHASE_DRIFT_CORRECT
+#if PHASE_LOCK
+      lock_update(e, time);
+#elif PHASE_DRIFT_CORRECT
       e->drift = time-e->time;
 #endif
       e->time = time;
@@ -110,6 +183,11 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
     if(mac_status == MAC_TX_NOACK) {
       PRINTF("phase noacks %d to %d.%d\n", e->noacks, neighbor->u8[0], neighbor->u8[1]);
       e->noacks++;
+#if PHASE_LOCK
+      /* Missed within the margin: use the full guard time until
+         locked again */
+      e->locks = 0;
+#endif
       if(e->noacks == 1) {
         timer_set(&e->noacks_timer, MAX_NOACKS_TIME);
       }
@@ -127,7 +205,12 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
       e = nbr_table_add_lladdr(nbr_phase, neighbor);
       if(e) {
         e->time = time;
-#if PHASE_DRIFT_CORRECT
+#if PHASE_LOCK
+        e->expected = time;
+        e->sync = clock_time();
+        e->drift = 0;
+        e->locks = 0;
+#elif PHASE_DRIFT_CORRECT
       e->drift = 0;
 #endif
       e->noacks = 0;
@@ -187,7 +270,9 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
 
     sync = (e == NULL) ? now : e->time;
 
-#if PHASE_DRIFT_CORRECT
+#if PHASE_LOCK
+    sync = drifted_phase(e);
+#elif PHASE_DRIFT_CORRECT
     {
       int32_t s;
       if(e->drift > cycle_time) {
@@ -210,6 +295,9 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
     if(wait < guard_time) {
       wait += cycle_time;
     }
+#if PHASE_LOCK
+    e->expected = now + wait;
+#endif
 
     ctimewait = (CLOCK_SECOND * (wait - guard_time)) / RTIMER_ARCH_SECOND;
 
@@ -240,6 +328,32 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
   return PHASE_UNKNOWN;
 }
 /*---------------------------------------------------------------------------*/
+#if PHASE_LOCK
+/* How early to expect the neighbor: min_margin once locked, plus the
+   drift that may be left since the last encounter. max_margin if not
+   locked */
+rtimer_clock_t
+phase_lock_margin(const linkaddr_t *neighbor,
+                  rtimer_clock_t min_margin, rtimer_clock_t max_margin)
+{
+  struct phase *e;
+  clock_time_t age;
+  uint32_t margin;
+
+  e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e == NULL || e->locks < PHASE_LOCK_MIN_LOCKS) {
+    return max_margin;
+  }
+  age = clock_time() - e->sync;
+  if(age > PHASE_LOCK_MAX_AGE) {
+    return max_margin;
+  }
+  margin = min_margin + (uint32_t)age * PHASE_LOCK_PPM / CLOCK_SECOND *
+    RTIMER_ARCH_SECOND / 1000000;
+  return margin < max_margin ? margin : max_margin;
+}
+#endif /* PHASE_LOCK */
+/*---------------------------------------------------------------------------*/
 void
 phase_init(void)
 {
@@ -47,6 +47,15 @@
 #include "lib/memb.h"
 #include "net/netstack.h"
 
+/* Phase lock: track the clock drift of every neighbor, and only wake
+   up and strobe as early as the uncertainty since the last encounter
+   requires */
+#ifdef PHASE_CONF_LOCK
+#define PHASE_LOCK PHASE_CONF_LOCK
+#else
+#define PHASE_LOCK 0
+#endif
+
 typedef enum {
   PHASE_UNKNOWN,
   PHASE_SEND_NOW,
@@ -62,5 +71,10 @@ phase_status_t phase_wait(const linkaddr_t *neighbor,
 void phase_update(const linkaddr_t *neighbor,
                   rtimer_clock_t time, int mac_status);
 void phase_remove(const linkaddr_t *neighbor);
+#if PHASE_LOCK
+rtimer_clock_t phase_lock_margin(const linkaddr_t *neighbor,
+                                 rtimer_clock_t min_margin,
+                                 rtimer_clock_t max_margin);
+#endif /* PHASE_LOCK */
 
 #endif /* PHASE_H */
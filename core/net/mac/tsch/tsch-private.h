@@ -59,6 +59,14 @@
 #define TSCH_DESYNC_THRESHOLD (4 * TSCH_KEEPALIVE_TIMEOUT)
 #endif
 
+/* With multiple time sources: time without sync after which the primary
+ * time source is considered stale and replaced by a fresh secondary one */
+#ifdef TSCH_CONF_TIME_SOURCE_STALE_TIMEOUT
+#define TSCH_TIME_SOURCE_STALE_TIMEOUT TSCH_CONF_TIME_SOURCE_STALE_TIMEOUT
+#else
+#define TSCH_TIME_SOURCE_STALE_TIMEOUT (2 * TSCH_KEEPALIVE_TIMEOUT)
+#endif
+
 /* Min period between two consecutive EBs */
 #ifdef TSCH_CONF_MIN_EB_PERIOD
 #define TSCH_MIN_EB_PERIOD TSCH_CONF_MIN_EB_PERIOD
@@ -94,6 +102,14 @@
 #define TSCH_MAX_LINKS 32
 #endif
 
+/* Number of channels in the hopping sequence. Valid channel offsets
+ * are 0..TSCH_N_CHANNELS-1 */
+#ifdef TSCH_CONF_N_CHANNELS
+#define TSCH_N_CHANNELS TSCH_CONF_N_CHANNELS
+#else
+#define TSCH_N_CHANNELS 16
+#endif /* TSCH_CONF_N_CHANNELS */
+
 /* TSCH MAC parameters */
 #define MAC_MIN_BE 0
 #define MAC_MAX_FRAME_RETRIES 8
@@ -187,6 +203,9 @@ struct asn_divisor_t {
 extern const linkaddr_t tsch_broadcast_address;
 /* The address we use to identify EB queue */
 extern const linkaddr_t tsch_eb_address;
+/* The address we use to identify the multicast queue,
+ * with TSCH_WITH_MULTICAST_QUEUE */
+extern const linkaddr_t tsch_multicast_address;
 
 /* The current Absolute Slot Number (ASN) */
 extern struct asn_t current_asn;
@@ -270,4 +289,7 @@ void tsch_dump_status();
 
 #endif /* CONTIKI_TARGET_JN5168 */
 
+/* Convert a number of slots to clock ticks (rounded down) */
+#define TSCH_SLOTS_TO_CLOCK(s) ((clock_time_t)(((uint32_t)(s) * TsSlotDuration * CLOCK_SECOND) / RTIMER_SECOND))
+
 #endif /* __TSCH_PRIVATE_H__ */
@@ -58,9 +58,17 @@
 void TSCH_CALLBACK_NEW_TIME_SOURCE(struct tsch_neighbor *old, struct tsch_neighbor *new);
 #endif
 
+#ifdef TSCH_CALLBACK_QUEUE_CONGESTION
+void TSCH_CALLBACK_QUEUE_CONGESTION(uint8_t congested);
+#endif
+
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
+#ifndef ABS
+#define ABS(x) ((x) < 0 ? -(x) : (x))
+#endif
+
 /* We have as many packets are there are queuebuf in the system */
 MEMB(packet_memb, struct tsch_packet, QUEUEBUF_NUM);
 MEMB(neighbor_memb, struct tsch_neighbor, TSCH_QUEUE_MAX_NEIGHBOR_QUEUES);
@@ -69,6 +77,12 @@ LIST(neighbor_list);
 /* Broadcast and EB virtual neighbors */
 struct tsch_neighbor *n_broadcast;
 struct tsch_neighbor *n_eb;
+#if TSCH_WITH_MULTICAST_QUEUE
+struct tsch_neighbor *n_multicast;
+#endif
+
+/* Are the queues congested? See TSCH_QUEUE_HIGH_WATERMARK */
+static uint8_t congested;
 
 /**
  *  A pseudo-random generator with better properties than msp430-libc's default
@@ -104,7 +118,11 @@ tsch_queue_add_nbr(const linkaddr_t *addr)
         ringbufindex_init(&n->tx_ringbuf, TSCH_QUEUE_NUM_PER_NEIGHBOR);
         linkaddr_copy(&n->addr, addr);
         n->is_broadcast = linkaddr_cmp(addr, &tsch_eb_address)
-                    || linkaddr_cmp(addr, &tsch_broadcast_address);
+                    || linkaddr_cmp(addr, &tsch_broadcast_address)
+#if TSCH_WITH_MULTICAST_QUEUE
+                    || linkaddr_cmp(addr, &tsch_multicast_address)
+#endif
+                    ;
         tsch_queue_backoff_reset(n);
         /* Add neighbor to the list */
         list_add(neighbor_list, n);
@@ -138,23 +156,71 @@ tsch_queue_get_nbr(const linkaddr_t *addr)
   }
   return NULL;
 }
-/* Get a TSCH time source (we currently assume there is only one) */
+/* Get the primary TSCH time source, i.e. the time source with highest weight */
 struct tsch_neighbor *
 tsch_queue_get_time_source()
 {
   if(!tsch_is_locked()) {
+    struct tsch_neighbor *best = NULL;
     struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
     while(curr_nbr != NULL) {
-      if(curr_nbr->is_time_source) {
-        return curr_nbr;
+      if(curr_nbr->is_time_source
+          && (best == NULL || curr_nbr->time_source_weight > best->time_source_weight)) {
+        best = curr_nbr;
       }
       curr_nbr = list_item_next(curr_nbr);
     }
+    return best;
   }
   return NULL;
 }
-
-/* Update TSCH time source */
+/* Returns the number of time sources */
+int
+tsch_queue_time_source_count()
+{
+  int count = 0;
+  if(!tsch_is_locked()) {
+    struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
+    while(curr_nbr != NULL) {
+      count += curr_nbr->is_time_source != 0;
+      curr_nbr = list_item_next(curr_nbr);
+    }
+  }
+  return count;
+}
+/* Mark a neighbor as time source with a given weight */
+static void
+tsch_queue_set_time_source(struct tsch_neighbor *n, uint8_t weight)
+{
+  if(!n->is_time_source) {
+    n->drift_estimate = 0;
+    n->last_sync_asn = current_asn.ls4b;
+  }
+  n->time_source_weight = weight;
+  n->is_time_source = 1;
+}
+/* Remove the secondary time source with the lowest weight (the oldest sync wins ties) */
+static void
+tsch_queue_evict_secondary_time_source(const struct tsch_neighbor *primary)
+{
+  struct tsch_neighbor *worst = NULL;
+  struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
+  while(curr_nbr != NULL) {
+    if(curr_nbr->is_time_source && curr_nbr != primary
+        && (worst == NULL
+            || curr_nbr->time_source_weight < worst->time_source_weight
+            || (curr_nbr->time_source_weight == worst->time_source_weight
+                && (int32_t)(curr_nbr->last_sync_asn - worst->last_sync_asn) < 0))) {
+      worst = curr_nbr;
+    }
+    curr_nbr = list_item_next(curr_nbr);
+  }
+  if(worst != NULL) {
+    worst->is_time_source = 0;
+    worst->time_source_weight = 0;
+  }
+}
+/* Update TSCH primary time source */
 int
 tsch_queue_update_time_source(const linkaddr_t *new_addr)
 {
@@ -163,6 +229,16 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
       struct tsch_neighbor *old_time_src = tsch_queue_get_time_source();
       struct tsch_neighbor *new_time_src = new_addr ? tsch_queue_add_nbr(new_addr) : NULL;
 
+      if(new_addr == NULL) {
+        /* Remove all time sources */
+        struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
+        while(curr_nbr != NULL) {
+          curr_nbr->is_time_source = 0;
+          curr_nbr->time_source_weight = 0;
+          curr_nbr = list_item_next(curr_nbr);
+        }
+      }
+
       if(new_time_src != old_time_src) {
         /*
         LOG("TSCH: update time source: %u -> %u\n",
@@ -171,12 +247,22 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
             */
 
         /* Update time source */
-        if(new_time_src != NULL) {
-          new_time_src->is_time_source = 1;
-        }
-
         if(old_time_src != NULL) {
+#if TSCH_MAX_TIME_SOURCES > 1
+          /* Keep the old primary as secondary time source */
+          old_time_src->time_source_weight = TSCH_TIME_SOURCE_SECONDARY_WEIGHT;
+#else
           old_time_src->is_time_source = 0;
+          old_time_src->time_source_weight = 0;
+#endif
+        }
+
+        if(new_time_src != NULL) {
+          if(!new_time_src->is_time_source
+              && tsch_queue_time_source_count() >= TSCH_MAX_TIME_SOURCES) {
+            tsch_queue_evict_secondary_time_source(NULL);
+          }
+          tsch_queue_set_time_source(new_time_src, TSCH_TIME_SOURCE_MAX_WEIGHT);
         }
 
 #ifdef TSCH_CALLBACK_NEW_TIME_SOURCE
@@ -189,6 +275,110 @@ tsch_queue_update_time_source(const linkaddr_t *new_addr)
   }
   return 0;
 }
+/* Add a secondary TSCH time source */
+int
+tsch_queue_add_time_source(const linkaddr_t *addr)
+{
+  if(!tsch_is_locked() && !tsch_is_coordinator && addr != NULL) {
+    struct tsch_neighbor *primary = tsch_queue_get_time_source();
+    struct tsch_neighbor *n;
+    if(primary == NULL) {
+      /* No time source yet: this one becomes the primary */
+      return tsch_queue_update_time_source(addr);
+    }
+    n = tsch_queue_add_nbr(addr);
+    if(n != NULL) {
+      if(n->is_time_source) {
+        return 1;
+      }
+      if(tsch_queue_time_source_count() >= TSCH_MAX_TIME_SOURCES) {
+        tsch_queue_evict_secondary_time_source(primary);
+      }
+      if(tsch_queue_time_source_count() < TSCH_MAX_TIME_SOURCES) {
+        tsch_queue_set_time_source(n, TSCH_TIME_SOURCE_SECONDARY_WEIGHT);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+/* Remove a (primary or secondary) TSCH time source */
+int
+tsch_queue_remove_time_source(const linkaddr_t *addr)
+{
+  if(!tsch_is_locked()) {
+    struct tsch_neighbor *n = tsch_queue_get_nbr(addr);
+    if(n != NULL && n->is_time_source) {
+      struct tsch_neighbor *primary = tsch_queue_get_time_source();
+      n->is_time_source = 0;
+      n->time_source_weight = 0;
+      if(n == primary) {
+        /* Promote the best remaining secondary, if any */
+        struct tsch_neighbor *new_primary = tsch_queue_get_time_source();
+        if(new_primary != NULL) {
+          new_primary->time_source_weight = TSCH_TIME_SOURCE_MAX_WEIGHT;
+        }
+#ifdef TSCH_CALLBACK_NEW_TIME_SOURCE
+        TSCH_CALLBACK_NEW_TIME_SOURCE(n, new_primary);
+#endif
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+/* Record a synchronization with time source n. Returns the drift correction to apply */
+int32_t
+tsch_queue_time_source_synced(struct tsch_neighbor *n, int32_t drift, const struct asn_t *asn)
+{
+  if(n == NULL || !n->is_time_source) {
+    return 0;
+  }
+  n->last_sync_asn = asn->ls4b;
+  /* EWMA with alpha 1/4 */
+  n->drift_estimate = (int16_t)((3 * (int32_t)n->drift_estimate + drift) / 4);
+  return drift * n->time_source_weight / TSCH_TIME_SOURCE_MAX_WEIGHT;
+}
+/* Promote the best secondary time source if the primary is stale */
+int
+tsch_queue_time_source_failover(const struct asn_t *asn, uint32_t stale_slots)
+{
+  if(!tsch_is_locked() && !tsch_is_coordinator) {
+    struct tsch_neighbor *primary = tsch_queue_get_time_source();
+    struct tsch_neighbor *best = NULL;
+    struct tsch_neighbor *curr_nbr;
+    if(primary != NULL && primary->is_time_source
+        && asn->ls4b - primary->last_sync_asn <= stale_slots) {
+      /* Primary is fresh, nothing to do */
+      return 0;
+    }
+    /* Pick the freshest secondary, among those synced since the primary went
+     * silent pick the one whose clock is closest to ours */
+    curr_nbr = list_head(neighbor_list);
+    while(curr_nbr != NULL) {
+      if(curr_nbr->is_time_source && curr_nbr != primary
+          && asn->ls4b - curr_nbr->last_sync_asn <= stale_slots) {
+        if(best == NULL
+            || ABS(curr_nbr->drift_estimate) < ABS(best->drift_estimate)) {
+          best = curr_nbr;
+        }
+      }
+      curr_nbr = list_item_next(curr_nbr);
+    }
+    if(best != NULL) {
+      if(primary != NULL && primary->is_time_source) {
+        /* Demote the stale primary to the lowest weight */
+        primary->time_source_weight = 1;
+      }
+      best->time_source_weight = TSCH_TIME_SOURCE_MAX_WEIGHT;
+#ifdef TSCH_CALLBACK_NEW_TIME_SOURCE
+      TSCH_CALLBACK_NEW_TIME_SOURCE(primary, best);
+#endif
+      return 1;
+    }
+  }
+  return 0;
+}
 /* Flush a neighbor queue */
 static void
 tsch_queue_flush_nbr_queue(struct tsch_neighbor *n)
@@ -229,6 +419,37 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
     }
   }
 }
+/* Set the congestion state and report it */
+static void
+tsch_queue_set_congested(uint8_t c)
+{
+  congested = c;
+  PRINTF("TSCH-queue: congestion %u, %d packets\n", c, tsch_queue_global_packet_count());
+#ifdef TSCH_CALLBACK_QUEUE_CONGESTION
+  TSCH_CALLBACK_QUEUE_CONGESTION(c);
+#endif
+}
+/* Update the congestion state after a packet was added to n, or after a
+ * packet was freed (n == NULL). Process context only. */
+static void
+tsch_queue_update_congestion(const struct tsch_neighbor *n)
+{
+  if(!congested) {
+    if(tsch_queue_global_packet_count() >= TSCH_QUEUE_POOL_HIGH_WATERMARK
+       || (n != NULL && n != n_eb
+           && tsch_queue_nbr_packet_count(n) >= TSCH_QUEUE_HIGH_WATERMARK)) {
+      tsch_queue_set_congested(1);
+    }
+  } else if(tsch_queue_global_packet_count() <= TSCH_QUEUE_POOL_LOW_WATERMARK) {
+    struct tsch_neighbor *curr;
+    for(curr = list_head(neighbor_list); curr != NULL; curr = list_item_next(curr)) {
+      if(curr != n_eb && tsch_queue_nbr_packet_count(curr) > TSCH_QUEUE_LOW_WATERMARK) {
+        return;
+      }
+    }
+    tsch_queue_set_congested(0);
+  }
+}
 /* Add packet to neighbor queue. Use same lockfree implementation as ringbuf.c (put is atomic) */
 int
 tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
@@ -253,12 +474,18 @@ tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
             /* Add to ringbuf (actual add committed through atomic operation) */
             n->tx_array[put_index] = p;
             ringbufindex_put(&n->tx_ringbuf);
+            tsch_queue_update_congestion(n);
             return 1;
           } else {
             memb_free(&packet_memb, p);
           }
         }
       }
+      /* Full queue or pool. Only when some packet is queued, that will
+       * clear the congestion once freed */
+      if(!congested && tsch_queue_global_packet_count() > 0) {
+        tsch_queue_set_congested(1);
+      }
     }
   }
   PRINTF("TSCH-queue:! add packet failed: %u %p %d %p %p", tsch_is_locked(), n, put_index, p, p ? p->qb : NULL);
@@ -277,6 +504,37 @@ tsch_queue_packet_count(const linkaddr_t *addr)
   }
   return -1;
 }
+/* Returns the number of packets currently in the queue of a neighbor */
+int
+tsch_queue_nbr_packet_count(const struct tsch_neighbor *n)
+{
+  return n != NULL ? ringbufindex_elements(&n->tx_ringbuf) : 0;
+}
+/* Returns the number of packets currently in all queues, not yet freed */
+int
+tsch_queue_global_packet_count(void)
+{
+  return QUEUEBUF_NUM - memb_numfree(&packet_memb);
+}
+/* Are the queues congested? */
+int
+tsch_queue_is_congested(void)
+{
+  return congested;
+}
+/* Is the queue to a neighbor, or the shared pool, above its high watermark? */
+int
+tsch_queue_nbr_is_congested(const linkaddr_t *addr)
+{
+  if(tsch_queue_global_packet_count() >= TSCH_QUEUE_POOL_HIGH_WATERMARK) {
+    return 1;
+  }
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    addr = &tsch_broadcast_address;
+  }
+  return tsch_queue_nbr_packet_count(tsch_queue_get_nbr(addr))
+    >= TSCH_QUEUE_HIGH_WATERMARK;
+}
 /* Remove first packet from a neighbor queue */
 struct tsch_packet *
 tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n)
@@ -301,6 +559,7 @@ tsch_queue_free_packet(struct tsch_packet *p)
   if(p != NULL) {
     queuebuf_free(p->qb);
     memb_free(&packet_memb, p);
+    tsch_queue_update_congestion(NULL);
   }
 }
 /* Flush all neighbor queues */
@@ -443,9 +702,13 @@ tsch_queue_init(void)
       *((uint32_t *)&linkaddr_node_addr + 1));
   memb_init(&neighbor_memb);
   memb_init(&packet_memb);
+  congested = 0;
   /* Add virtual EB and the broadcast neighbors */
   n_eb = tsch_queue_add_nbr(&tsch_eb_address);
   n_broadcast = tsch_queue_add_nbr(&tsch_broadcast_address);
+#if TSCH_WITH_MULTICAST_QUEUE
+  n_multicast = tsch_queue_add_nbr(&tsch_multicast_address);
+#endif
 }
 /* Testing the module */
 int
@@ -557,8 +820,9 @@ tsch_queue_dump_nbrs()
     while(curr_nbr != NULL) {
       void uip_debug_lladdr_print(const uip_lladdr_t *addr);
       uip_debug_lladdr_print((uip_lladdr_t *)&curr_nbr->addr);
-      printf(" %u %u %u %u\n", !curr_nbr->is_broadcast, !curr_nbr->is_time_source,
-          tsch_queue_is_empty(curr_nbr), tsch_queue_backoff_expired(curr_nbr));
+      printf(" %u %u %u %u %u %d\n", !curr_nbr->is_broadcast, !curr_nbr->is_time_source,
+          tsch_queue_is_empty(curr_nbr), tsch_queue_backoff_expired(curr_nbr),
+          curr_nbr->time_source_weight, curr_nbr->drift_estimate);
       /* Get next in list */
       curr_nbr = list_item_next(curr_nbr);
     }
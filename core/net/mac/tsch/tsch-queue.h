@@ -47,6 +47,7 @@
 #include "contiki.h"
 #include "lib/ringbufindex.h"
 #include "net/linkaddr.h"
+#include "net/queuebuf.h"
 
 /* The maximum number of packets in the system: must be power of two to enable atomic ringbuf operations */
 #ifdef TSCH_CONF_QUEUE_NUM_PER_NEIGHBOR
@@ -65,6 +66,67 @@
 #define TSCH_QUEUE_MAX_NEIGHBOR_QUEUES 8
 #endif
 
+/* Congestion watermarks, in packets. The queues are congested as soon as
+ * a neighbor queue (other than the EB one) reaches TSCH_QUEUE_HIGH_WATERMARK
+ * or all queues together hold TSCH_QUEUE_POOL_HIGH_WATERMARK packets. They
+ * are no longer congested once every neighbor queue is back to
+ * TSCH_QUEUE_LOW_WATERMARK and all together to TSCH_QUEUE_POOL_LOW_WATERMARK.
+ * Transitions are reported through TSCH_CALLBACK_QUEUE_CONGESTION. */
+#ifdef TSCH_CONF_QUEUE_HIGH_WATERMARK
+#define TSCH_QUEUE_HIGH_WATERMARK TSCH_CONF_QUEUE_HIGH_WATERMARK
+#else
+#define TSCH_QUEUE_HIGH_WATERMARK (TSCH_QUEUE_NUM_PER_NEIGHBOR * 3 / 4)
+#endif
+
+#ifdef TSCH_CONF_QUEUE_LOW_WATERMARK
+#define TSCH_QUEUE_LOW_WATERMARK TSCH_CONF_QUEUE_LOW_WATERMARK
+#else
+#define TSCH_QUEUE_LOW_WATERMARK (TSCH_QUEUE_NUM_PER_NEIGHBOR / 4)
+#endif
+
+#ifdef TSCH_CONF_QUEUE_POOL_HIGH_WATERMARK
+#define TSCH_QUEUE_POOL_HIGH_WATERMARK TSCH_CONF_QUEUE_POOL_HIGH_WATERMARK
+#else
+#define TSCH_QUEUE_POOL_HIGH_WATERMARK (QUEUEBUF_NUM * 3 / 4)
+#endif
+
+#ifdef TSCH_CONF_QUEUE_POOL_LOW_WATERMARK
+#define TSCH_QUEUE_POOL_LOW_WATERMARK TSCH_CONF_QUEUE_POOL_LOW_WATERMARK
+#else
+#define TSCH_QUEUE_POOL_LOW_WATERMARK (QUEUEBUF_NUM / 4)
+#endif
+
+/* A separate virtual neighbor queue for multicast data, sent in cells of
+ * its own (e.g. scheduled along the DODAG depth) rather than in the shared
+ * broadcast ones. Which broadcast frames are multicast data is decided by
+ * TSCH_CALLBACK_IS_MULTICAST. Without Tx cells, they stay broadcast. */
+#ifdef TSCH_CONF_WITH_MULTICAST_QUEUE
+#define TSCH_WITH_MULTICAST_QUEUE TSCH_CONF_WITH_MULTICAST_QUEUE
+#else
+#define TSCH_WITH_MULTICAST_QUEUE 0
+#endif
+
+/* Max number of concurrent time sources. The primary one is used for keepalives
+ * and EB join priority; all of them are used for drift correction, weighted.
+ * Secondary time sources allow instantaneous failover when the primary goes silent. */
+#ifdef TSCH_CONF_MAX_TIME_SOURCES
+#define TSCH_MAX_TIME_SOURCES TSCH_CONF_MAX_TIME_SOURCES
+#else
+#define TSCH_MAX_TIME_SOURCES 1
+#endif
+
+/* Weight of the primary time source. A drift measured against a time source of weight w
+ * is applied as drift * w / TSCH_TIME_SOURCE_MAX_WEIGHT */
+#define TSCH_TIME_SOURCE_MAX_WEIGHT 8
+/* Initial weight of a secondary time source */
+#ifdef TSCH_CONF_TIME_SOURCE_SECONDARY_WEIGHT
+#define TSCH_TIME_SOURCE_SECONDARY_WEIGHT TSCH_CONF_TIME_SOURCE_SECONDARY_WEIGHT
+#else
+#define TSCH_TIME_SOURCE_SECONDARY_WEIGHT (TSCH_TIME_SOURCE_MAX_WEIGHT / 2)
+#endif
+
+struct asn_t;
+
 /* TSCH packet information */
 struct tsch_packet {
   struct queuebuf *qb;  /* pointer to the queuebuf to be sent */
@@ -81,6 +143,9 @@ struct tsch_neighbor {
   linkaddr_t addr; /* MAC address of the neighbor */
   uint8_t is_broadcast; /* is this neighbor a virtual neighbor used for broadcast (of data packets or EBs) */
   uint8_t is_time_source; /* is this neighbor a time source? */
+  uint8_t time_source_weight; /* weight of the drift corrections from this time source */
+  int16_t drift_estimate; /* smoothed drift measured against this time source, in rtimer ticks */
+  uint32_t last_sync_asn; /* ASN (4 lsb) of the last synchronization with this time source */
   uint8_t backoff_exponent; /* CSMA backoff exponent */
   uint8_t backoff_window; /* CSMA backoff window (number of slots to skip) */
   uint8_t last_backoff_window; /* Last CSMA backoff window */
@@ -96,19 +161,47 @@ struct tsch_neighbor {
 /* Broadcast and EB virtual neighbors */
 extern struct tsch_neighbor *n_broadcast;
 extern struct tsch_neighbor *n_eb;
+#if TSCH_WITH_MULTICAST_QUEUE
+/* Multicast virtual neighbor */
+extern struct tsch_neighbor *n_multicast;
+#endif
 
 /* Add a TSCH neighbor */
 struct tsch_neighbor *tsch_queue_add_nbr(const linkaddr_t *addr);
 /* Get a TSCH neighbor */
 struct tsch_neighbor *tsch_queue_get_nbr(const linkaddr_t *addr);
-/* Get a TSCH time source (we currently assume there is only one) */
+/* Get the primary TSCH time source */
 struct tsch_neighbor *tsch_queue_get_time_source();
-/* Update TSCH time source */
+/* Update TSCH primary time source. The previous primary is kept as a secondary
+ * time source if TSCH_MAX_TIME_SOURCES > 1. A NULL address removes all time sources. */
 int tsch_queue_update_time_source(const linkaddr_t *new_addr);
+/* Add a secondary TSCH time source */
+int tsch_queue_add_time_source(const linkaddr_t *addr);
+/* Remove a (primary or secondary) TSCH time source. Returns 0 if addr is not
+ * a time source or if TSCH is locked */
+int tsch_queue_remove_time_source(const linkaddr_t *addr);
+/* Returns the number of time sources */
+int tsch_queue_time_source_count();
+/* Record a synchronization with time source n at ASN asn. Returns the drift
+ * correction to apply, i.e., drift weighted by the time source weight.
+ * Interrupt-safe: only touches n. */
+int32_t tsch_queue_time_source_synced(struct tsch_neighbor *n, int32_t drift, const struct asn_t *asn);
+/* Promote the best secondary time source if the primary was not heard from
+ * for more than stale_slots. Returns 1 if the primary time source changed */
+int tsch_queue_time_source_failover(const struct asn_t *asn, uint32_t stale_slots);
 /* Add packet to neighbor queue. Use same lockfree implementation as ringbuf.c (put is atomic) */
 int tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr);
 /* Returns the number of packets currently in the queue */
 int tsch_queue_packet_count(const linkaddr_t *addr);
+/* Returns the number of packets currently in the queue of a neighbor */
+int tsch_queue_nbr_packet_count(const struct tsch_neighbor *n);
+/* Returns the number of packets currently in all queues, not yet freed */
+int tsch_queue_global_packet_count(void);
+/* Are the queues congested? See TSCH_QUEUE_HIGH_WATERMARK */
+int tsch_queue_is_congested(void);
+/* Is the queue to a neighbor (linkaddr_null: broadcast), or the pool of all
+ * queues, above its high watermark? Suits TCPIP_CALLBACK_NBR_CONGESTED */
+int tsch_queue_nbr_is_congested(const linkaddr_t *addr);
 /* Remove first packet from a neighbor queue. The packet is stored in a seprate
  * dequeued packet list, for later processing. Return the packet. */
 struct tsch_packet *tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n);
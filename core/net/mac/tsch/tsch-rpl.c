@@ -45,6 +45,8 @@
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
 /* To use, set #define TSCH_CALLBACK_JOINING_NETWORK tsch_rpl_callback_joining_network */
 void
 tsch_rpl_callback_joining_network()
@@ -71,6 +73,25 @@ tsch_rpl_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbo
   /* We currently do not need to do anything here */
 }
 
+/* Feed the RSSI of EBs to RPL's link estimates, so that RPL probes
+ * its candidate parents less often.
+ * To use, set #define TSCH_CALLBACK_EB_RECEIVED tsch_rpl_callback_eb_received */
+void
+tsch_rpl_callback_eb_received(const linkaddr_t *src, int16_t rssi)
+{
+  rpl_link_rssi_callback(src, rssi);
+}
+
+/* Tell TSCH whether the frame being sent carries routable multicast,
+ * e.g. forwarded down the DODAG by SMRF, for the multicast queue.
+ * 6LoWPAN sends synchronously, the IPv6 packet is still in uip_buf.
+ * To use, set #define TSCH_CALLBACK_IS_MULTICAST tsch_rpl_callback_is_multicast */
+int
+tsch_rpl_callback_is_multicast(void)
+{
+  return uip_is_addr_mcast_routable(&UIP_IP_BUF->destipaddr);
+}
+
 /* Set TSCH EB period based on current RPL DIO period.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_new_dio_interval */
 void
@@ -79,6 +100,14 @@ tsch_rpl_callback_new_dio_interval(uint8_t dio_interval)
   tsch_set_eb_period(((1UL << dio_interval) * CLOCK_SECOND) / 1000UL);
 }
 
+/* Stop using a removed RPL parent as a time source.
+ * To use, set #define RPL_CALLBACK_REMOVE_PARENT tsch_rpl_callback_remove_parent */
+void
+tsch_rpl_callback_remove_parent(rpl_parent_t *p)
+{
+  tsch_queue_remove_time_source(nbr_table_get_lladdr(rpl_parents, p));
+}
+
 /* Set TSCH time source based on current RPL preferred parent.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_parent_switch */
 void
@@ -93,6 +122,21 @@ tsch_rpl_callback_parent_switch(rpl_parent_t *old, rpl_parent_t *new)
             (const linkaddr_t *)uip_ds6_nbr_lladdr_from_ipaddr(
                 rpl_get_parent_ipaddr(preferred_parent)));
       }
+#if TSCH_MAX_TIME_SOURCES > 1
+      /* Use the other parents with lower rank than ours as secondary time
+       * sources, and drop those that no longer qualify */
+      rpl_parent_t *p = nbr_table_head(rpl_parents);
+      while(p != NULL) {
+        if(p != preferred_parent) {
+          if(p->dag == dag && p->rank < dag->rank) {
+            tsch_queue_add_time_source(nbr_table_get_lladdr(rpl_parents, p));
+          } else {
+            tsch_queue_remove_time_source(nbr_table_get_lladdr(rpl_parents, p));
+          }
+        }
+        p = nbr_table_next(rpl_parents, p);
+      }
+#endif
     }
   }
 }
@@ -46,9 +46,20 @@ void tsch_rpl_callback_leaving_network();
 /* Called whenever TSCH swtiches time source
 To use, set #define TSCH_CALLBACK_NEW_TIME_SOURCE tsch_rpl_callback_new_time_source */
 void tsch_rpl_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new);
+/* Feed the RSSI of EBs to RPL's link estimates, so that RPL probes
+ * its candidate parents less often.
+ * To use, set #define TSCH_CALLBACK_EB_RECEIVED tsch_rpl_callback_eb_received */
+void tsch_rpl_callback_eb_received(const linkaddr_t *src, int16_t rssi);
+/* Tell TSCH whether the frame being sent carries routable multicast,
+ * e.g. forwarded down the DODAG by SMRF, for the multicast queue.
+ * To use, set #define TSCH_CALLBACK_IS_MULTICAST tsch_rpl_callback_is_multicast */
+int tsch_rpl_callback_is_multicast(void);
 /* Set TSCH EB period based on current RPL DIO period.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_new_dio_interval */
 void tsch_rpl_callback_new_dio_interval(uint8_t dio_interval);
 /* Set TSCH time source based on current RPL preferred parent.
  * To use, set #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_parent_switch */
 void tsch_rpl_callback_parent_switch(rpl_parent_t *old, rpl_parent_t *new);
+/* Stop using a removed RPL parent as a time source.
+ * To use, set #define RPL_CALLBACK_REMOVE_PARENT tsch_rpl_callback_remove_parent */
+void tsch_rpl_callback_remove_parent(rpl_parent_t *p);
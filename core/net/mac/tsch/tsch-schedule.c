@@ -373,6 +373,52 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset)
   }
   return curr_earliest_link;
 }
+/* Returns the first Tx link to addr strictly after a given ASN */
+struct tsch_link *
+tsch_schedule_get_next_tx_link(const linkaddr_t *addr, const struct asn_t *asn, struct asn_t *next_asn)
+{
+  uint16_t curr_earliest = 0;
+  struct tsch_link *curr_earliest_link = NULL;
+  if(!tsch_is_locked() && addr != NULL) {
+    struct tsch_neighbor *n;
+    int use_shared_broadcast;
+    struct tsch_slotframe *sf;
+    if(linkaddr_cmp(addr, &linkaddr_null)) {
+      /* Contiki's broadcast address, mapped by TSCH to its broadcast neighbor */
+      addr = &tsch_broadcast_address;
+    }
+    n = tsch_queue_get_nbr(addr);
+    /* Packets for neighbors we have no Tx link to go in broadcast links */
+    use_shared_broadcast = n == NULL || n->tx_links_count == 0;
+    sf = list_head(slotframe_list);
+    while(sf != NULL) {
+      uint16_t timeslot = ASN_MOD(*asn, sf->size);
+      struct tsch_link *l = list_head(sf->links_list);
+      while(l != NULL) {
+        if((l->link_options & LINK_OPTION_TX)
+            && l->link_type != LINK_TYPE_ADVERTISING_ONLY
+            && (linkaddr_cmp(&l->addr, addr)
+                || (use_shared_broadcast && linkaddr_cmp(&l->addr, &tsch_broadcast_address)))) {
+          uint16_t time_to_timeslot =
+            l->timeslot > timeslot ?
+            l->timeslot - timeslot :
+            sf->size.val + l->timeslot - timeslot;
+          if(curr_earliest == 0 || time_to_timeslot < curr_earliest) {
+            curr_earliest = time_to_timeslot;
+            curr_earliest_link = l;
+          }
+        }
+        l = list_item_next(l);
+      }
+      sf = list_item_next(sf);
+    }
+    if(curr_earliest_link != NULL && next_asn != NULL) {
+      *next_asn = *asn;
+      ASN_INC(*next_asn, curr_earliest);
+    }
+  }
+  return curr_earliest_link;
+}
 void
 tsch_schedule_print()
 {
@@ -119,6 +119,10 @@ struct tsch_link *tsch_schedule_get_link_from_timeslot(struct tsch_slotframe *sl
 struct tsch_link *tsch_schedule_get_link_from_asn(struct asn_t *asn);
 /* Returns the next active link after a given ASN */
 struct tsch_link *tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset);
+/* Returns the first Tx link to addr strictly after a given ASN, and writes its ASN in next_asn.
+ * Unicast packets to a neighbor without any Tx link are sent in shared broadcast
+ * links, which are considered as well. */
+struct tsch_link *tsch_schedule_get_next_tx_link(const linkaddr_t *addr, const struct asn_t *asn, struct asn_t *next_asn);
 /* Create a 6TiSCH minimal schedule */
 void tsch_schedule_create_minimal();
 
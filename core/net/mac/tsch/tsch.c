@@ -52,6 +52,7 @@
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-schedule.h"
 #include "net/mac/frame802154.h"
+#include "lib/list.h"
 #include "lib/random.h"
 #include "lib/ringbufindex.h"
 #include "sys/process.h"
@@ -88,6 +89,23 @@ void TSCH_CALLBACK_JOINING_NETWORK();
 void TSCH_CALLBACK_LEAVING_NETWORK();
 #endif
 
+#ifdef TSCH_CALLBACK_EB_RECEIVED
+void TSCH_CALLBACK_EB_RECEIVED(const linkaddr_t *src, int16_t rssi);
+#endif
+
+#ifdef TSCH_CALLBACK_NEW_JOIN_PRIORITY
+void TSCH_CALLBACK_NEW_JOIN_PRIORITY(uint8_t join_priority);
+#endif
+
+#if TSCH_WITH_MULTICAST_QUEUE
+#ifndef TSCH_CALLBACK_IS_MULTICAST
+#error TSCH_WITH_MULTICAST_QUEUE requires TSCH_CALLBACK_IS_MULTICAST
+#endif
+/* Returns 1 if the broadcast frame being sent is multicast data
+ * to be sent in the multicast cells */
+int TSCH_CALLBACK_IS_MULTICAST(void);
+#endif
+
 /* When associating, check ASN against our own uptime (time in minutes) */
 #ifdef TSCH_CONF_CHECK_TIME_AT_ASSOCIATION
 #define TSCH_CHECK_TIME_AT_ASSOCIATION TSCH_CONF_CHECK_TIME_AT_ASSOCIATION
@@ -104,12 +122,6 @@ void TSCH_CALLBACK_LEAVING_NETWORK();
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
-#ifdef TSCH_CONF_N_CHANNELS
-#define TSCH_N_CHANNELS TSCH_CONF_N_CHANNELS
-#else
-#define TSCH_N_CHANNELS 16
-#endif /* TSCH_CONF_N_CHANNELS */
-
 #ifdef TSCH_CONF_ADDRESS_FILTER
 #define TSCH_ADDRESS_FILTER TSCH_CONF_ADDRESS_FILTER
 #else
@@ -164,6 +176,10 @@ struct asn_divisor_t hopping_sequence_length;
 const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
 /* Address used for the EB virtual neighbor queue */
 const linkaddr_t tsch_eb_address = { { 0, 0, 0, 0, 0, 0, 0, 0 } };
+#if TSCH_WITH_MULTICAST_QUEUE
+/* Address used for the multicast virtual neighbor queue */
+const linkaddr_t tsch_multicast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe } };
+#endif
 
 /* A global variable telling whether we are coordinator of the TSCH network
  * TODO: have a function to set this */
@@ -195,6 +211,10 @@ static clock_time_t tsch_current_eb_period;
 /* timer for sending keepalive messages */
 static struct ctimer keepalive_timer;
 
+/* Pending ASN-triggered callbacks, and the timer used to wake up for them */
+LIST(asn_callback_list);
+static struct ctimer asn_callback_timer;
+
 /* Ringbuf for dequeued outgoing packets */
 #define DEQUEUED_ARRAY_SIZE 16
 #if DEQUEUED_ARRAY_SIZE < QUEUEBUF_NUM
@@ -320,6 +340,18 @@ void tsch_release_lock() {
   tsch_locked = 0;
 }
 
+/* Set our join priority, i.e. our depth in the time source tree */
+static void
+tsch_set_join_priority(uint8_t join_priority)
+{
+  if(join_priority != tsch_join_priority) {
+    tsch_join_priority = join_priority;
+#ifdef TSCH_CALLBACK_NEW_JOIN_PRIORITY
+    TSCH_CALLBACK_NEW_JOIN_PRIORITY(join_priority);
+#endif
+  }
+}
+
 /*---------------------------------------------------------------------------*/
 static void
 on(void)
@@ -465,6 +497,13 @@ send_packet(mac_callback_t sent, void *ptr)
      * The broadcast address in Contiki is linkaddr_null which is equal
      * to tsch_eb_address */
     addr = &tsch_broadcast_address;
+#if TSCH_WITH_MULTICAST_QUEUE
+    /* Multicast data goes in the multicast cells, if we have any */
+    if(n_multicast != NULL && n_multicast->tx_links_count > 0
+        && TSCH_CALLBACK_IS_MULTICAST()) {
+      addr = &tsch_multicast_address;
+    }
+#endif
   }
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, tsch_packet_seqno);
 
@@ -474,10 +513,15 @@ send_packet(mac_callback_t sent, void *ptr)
     //LOGP("TSCH:! can't send packet due to framer error");
     ret = MAC_TX_ERR;
   } else {
+#if WITH_LOG_LATENCY
+    /* Trace the enqueue time of data packets */
+    LOG_LATENCY_STAMP_ENQUEUE(LOG_APPDATAPTR_FROM_PACKETBUF());
+#endif /* WITH_LOG_LATENCY */
     /* Enqueue packet */
     if(!tsch_queue_add_packet(addr, sent, ptr)) {
       //LOGP("TSCH:! can't send packet !tsch_queue_add_packet");
-      //ret = MAC_TX_ERR;
+      /* Let the upper layers know right away, e.g. for backpressure */
+      ret = MAC_TX_ERR;
     } else {
       /*
       LOGP("TSCH: send packet to %u with seqno %u, queue %u %u",
@@ -572,7 +616,13 @@ static void
 keepalive_send()
 {
   if(associated) {
-    struct tsch_neighbor *n = tsch_queue_get_time_source();
+    struct tsch_neighbor *n;
+    /* Switch to a secondary time source if the primary one went silent */
+    tsch_queue_time_source_failover(&current_asn, TSCH_CLOCK_TO_SLOTS(TSCH_TIME_SOURCE_STALE_TIMEOUT));
+    n = tsch_queue_get_time_source();
+    if(n == NULL) {
+      return;
+    }
     /* Simply send an empty packet */
     /* TODO filter keep alive messages based on packet type
      * (MAC_COMMAND) not data length*/
@@ -738,6 +788,12 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
       if(current_neighbor == n_eb) {
         packet_ready = tsch_packet_update_eb(payload, payload_len);
       }
+#if WITH_LOG_LATENCY
+      else {
+        /* Trace the time of the (last) transmission attempt */
+        LOG_LATENCY_STAMP_DEQUEUE(LOG_APPDATAPTR_FROM_BUFFER(payload, payload_len));
+      }
+#endif /* WITH_LOG_LATENCY */
       /* prepare packet to send: copy to radio buffer */
       if(packet_ready && NETSTACK_RADIO.prepare(payload, payload_len) == 0) { /* 0 means success */
         static rtimer_clock_t tx_duration;
@@ -842,6 +898,9 @@ PT_THREAD(tsch_tx_link(struct pt *pt, struct rtimer *t))
 #else /* TRUNCATE_SYNC_IE */
                   drift_correction = received_drift;
 #endif /* TRUNCATE_SYNC_IE */
+                  /* Weight the correction by the time source's weight */
+                  drift_correction = tsch_queue_time_source_synced(current_neighbor,
+                      drift_correction, &current_asn);
                   drift_neighbor = current_neighbor;
                   /* Keep track of sync time */
                   last_sync_asn = current_asn;
@@ -1019,8 +1078,8 @@ PT_THREAD(tsch_rx_link(struct pt *pt, struct rtimer *t))
             if(n != NULL && n->is_time_source) {
               /* Keep track of last sync time */
               last_sync_asn = current_asn;
-              /* Save estimated drift */
-              drift_correction = -estimated_drift;
+              /* Save estimated drift, weighted by the time source's weight */
+              drift_correction = tsch_queue_time_source_synced(n, -estimated_drift, &current_asn);
               drift_neighbor = n;
               tsch_schedule_keepalive();
             }
@@ -1198,7 +1257,7 @@ PT_THREAD(tsch_associate(struct pt *pt))
     /* We are coordinator, start operating now */
 
     associated = 1;
-    tsch_join_priority = 0;
+    tsch_set_join_priority(0);
 
     //LOG("TSCH: starting, asn-%x.%lx\n",
       //                current_asn.ms1b, current_asn.ls4b);
@@ -1286,7 +1345,7 @@ PT_THREAD(tsch_associate(struct pt *pt))
 
             /* Make our join priority 1 plus what we received.
              * TODO: add a hook for the upper layer (e.g. TSCH) to set the priority */
-            tsch_join_priority++;
+            tsch_set_join_priority(tsch_join_priority + 1);
 
             /* Update global flags */
             associated = 1;
@@ -1378,6 +1437,12 @@ PROCESS_THREAD(tsch_pending_events_process, ev, data)
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
     tsch_rx_process_pending();
     tsch_tx_process_pending();
+#if TSCH_MAX_TIME_SOURCES > 1
+    if(associated) {
+      /* Instantaneous failover to a secondary time source */
+      tsch_queue_time_source_failover(&current_asn, TSCH_CLOCK_TO_SLOTS(TSCH_TIME_SOURCE_STALE_TIMEOUT));
+    }
+#endif
     tsch_log_process_pending();
   }
   PROCESS_END();
@@ -1445,6 +1510,11 @@ tsch_rx_process_pending()
       if(tsch_parse_eb(current_input->payload, current_input->len,
                     &source_address, &eb_asn, &eb_join_priority)) {
 
+#ifdef TSCH_CALLBACK_EB_RECEIVED
+        /* EBs are a free link measurement for the upper layer */
+        TSCH_CALLBACK_EB_RECEIVED(&source_address, (int16_t)current_input->rssi);
+#endif
+
 #if TSCH_EB_AUTOSELECT
         if(!tsch_is_coordinator) {
           /* Maintain EB received counter for every neighbor */
@@ -1473,14 +1543,14 @@ tsch_rx_process_pending()
           /* Update time source */
           if(best_stat != NULL) {
             tsch_queue_update_time_source(nbr_table_get_lladdr(eb_stats, best_stat));
-            tsch_join_priority = best_stat->jp + 1;
+            tsch_set_join_priority(best_stat->jp + 1);
           }
         }
 #endif
 
-        struct tsch_neighbor *n = tsch_queue_get_time_source();
-        /* Did the EB come from our time source? */
-        if(n != NULL && linkaddr_cmp(&source_address, &n->addr)) {
+        struct tsch_neighbor *n = tsch_queue_get_nbr(&source_address);
+        /* Did the EB come from one of our time sources? */
+        if(n != NULL && n->is_time_source) {
           /* Check for ASN drift */
           int32_t asn_diff = ASN_DIFF(current_input->rx_asn, eb_asn);
           if(asn_diff != 0) {
@@ -1502,21 +1572,23 @@ tsch_rx_process_pending()
             LOG("TSCH: corrected ASN by %ld\n", asn_diff);
           }
 
-          /* Update join priority */
-          if(eb_join_priority < TSCH_MAX_JOIN_PRIORITY) {
-            if(tsch_join_priority != eb_join_priority + 1) {
-              /*
-              LOG("TSCH: update JP from EB %u -> %u\n",
-                  tsch_join_priority, eb_join_priority + 1);
-                  */
-              tsch_join_priority = eb_join_priority + 1;
+          /* Update join priority, from the primary time source only */
+          if(n == tsch_queue_get_time_source()) {
+            if(eb_join_priority < TSCH_MAX_JOIN_PRIORITY) {
+              if(tsch_join_priority != eb_join_priority + 1) {
+                /*
+                LOG("TSCH: update JP from EB %u -> %u\n",
+                    tsch_join_priority, eb_join_priority + 1);
+                    */
+                tsch_set_join_priority(eb_join_priority + 1);
+              }
+            } else {
+              /* Join priority unacceptable. Leave network. */
+              LOG("TSCH:! EB JP too high %u, leaving the network\n",
+                  eb_join_priority);
+              associated = 0;
+              process_post(&tsch_process, PROCESS_EVENT_POLL, NULL);
             }
-          } else {
-            /* Join priority unacceptable. Leave network. */
-            LOG("TSCH:! EB JP too high %u, leaving the network\n",
-                eb_join_priority);
-            associated = 0;
-            process_post(&tsch_process, PROCESS_EVENT_POLL, NULL);
           }
         }
       }
@@ -1594,6 +1666,94 @@ PROCESS_THREAD(tsch_send_eb_process, ev, data)
   }
   PROCESS_END();
 }
+/* Get the ASN of the next Tx cell to a neighbor, at least min_slots from now */
+int
+tsch_get_next_tx_asn(const linkaddr_t *addr, uint16_t min_slots, struct asn_t *asn)
+{
+  if(associated) {
+    struct asn_t from = current_asn;
+    /* The link found is strictly after from */
+    if(min_slots > 0) {
+      ASN_INC(from, min_slots - 1);
+    }
+    return tsch_schedule_get_next_tx_link(addr, &from, asn) != NULL;
+  }
+  return 0;
+}
+/* Call all ASN callbacks that are due, and set a timer for the next one */
+static void
+asn_callback_check(void *ptr)
+{
+  struct tsch_asn_callback *c;
+  int32_t earliest = 0;
+  int found = 0;
+
+  /* Callbacks may set new callbacks: restart from the list head after each call */
+  c = list_head(asn_callback_list);
+  while(c != NULL) {
+    int32_t diff = (int32_t)ASN_DIFF(c->asn, current_asn);
+    if(!associated || diff <= 0) {
+      list_remove(asn_callback_list, c);
+      c->f(c->ptr);
+      c = list_head(asn_callback_list);
+    } else {
+      c = list_item_next(c);
+    }
+  }
+
+  for(c = list_head(asn_callback_list); c != NULL; c = list_item_next(c)) {
+    int32_t diff = (int32_t)ASN_DIFF(c->asn, current_asn);
+    if(!found || diff < earliest) {
+      earliest = diff;
+      found = 1;
+    }
+  }
+  if(found) {
+    /* Wake up at the earliest callback. The ASN is checked again then,
+     * which compensates for the clock granularity. */
+    clock_time_t delay = TSCH_SLOTS_TO_CLOCK(earliest);
+    ctimer_set(&asn_callback_timer, delay > 0 ? delay : 1, asn_callback_check, NULL);
+  } else {
+    ctimer_stop(&asn_callback_timer);
+  }
+}
+/* Call f(ptr) once the current ASN has reached asn */
+int
+tsch_asn_callback_set(struct tsch_asn_callback *c, const struct asn_t *asn,
+                      void (*f)(void *), void *ptr)
+{
+  if(c == NULL || asn == NULL || f == NULL) {
+    return 0;
+  }
+  list_remove(asn_callback_list, c);
+  c->asn = *asn;
+  c->f = f;
+  c->ptr = ptr;
+  list_add(asn_callback_list, c);
+  asn_callback_check(NULL);
+  return 1;
+}
+/* Call f(ptr) lead_slots before the next Tx cell to a neighbor */
+int
+tsch_asn_callback_set_before_tx(struct tsch_asn_callback *c, const linkaddr_t *addr,
+                                uint16_t lead_slots, void (*f)(void *), void *ptr)
+{
+  struct asn_t asn;
+  if(tsch_get_next_tx_asn(addr, lead_slots + 1, &asn)) {
+    ASN_DEC(asn, lead_slots);
+    return tsch_asn_callback_set(c, &asn, f, ptr);
+  }
+  return 0;
+}
+/* Cancel a pending ASN callback */
+void
+tsch_asn_callback_stop(struct tsch_asn_callback *c)
+{
+  list_remove(asn_callback_list, c);
+  if(list_head(asn_callback_list) == NULL) {
+    ctimer_stop(&asn_callback_timer);
+  }
+}
 /* Brief dump of the TSCH state */
 void
 tsch_dump_status()
@@ -1618,7 +1778,7 @@ tsch_reset(void)
   tsch_queue_free_unused_neighbors();
   tsch_queue_update_time_source(NULL);
   /* Initialize global variables */
-  tsch_join_priority = 0xff;
+  tsch_set_join_priority(0xff);
   ASN_INIT(current_asn, 0, 0);
   current_link = NULL;
   current_packet = NULL;
@@ -1652,6 +1812,7 @@ tsch_init(void)
   tsch_log_init();
   ringbufindex_init(&input_ringbuf, TSCH_MAX_INCOMING_PACKETS);
   ringbufindex_init(&dequeued_ringbuf, DEQUEUED_ARRAY_SIZE);
+  list_init(asn_callback_list);
   ASN_DIVISOR_INIT(hopping_sequence_length, TSCH_N_CHANNELS);
   /* Process tx/rx callback and log messages whenever polled */
   process_start(&tsch_pending_events_process, NULL);
@@ -43,10 +43,36 @@
 
 #include "contiki.h"
 #include "net/mac/rdc.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch-private.h"
+
+/* A callback triggered by TSCH at a given ASN, from process context.
+ * Allocated by the caller, like a ctimer. */
+struct tsch_asn_callback {
+  struct tsch_asn_callback *next;
+  struct asn_t asn;
+  void (*f)(void *ptr);
+  void *ptr;
+};
 
 /* A global variable telling whether we are coordinator of the TSCH network */
 extern int tsch_is_coordinator;
 /* The TSCH radio driver */
 extern const struct rdc_driver tschrdc_driver;
 
+/* Get the ASN of the next Tx cell to a neighbor (linkaddr_null for broadcast),
+ * at least min_slots from now. Returns 1 if found, 0 if there is no such cell
+ * or if we are not associated. */
+int tsch_get_next_tx_asn(const linkaddr_t *addr, uint16_t min_slots, struct asn_t *asn);
+/* Call f(ptr) once the current ASN has reached asn. An ASN in the past
+ * triggers the callback at once. Returns 1 if success */
+int tsch_asn_callback_set(struct tsch_asn_callback *c, const struct asn_t *asn,
+                          void (*f)(void *), void *ptr);
+/* Call f(ptr) lead_slots before the next Tx cell to a neighbor, for just-in-time
+ * packet generation. Returns 1 if success, 0 if no Tx cell was found */
+int tsch_asn_callback_set_before_tx(struct tsch_asn_callback *c, const linkaddr_t *addr,
+                                    uint16_t lead_slots, void (*f)(void *), void *ptr);
+/* Cancel a pending ASN callback */
+void tsch_asn_callback_stop(struct tsch_asn_callback *c);
+
 #endif /* __TSCH_H__ */
@@ -60,8 +60,11 @@
 
 
 
+/* The ETX estimate, a fixed-point EWMA in COLLECT_LINK_ESTIMATE_UNIT
+   steps. It never exceeds the largest sample, 2 * 255 units, so 16
+   bits hold it. */
 struct collect_link_estimate {
-  uint32_t etx_accumulator;
+  uint16_t etx_accumulator;
   uint8_t num_estimates;
 };
 
@@ -157,6 +157,25 @@ MEMB(send_queue_memb, struct packetqueue_item, MAX_SENDING_QUEUE);
 #define SIGNIFICANT_RTMETRIC_PARENT_CHANGE (COLLECT_LINK_ESTIMATE_UNIT +  \
                                             COLLECT_LINK_ESTIMATE_UNIT / 2)
 
+/* Lazy parent selection: instead of looking for the best parent
+   whenever a link estimate or the rtmetric of a neighbor changes, only
+   do so when the change may matter. That is when the rtmetric through
+   our parent moved at least COLLECT_RTMETRIC_HYSTERESIS away from ours,
+   or when another neighbor got significantly better than our
+   rtmetric. Within the hysteresis, our rtmetric and the advertised one
+   are left as they are. */
+#ifdef COLLECT_CONF_LAZY_PARENT
+#define COLLECT_LAZY_PARENT COLLECT_CONF_LAZY_PARENT
+#else /* COLLECT_CONF_LAZY_PARENT */
+#define COLLECT_LAZY_PARENT 0
+#endif /* COLLECT_CONF_LAZY_PARENT */
+
+#ifdef COLLECT_CONF_RTMETRIC_HYSTERESIS
+#define COLLECT_RTMETRIC_HYSTERESIS COLLECT_CONF_RTMETRIC_HYSTERESIS
+#else /* COLLECT_CONF_RTMETRIC_HYSTERESIS */
+#define COLLECT_RTMETRIC_HYSTERESIS (COLLECT_LINK_ESTIMATE_UNIT / 2)
+#endif /* COLLECT_CONF_RTMETRIC_HYSTERESIS */
+
 /* This defines the maximum hops that a packet can take before it is
    dropped. */
 #ifdef COLLECT_CONF_MAX_HOPLIM
@@ -460,6 +479,38 @@ update_rtmetric(struct collect_conn *tc)
   }
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * This function is called when the link estimate or the rtmetric of
+ * neighbor n may have changed, n being NULL if it is not known. With
+ * lazy parent selection, the parent and our rtmetric are updated only
+ * if the change may affect them.
+ *
+ */
+static void
+neighbor_updated(struct collect_conn *tc, struct collect_neighbor *n)
+{
+#if COLLECT_LAZY_PARENT
+  uint16_t rtmetric;
+
+  if(n != NULL &&
+     tc->rtmetric != RTMETRIC_SINK && tc->rtmetric != RTMETRIC_MAX) {
+    rtmetric = collect_neighbor_rtmetric_link_estimate(n);
+    if(linkaddr_cmp(&n->addr, &tc->parent)) {
+      if(rtmetric < tc->rtmetric + COLLECT_RTMETRIC_HYSTERESIS &&
+         rtmetric + COLLECT_RTMETRIC_HYSTERESIS > tc->rtmetric) {
+        /* Our rtmetric would barely move. */
+        return;
+      }
+    } else if(rtmetric + SIGNIFICANT_RTMETRIC_PARENT_CHANGE >=
+              tc->rtmetric) {
+      /* Not a better parent. */
+      return;
+    }
+  }
+#endif /* COLLECT_LAZY_PARENT */
+  update_rtmetric(tc);
+}
+/*---------------------------------------------------------------------------*/
 static int
 enqueue_dummy_packet(struct collect_conn *c, int rexmits)
 {
@@ -696,7 +747,15 @@ retransmit_current_packet(struct collect_conn *c)
   q = packetqueue_queuebuf(i);
   if(q != NULL) {
 
+#if COLLECT_LAZY_PARENT
+    /* The parent is kept up to date as neighbors change, unless it has
+       been removed from the neighbor list. */
+    if(collect_neighbor_list_find(&c->neighbor_list, &c->parent) == NULL) {
+      update_rtmetric(c);
+    }
+#else /* COLLECT_LAZY_PARENT */
     update_rtmetric(c);
+#endif /* COLLECT_LAZY_PARENT */
     
     /* Place the queued packet into the packetbuf. */
     queuebuf_to_packetbuf(q);
@@ -815,7 +874,7 @@ handle_ack(struct collect_conn *tc)
     if(n != NULL) {
       collect_neighbor_tx(n, tc->transmissions);
       collect_neighbor_update_rtmetric(n, msg.rtmetric);
-      update_rtmetric(tc);
+      neighbor_updated(tc, n);
     }
 
     PRINTF("%d.%d: ACK from %d.%d after %d transmissions, flags %02x, rtmetric %d\n",
@@ -837,7 +896,7 @@ handle_ack(struct collect_conn *tc)
 	collect_neighbor_set_congested(n);
 	collect_neighbor_tx(n, tc->max_rexmits * 2);
       }
-      update_rtmetric(tc);
+      neighbor_updated(tc, n);
     }
     if((msg.flags & ACK_FLAGS_DROPPED) == 0) {
       /* If the packet was successfully received, we send the next packet. */
@@ -854,7 +913,7 @@ handle_ack(struct collect_conn *tc)
            penalize the parent and try sending the packet again. */
         PRINTF("ACK flag indicated packet was dropped by parent.\n");
         collect_neighbor_tx(n, tc->max_rexmits);
-        update_rtmetric(tc);
+        neighbor_updated(tc, n);
 
         ctimer_set(&tc->retransmission_timer,
                    REXMIT_TIME + (random_rand() % (REXMIT_TIME)),
@@ -940,7 +999,7 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
                                  packetbuf_addr(PACKETBUF_ADDR_SENDER));
   if(n != NULL) {
     collect_neighbor_update_rtmetric(n, hdr.rtmetric);
-    update_rtmetric(tc);
+    neighbor_updated(tc, n);
   }
 
   /* To protect against sending duplicate packets, we keep a list of
@@ -1117,7 +1176,7 @@ timedout(struct collect_conn *tc)
   if(n != NULL) {
     collect_neighbor_tx_fail(n, tc->max_rexmits);
   }
-  update_rtmetric(tc);
+  neighbor_updated(tc, n);
   send_next_packet(tc);
   set_keepalive_timer(tc);
 }
@@ -1226,7 +1285,7 @@ adv_received(struct neighbor_discovery_conn *c, const linkaddr_t *from,
 	   n->addr.u8[0], n->addr.u8[1], rtmetric);
   }
 
-  update_rtmetric(tc);
+  neighbor_updated(tc, n);
 }
 #else
 static void
@@ -1270,7 +1329,7 @@ received_announcement(struct announcement *a, const linkaddr_t *from,
 	   n->addr.u8[0], n->addr.u8[1], value);
   }
 
-  update_rtmetric(tc);
+  neighbor_updated(tc, n);
 
 #if ! COLLECT_CONF_WITH_LISTEN
   if(value == RTMETRIC_MAX &&
@@ -186,6 +186,84 @@
 #define RPL_DEFAULT_LIFETIME            RPL_CONF_DEFAULT_LIFETIME
 #endif
 
+/* DAG Mode of Operation */
+#define RPL_MOP_NO_DOWNWARD_ROUTES      0
+#define RPL_MOP_NON_STORING             1
+#define RPL_MOP_STORING_NO_MULTICAST    2
+#define RPL_MOP_STORING_MULTICAST       3
+
+/*
+ * Storing mode: every router keeps downward routes for its sub-DODAG.
+ * Non-storing mode: DAOs go to the root, which keeps a parent table
+ * and source-routes downward traffic (RFC 6554).
+ */
+#define RPL_WITH_STORING \
+  (RPL_CONF_MOP == RPL_MOP_STORING_NO_MULTICAST || RPL_CONF_MOP == RPL_MOP_STORING_MULTICAST)
+#define RPL_WITH_NON_STORING (RPL_CONF_MOP == RPL_MOP_NON_STORING)
+
+/*
+ * Longest downward path, in hops, a non-storing root source-routes.
+ * The size of its parent table is TOPOLOGY_CONF_MAX_NODES.
+ */
+#ifdef RPL_NS_CONF_MAX_PATH
+#define RPL_NS_MAX_PATH             RPL_NS_CONF_MAX_PATH
+#else
+#define RPL_NS_MAX_PATH             16
+#endif
+
+/*
+ * DAO aggregation, in storing mode. Routers batch the targets they
+ * forward, and their own, into one DAO per RPL_DAO_AGGREGATION_DELAY,
+ * with up to RPL_DAO_AGGREGATION_MAX_TARGETS targets. Refreshes of a
+ * route whose next hop did not change are only forwarded once a
+ * quarter of its lifetime, at most RPL_DAO_AGGREGATION_REFRESH_MAX
+ * seconds, has elapsed since it was last sent to the parent. On a
+ * parent switch, a router advertises its whole sub-DODAG to its new
+ * parent. All routers must agree on this setting.
+ */
+#ifdef RPL_CONF_DAO_AGGREGATION
+#define RPL_DAO_AGGREGATION         (RPL_CONF_DAO_AGGREGATION && RPL_WITH_STORING)
+#else
+#define RPL_DAO_AGGREGATION         0
+#endif
+
+#ifdef RPL_CONF_DAO_AGGREGATION_DELAY
+#define RPL_DAO_AGGREGATION_DELAY   RPL_CONF_DAO_AGGREGATION_DELAY
+#else
+#define RPL_DAO_AGGREGATION_DELAY   (2 * CLOCK_SECOND)
+#endif
+
+#ifdef RPL_CONF_DAO_AGGREGATION_MAX_TARGETS
+#define RPL_DAO_AGGREGATION_MAX_TARGETS RPL_CONF_DAO_AGGREGATION_MAX_TARGETS
+#else
+#define RPL_DAO_AGGREGATION_MAX_TARGETS 4
+#endif
+
+/* Longest refresh suppression, in seconds: two maximum DIO intervals,
+   so that a lost aggregated DAO is repaired within a few DIOs */
+#ifdef RPL_CONF_DAO_AGGREGATION_REFRESH_MAX
+#define RPL_DAO_AGGREGATION_REFRESH_MAX RPL_CONF_DAO_AGGREGATION_REFRESH_MAX
+#else
+#define RPL_DAO_AGGREGATION_REFRESH_MAX \
+  (2 * (1UL << (RPL_DIO_INTERVAL_MIN + RPL_DIO_INTERVAL_DOUBLINGS)) / 1000)
+#endif
+
+/*
+ * With RPL_CONF_PROBING, candidate parents are probed with a unicast
+ * DIO until RPL_CONF_PROBING_TX_THRESHOLD transmissions to them. With a
+ * non-zero RPL_PROBING_EXPIRATION (seconds), a neighbor is instead only
+ * probed once its link estimate is that old. An estimate is fresh when
+ * the link metric was last computed: from the outcome of a transmission
+ * or, with RPL_CONF_RSSI_BASED_ETX and as long as we never transmitted
+ * to the neighbor, from the RSSI of its first DIO or its EBs (with
+ * TSCH_CALLBACK_EB_RECEIVED).
+ */
+#ifdef RPL_CONF_PROBING_EXPIRATION
+#define RPL_PROBING_EXPIRATION      RPL_CONF_PROBING_EXPIRATION
+#else
+#define RPL_PROBING_EXPIRATION      0
+#endif
+
 /*
  * DAG preference field
  */
@@ -76,6 +76,10 @@ static rpl_of_t * const objective_functions[] = {&RPL_OF};
 void RPL_CALLBACK_PARENT_SWITCH(rpl_parent_t *old, rpl_parent_t *new);
 #endif
 
+#ifdef RPL_CALLBACK_REMOVE_PARENT
+void RPL_CALLBACK_REMOVE_PARENT(rpl_parent_t *p);
+#endif
+
 /*---------------------------------------------------------------------------*/
 /* Per-parent RPL information */
 NBR_TABLE_GLOBAL(rpl_parent_t, rpl_parents);
@@ -590,37 +594,39 @@ rpl_free_dag(rpl_dag_t *dag)
 /*---------------------------------------------------------------------------*/
 #if RPL_CONF_RSSI_BASED_ETX
 uint16_t
-rpl_init_link_metric(rpl_parent_t *p, rpl_dio_t *dio) {
-  if(dio == NULL) {
-    return RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
-  } else {
-    /* Our rough, pessimistic estimate of PRR from RSSI, based on measurements
-     * in the Indriya testbed, is a linear function where:
-     *      RSSI >= -60 results in PRR of 1
-     *      RSSI <= -90 results in PRR of 0
-     * PRR = (BoundedRSSI+MIN_RSSI)/(DIFF_RSSI)
-     * Here we need ETX.
-     * ETX = RPL_DAG_MC_ETX_DIVISOR / ((BoundedRSSI-MIN_RSSI)/DIFF_RSSI)
-     * ETX = DIFF_RSSI * RPL_DAG_MC_ETX_DIVISOR / (BoundedRSSI-MIN_RSSI)
-     * */
+rpl_link_metric_from_rssi(int16_t rssi) {
+  /* Our rough, pessimistic estimate of PRR from RSSI, based on measurements
+   * in the Indriya testbed, is a linear function where:
+   *      RSSI >= -60 results in PRR of 1
+   *      RSSI <= -90 results in PRR of 0
+   * PRR = (BoundedRSSI+MIN_RSSI)/(DIFF_RSSI)
+   * Here we need ETX.
+   * ETX = RPL_DAG_MC_ETX_DIVISOR / ((BoundedRSSI-MIN_RSSI)/DIFF_RSSI)
+   * ETX = DIFF_RSSI * RPL_DAG_MC_ETX_DIVISOR / (BoundedRSSI-MIN_RSSI)
+   * */
 #define MIN_RSSI -90
 #define MAX_RSSI -60
 #define DIFF_RSSI (MAX_RSSI-MIN_RSSI)
 #define MAX_INIT_ETX (3*RPL_DAG_MC_ETX_DIVISOR) /* Bound the resulting ETX to 3 */
-    int16_t boundedRssi = dio->rssi;
-    if(boundedRssi > MAX_RSSI) {
-      boundedRssi = MAX_RSSI;
-    } else if(boundedRssi < MIN_RSSI+1) {
-      boundedRssi = MIN_RSSI+1;
-    }
-    uint16_t etx = DIFF_RSSI * RPL_DAG_MC_ETX_DIVISOR / (boundedRssi-MIN_RSSI);
-    if(etx > MAX_INIT_ETX) {
-      etx = MAX_INIT_ETX;
-    }
-    //LOG("RPL: calc init ETX to %u, RSSI: %d -> %u\n",
-      //  LOG_NODEID_FROM_LINKADDR(nbr_table_get_lladdr(rpl_parents, p)),
-        //dio->rssi, etx);
-    return etx;
+  int16_t boundedRssi = rssi;
+  if(boundedRssi > MAX_RSSI) {
+    boundedRssi = MAX_RSSI;
+  } else if(boundedRssi < MIN_RSSI+1) {
+    boundedRssi = MIN_RSSI+1;
+  }
+  uint16_t etx = DIFF_RSSI * RPL_DAG_MC_ETX_DIVISOR / (boundedRssi-MIN_RSSI);
+  if(etx > MAX_INIT_ETX) {
+    etx = MAX_INIT_ETX;
+  }
+  return etx;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rpl_init_link_metric(rpl_parent_t *p, rpl_dio_t *dio) {
+  if(dio == NULL) {
+    return RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
+  } else {
+    return rpl_link_metric_from_rssi(dio->rssi);
   }
 }
 #endif /* RPL_CONF_RSSI_BASED_ETX */
@@ -652,8 +658,16 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
       p->tx_count = 0;
 #if RPL_CONF_RSSI_BASED_ETX
       p->link_metric = rpl_init_link_metric(p, dio);
+#if RPL_PROBING_EXPIRATION
+      /* The RSSI of the DIO is a first measurement */
+      p->last_update = clock_seconds();
+#endif /* RPL_PROBING_EXPIRATION */
 #else
       p->link_metric = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
+#if RPL_PROBING_EXPIRATION
+      /* No measurement yet: stale */
+      p->last_update = clock_seconds() - RPL_PROBING_EXPIRATION - 1;
+#endif /* RPL_PROBING_EXPIRATION */
 #endif
       p->rssi = dio->rssi;
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
@@ -768,7 +782,7 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
   } else if(!acceptable_rank(best_dag, best_dag->rank)) {
     PRINTF("RPL: New rank unacceptable!\n");
     rpl_set_preferred_parent(instance->current_dag, NULL);
-    if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES && last_parent != NULL) {
+    if(RPL_WITH_STORING && last_parent != NULL) {
       /* Send a No-Path DAO to the removed preferred parent. */
       dao_output(last_parent, RPL_ZERO_LIFETIME);
     }
@@ -781,10 +795,15 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
   	(unsigned)old_rank, best_dag->rank);
     RPL_STAT(rpl_stats.parent_switch++);
     if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES) {
-      if(last_parent != NULL) {
-        /* Send a No-Path DAO to the removed preferred parent. */
+      if(RPL_WITH_STORING && last_parent != NULL) {
+        /* Send a No-Path DAO to the removed preferred parent. In
+           non-storing mode, the root updates the parent from the
+           next DAO. */
         dao_output(last_parent, RPL_ZERO_LIFETIME);
       }
+#if RPL_DAO_AGGREGATION
+      rpl_dao_aggregate_routes(instance);
+#endif /* RPL_DAO_AGGREGATION */
       /* The DAO parent set changed - schedule a DAO transmission. */
       RPL_LOLLIPOP_INCREMENT(instance->dtsn_out);
       rpl_schedule_dao(instance);
@@ -830,6 +849,17 @@ best_parent(rpl_dag_t *dag)
 }
 /*---------------------------------------------------------------------------*/
 #if RPL_CONF_PROBING
+/* Is the link estimate of a neighbor worth a probe? */
+static int
+needs_probing(rpl_parent_t *p)
+{
+#if RPL_PROBING_EXPIRATION
+  return clock_seconds() - p->last_update > RPL_PROBING_EXPIRATION;
+#else /* RPL_PROBING_EXPIRATION */
+  return p->tx_count < RPL_CONF_PROBING_TX_THRESHOLD;
+#endif /* RPL_PROBING_EXPIRATION */
+}
+/*---------------------------------------------------------------------------*/
 static void
 handle_probing_timer(void *ptr)
 {
@@ -839,7 +869,7 @@ handle_probing_timer(void *ptr)
   rpl_parent_t *p, *second_best, *probing_target;
   rpl_rank_t second_best_rank;
 
-  if(best->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
+  if(needs_probing(best)) {
     probing_target = best;
   } else {
     /* Look for the second best parent. Must be done without the
@@ -867,7 +897,7 @@ handle_probing_timer(void *ptr)
     probing_target = second_best;
   }
 
-  if(probing_target != NULL && probing_target->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
+  if(probing_target != NULL && needs_probing(probing_target)) {
     LOG("RPL: probing %u (%u tx)\n",
         LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(probing_target)), probing_target->tx_count);
     dio_output(dag->instance, rpl_get_parent_ipaddr(probing_target));
@@ -884,8 +914,8 @@ rpl_select_parent(rpl_dag_t *dag)
 
 #if RPL_CONF_PROBING
       if(dag->preferred_parent != NULL
-          && dag->preferred_parent->tx_count >= RPL_CONF_PROBING_TX_THRESHOLD
-          && best->tx_count < RPL_CONF_PROBING_TX_THRESHOLD) {
+          && !needs_probing(dag->preferred_parent)
+          && needs_probing(best)) {
         /* There is a better candidate parent but it needs probing.
          * Do it shortly, and do not switch parent before that */
         ctimer_set(&dag->instance->probing_timer,
@@ -915,6 +945,9 @@ rpl_remove_parent(rpl_parent_t *parent)
 
   rpl_nullify_parent(parent);
 
+#ifdef RPL_CALLBACK_REMOVE_PARENT
+  RPL_CALLBACK_REMOVE_PARENT(parent);
+#endif
   nbr_table_remove(rpl_parents, parent);
 }
 /*---------------------------------------------------------------------------*/
@@ -1471,6 +1504,9 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
   /* We don't use route control, so we can have only one official parent. */
   if(dag->joined && p == dag->preferred_parent) {
     if(should_send_dao(instance, dio, p)) {
+#if RPL_DAO_AGGREGATION
+      rpl_dao_refresh_routes(instance);
+#endif /* RPL_DAO_AGGREGATION */
       RPL_LOLLIPOP_INCREMENT(instance->dtsn_out);
       rpl_schedule_dao(instance);
     }
@@ -48,6 +48,7 @@
 #include "net/ip/tcpip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/packetbuf.h"
 
 #define DEBUG DEBUG_NONE
@@ -64,6 +65,7 @@
 #define UIP_EXT_HDR_OPT_BUF       ((struct uip_ext_hdr_opt *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_PADN_BUF  ((struct uip_ext_hdr_opt_padn *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_RPL_BUF   ((struct uip_ext_hdr_opt_rpl *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
+#define UIP_RH_BUF                ((struct uip_routing_hdr *)&uip_buf[uip_l2_l3_hdr_len])
 /*---------------------------------------------------------------------------*/
 int
 rpl_verify_header(int uip_ext_opt_offset)
@@ -96,7 +98,7 @@ rpl_verify_header(int uip_ext_opt_offset)
     return 1;
   }
 
-  if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES && UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_FWD_ERR) {
+  if(RPL_WITH_STORING && UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_FWD_ERR) {
     PRINTF("RPL: Forward error!\n");
     /* We should try to repair it by removing the neighbor that caused
        the packet to be forwareded in the first place. We drop any
@@ -243,7 +245,7 @@ rpl_update_header_empty(void)
        which states that if a packet is going down it should in
        general not go back up again. If this happens, a
        RPL_HDR_OPT_FWD_ERR should be flagged. */
-    if(RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES && (UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
+    if(RPL_WITH_STORING && (UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
       if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
         UIP_EXT_HDR_OPT_RPL_BUF->flags |= RPL_HDR_OPT_FWD_ERR;
         PRINTF("RPL forwarding error\n");
@@ -379,6 +381,208 @@ rpl_invert_header(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+/* Returns the RPL source routing header of the packet in uip_buf, if any */
+static uint8_t *
+get_srh(void)
+{
+  uint8_t proto;
+  int offset;
+
+  proto = UIP_IP_BUF->proto;
+  offset = UIP_LLH_LEN + UIP_IPH_LEN;
+  while(proto == UIP_PROTO_HBHO || proto == UIP_PROTO_DESTO) {
+    if(offset + 2 > UIP_LLH_LEN + uip_len) {
+      return NULL;
+    }
+    proto = uip_buf[offset];
+    offset += (uip_buf[offset + 1] << 3) + 8;
+  }
+  if(proto == UIP_PROTO_ROUTING && offset + RPL_SRH_LEN <= UIP_LLH_LEN + uip_len
+     && ((struct uip_routing_hdr *)&uip_buf[offset])->routing_type == RPL_RH_TYPE_SRH) {
+    return &uip_buf[offset];
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns our DAG if we are its root */
+static rpl_dag_t *
+get_root_dag(void)
+{
+  if(default_instance == NULL || !default_instance->used
+     || default_instance->current_dag == NULL
+     || !default_instance->current_dag->joined
+     || default_instance->current_dag->rank != ROOT_RANK(default_instance)) {
+    return NULL;
+  }
+  return default_instance->current_dag;
+}
+/*---------------------------------------------------------------------------*/
+/* Inserts a source routing header along the path[] of path_len node
+   ids, from the first hop below the root down to the destination. The
+   first hop becomes the IPv6 destination. All addresses are in the DAG
+   prefix, so that the prefix they share is elided (CmprI = CmprE). */
+static int
+insert_srh(uint16_t *path, int path_len)
+{
+  uip_ipaddr_t dest;
+  uip_ipaddr_t hop;
+  uint8_t *srh;
+  int cmpr;
+  int addr_len;
+  int pad;
+  int ext_len;
+  int i, j;
+
+  /* Number of bytes all addresses share */
+  rpl_ns_get_node_global_addr(&dest, path[path_len - 1]);
+  cmpr = 15;
+  for(i = 0; i < path_len - 1; i++) {
+    rpl_ns_get_node_global_addr(&hop, path[i]);
+    for(j = 8; j < cmpr; j++) {
+      if(hop.u8[j] != dest.u8[j]) {
+        cmpr = j;
+      }
+    }
+  }
+
+  /* The RPL option is not used on the way down */
+  rpl_remove_header();
+
+  if(path_len <= 1) {
+    /* Direct child of the root, no routing header needed */
+    return 1;
+  }
+
+  addr_len = 16 - cmpr;
+  ext_len = RPL_SRH_LEN + (path_len - 1) * addr_len;
+  pad = (8 - (ext_len & 7)) & 7;
+  ext_len += pad;
+  if(uip_len + ext_len > UIP_LINK_MTU || uip_len + ext_len > UIP_BUFSIZE - UIP_LLH_LEN) {
+    PRINTF("RPL: Packet too long: impossible to add source routing header\n");
+    return 0;
+  }
+
+  srh = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN];
+  memmove(srh + ext_len, srh, uip_len - UIP_IPH_LEN);
+  memset(srh, 0, ext_len);
+  ((struct uip_routing_hdr *)srh)->next = UIP_IP_BUF->proto;
+  ((struct uip_routing_hdr *)srh)->len = (ext_len >> 3) - 1;
+  ((struct uip_routing_hdr *)srh)->routing_type = RPL_RH_TYPE_SRH;
+  ((struct uip_routing_hdr *)srh)->seg_left = path_len - 1;
+  srh[4] = (cmpr << 4) | cmpr;
+  srh[5] = pad << 4;
+
+  /* The first hop is the destination, the others follow in order */
+  rpl_ns_get_node_global_addr(&UIP_IP_BUF->destipaddr, path[0]);
+  for(i = 1; i < path_len; i++) {
+    rpl_ns_get_node_global_addr(&hop, path[i]);
+    memcpy(srh + RPL_SRH_LEN + (i - 1) * addr_len, hop.u8 + cmpr, addr_len);
+  }
+
+  UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+  uip_len += ext_len;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+
+  PRINTF("RPL: Inserted source routing header, %d hops, first hop ", path_len);
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF("\n");
+  return 1;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
+int
+rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr)
+{
+#if RPL_WITH_NON_STORING
+  rpl_dag_t *dag;
+  uint16_t path[RPL_NS_MAX_PATH];
+  int path_len;
+
+  if(get_srh() == NULL) {
+    /* Only the root inserts source routing headers */
+    dag = get_root_dag();
+    if(dag == NULL) {
+      return 0;
+    }
+    path_len = rpl_ns_get_path(dag, &UIP_IP_BUF->destipaddr, path, RPL_NS_MAX_PATH);
+    if(path_len == 0 || !insert_srh(path, path_len)) {
+      return 0;
+    }
+  }
+
+  /* The IPv6 destination is the next hop, a neighbor known by its
+     link-local address */
+  uip_ipaddr_copy(ipaddr, &UIP_IP_BUF->destipaddr);
+  uip_create_linklocal_prefix(ipaddr);
+  return 1;
+#else /* RPL_WITH_NON_STORING */
+  return 0;
+#endif /* RPL_WITH_NON_STORING */
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_process_srh_header(void)
+{
+#if RPL_WITH_NON_STORING
+  /* Processing as per RFC 6554, section 4.2 */
+  uint8_t *srh;
+  uint8_t *addr;
+  uip_ipaddr_t next_hop;
+  int cmpri, cmpre, cmpr;
+  int pad;
+  int ext_len;
+  int n;
+  int i;
+
+  srh = (uint8_t *)UIP_RH_BUF;
+  if(UIP_RH_BUF->routing_type != RPL_RH_TYPE_SRH || UIP_RH_BUF->seg_left == 0) {
+    return 0;
+  }
+
+  cmpri = srh[4] >> 4;
+  cmpre = srh[4] & 0x0f;
+  pad = srh[5] >> 4;
+  ext_len = (UIP_RH_BUF->len + 1) << 3;
+  if(uip_l3_hdr_len + ext_len > uip_len
+     || ext_len < RPL_SRH_LEN + pad + (16 - cmpre)) {
+    PRINTF("RPL: Bad source routing header length\n");
+    return 0;
+  }
+
+  /* Number of addresses */
+  n = ((ext_len - RPL_SRH_LEN - pad - (16 - cmpre)) / (16 - cmpri)) + 1;
+  if(UIP_RH_BUF->seg_left > n) {
+    return 0;
+  }
+
+  /* Next address, with the prefix elided from our own */
+  i = n - UIP_RH_BUF->seg_left;
+  cmpr = i == n - 1 ? cmpre : cmpri;
+  addr = srh + RPL_SRH_LEN + i * (16 - cmpri);
+  uip_ipaddr_copy(&next_hop, &UIP_IP_BUF->destipaddr);
+  memcpy(((uint8_t *)&next_hop) + cmpr, addr, 16 - cmpr);
+
+  if(uip_is_addr_mcast(&next_hop) || uip_ds6_is_my_addr(&next_hop)) {
+    PRINTF("RPL: Bad next hop in source routing header\n");
+    return 0;
+  }
+
+  /* Swap the next hop with our address, which keeps the same prefix */
+  memcpy(addr, ((uint8_t *)&UIP_IP_BUF->destipaddr) + cmpr, 16 - cmpr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &next_hop);
+  UIP_RH_BUF->seg_left--;
+
+  PRINTF("RPL: Source routing to ");
+  PRINT6ADDR(&next_hop);
+  PRINTF(", %u segments left\n", UIP_RH_BUF->seg_left);
+  return 1;
+#else /* RPL_WITH_NON_STORING */
+  return 0;
+#endif /* RPL_WITH_NON_STORING */
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_insert_header(void)
 {
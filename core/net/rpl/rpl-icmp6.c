@@ -51,6 +51,8 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+#include "net/ipv6/sicslowpan.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 
@@ -416,6 +418,22 @@ dio_input(void)
       PRINTF("RPL: Copying prefix information\n");
       memcpy(&dio.prefix_info.prefix, &buffer[i + 16], 16);
       break;
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+    case RPL_OPTION_6CO:
+      {
+        /* Contexts flow down the DODAG: only take them from above, in
+           the DODAG we joined. Until then, any neighbor could set our
+           contexts; we get them with the next DIO after joining. */
+        rpl_instance_t *instance = rpl_get_instance(dio.instance_id);
+        if(instance != NULL && instance->current_dag != NULL
+           && instance->current_dag->joined
+           && uip_ipaddr_cmp(&dio.dag_id, &instance->current_dag->dag_id)
+           && dio.rank < instance->current_dag->rank) {
+          sicslowpan_context_input(&buffer[i + 2], len - 2);
+        }
+      }
+      break;
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
     default:
       PRINTF("RPL: Unsupported suboption type in DIO: %u\n",
 	(unsigned)subopt_type);
@@ -443,6 +461,9 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #if !RPL_LEAF_ONLY
   uip_ipaddr_t addr;
 #endif /* !RPL_LEAF_ONLY */
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+  int i;
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
 
 #if RPL_LEAF_ONLY
   /* In leaf mode, we only send DIO messages as unicasts in response to
@@ -556,6 +577,18 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
            dag->prefix_info.length);
   }
 
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+  /* The compression contexts, for the nodes below */
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    int len = sicslowpan_context_output(i, &buffer[pos + 2]);
+    if(len > 0) {
+      buffer[pos] = RPL_OPTION_6CO;
+      buffer[pos + 1] = len;
+      pos += 2 + len;
+    }
+  }
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+
   LOG("RPL: DIO output to %d, rank %u\n", LOG_NODEID_FROM_IPADDR(uc_addr), (unsigned)instance->current_dag->rank);
 
 #if RPL_LEAF_ONLY
@@ -586,6 +619,373 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+/* Non-storing mode: DAOs travel up to the root, which records the
+   target -> parent link from the transit option. */
+static void
+dao_input_nonstoring(rpl_instance_t *instance, rpl_dag_t *dag,
+                     unsigned char *buffer, int buffer_length, int pos,
+                     uint8_t flags, uint8_t sequence, uip_ipaddr_t *dao_sender_addr)
+{
+  uip_ipaddr_t prefix;
+  uip_ipaddr_t parent_addr;
+  uint8_t lifetime;
+  uint8_t prefixlen;
+  uint8_t subopt_type;
+  int has_parent;
+  int len;
+  int i;
+
+  if(dag->rank != ROOT_RANK(instance)) {
+    PRINTF("RPL: Ignoring a non-storing DAO, we are not root\n");
+    return;
+  }
+
+  lifetime = RPL_DEFAULT_LIFETIME;
+  prefixlen = 0;
+  has_parent = 0;
+  memset(&prefix, 0, sizeof(prefix));
+
+  for(i = pos; i < buffer_length; i += len) {
+    subopt_type = buffer[i];
+    if(subopt_type == RPL_OPTION_PAD1) {
+      len = 1;
+    } else {
+      len = 2 + buffer[i + 1];
+    }
+
+    switch(subopt_type) {
+    case RPL_OPTION_TARGET:
+      prefixlen = buffer[i + 3];
+      memset(&prefix, 0, sizeof(prefix));
+      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      break;
+    case RPL_OPTION_TRANSIT:
+      lifetime = buffer[i + 5];
+      /* The parent address follows when the option is 20 bytes long */
+      if(len >= 6 + (int)sizeof(parent_addr)) {
+        memcpy(&parent_addr, buffer + i + 6, sizeof(parent_addr));
+        has_parent = 1;
+      }
+      break;
+    }
+  }
+
+  if(!has_parent || prefixlen != sizeof(prefix) * CHAR_BIT) {
+    PRINTF("RPL: Ignoring a non-storing DAO without parent or full target\n");
+    return;
+  }
+
+  LOG("RPL: DAO input from %d, target %d, parent %d, lifetime %u\n",
+      LOG_NODEID_FROM_IPADDR(dao_sender_addr), LOG_NODEID_FROM_IPADDR(&prefix),
+      LOG_NODEID_FROM_IPADDR(&parent_addr), lifetime);
+
+  if(lifetime == RPL_ZERO_LIFETIME) {
+    rpl_ns_expire_parent(dag, &prefix, &parent_addr);
+  } else if(!rpl_ns_update_node(dag, &prefix, &parent_addr,
+                                RPL_LIFETIME(instance, lifetime))) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a node after receiving a DAO\n");
+    return;
+  }
+
+  if(flags & RPL_DAO_K_FLAG) {
+    dao_ack_output(instance, dao_sender_addr, sequence);
+  }
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
+#if RPL_DAO_AGGREGATION
+/*---------------------------------------------------------------------------*/
+/* Targets waiting to be sent upwards in a single DAO */
+struct dao_target {
+  uip_ipaddr_t prefix;
+  uint8_t prefixlen;
+  uint8_t lifetime;
+};
+#if RPL_DAO_AGGREGATION_MAX_TARGETS > 32
+#error RPL_DAO_AGGREGATION_MAX_TARGETS must be at most 32
+#endif
+static struct dao_target dao_pending[RPL_DAO_AGGREGATION_MAX_TARGETS];
+static uint8_t dao_pending_num;
+static rpl_instance_t *dao_pending_instance;
+static struct ctimer dao_aggregation_timer;
+
+static int dao_output_header(rpl_dag_t *dag, unsigned char *buffer);
+static int dao_output_target_option(unsigned char *buffer, int pos,
+                                    uip_ipaddr_t *prefix, uint8_t prefixlen);
+/*---------------------------------------------------------------------------*/
+static uint32_t
+dao_timestamp(void)
+{
+  /* 0 means "not forwarded" */
+  uint32_t now = clock_seconds();
+  return now != 0 ? now : 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Records whether the pending targets reached the parent: refreshes are
+   only suppressed for routes it got */
+static void
+dao_pending_stamp(int sent)
+{
+  uip_ds6_route_t *r;
+  int i;
+
+  for(i = 0; i < dao_pending_num; i++) {
+    r = uip_ds6_route_lookup(&dao_pending[i].prefix);
+    if(r != NULL && r->length == dao_pending[i].prefixlen
+       && uip_ipaddr_cmp(&r->ipaddr, &dao_pending[i].prefix)) {
+      r->state.dao_forwarded = sent
+        && dao_pending[i].lifetime != RPL_ZERO_LIFETIME ? dao_timestamp() : 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the pending targets to the preferred parent, in one DAO with
+   one transit option per lifetime */
+static void
+dao_flush(void *ptr)
+{
+  rpl_instance_t *instance = dao_pending_instance;
+  rpl_parent_t *parent = NULL;
+  unsigned char *buffer;
+  uint32_t sent;
+  uint8_t lifetime;
+  int pos;
+  int i, j;
+
+  ctimer_stop(&dao_aggregation_timer);
+  if(dao_pending_num == 0) {
+    return;
+  }
+  if(instance != NULL && instance->current_dag != NULL) {
+    parent = instance->current_dag->preferred_parent;
+  }
+  if(parent == NULL || rpl_get_parent_ipaddr(parent) == NULL) {
+    PRINTF("RPL: No DAO parent, dropping %u aggregated targets\n",
+           dao_pending_num);
+    dao_pending_stamp(0);
+    dao_pending_num = 0;
+    return;
+  }
+
+  buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_output_header(instance->current_dag, buffer);
+  sent = 0;
+  for(i = 0; i < dao_pending_num; i++) {
+    if(sent & (1UL << i)) {
+      continue;
+    }
+    lifetime = dao_pending[i].lifetime;
+    for(j = i; j < dao_pending_num; j++) {
+      if(!(sent & (1UL << j)) && dao_pending[j].lifetime == lifetime) {
+        pos = dao_output_target_option(buffer, pos, &dao_pending[j].prefix,
+                                       dao_pending[j].prefixlen);
+        sent |= 1UL << j;
+      }
+    }
+    buffer[pos++] = RPL_OPTION_TRANSIT;
+    buffer[pos++] = 4;
+    buffer[pos++] = 0; /* flags - ignored */
+    buffer[pos++] = 0; /* path control - ignored */
+    buffer[pos++] = 0; /* path seq - ignored */
+    buffer[pos++] = lifetime;
+  }
+
+  LOG("RPL: DAO ouptut to %d, %u targets\n",
+      LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(parent)), dao_pending_num);
+  RPL_STAT(rpl_stats.dao_sent++);
+  uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+  dao_pending_stamp(1);
+  dao_pending_num = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Queues a target for the next aggregated DAO */
+static void
+dao_aggregate(rpl_instance_t *instance, uip_ipaddr_t *prefix,
+              uint8_t prefixlen, uint8_t lifetime)
+{
+  struct dao_target *t;
+
+  if(instance != dao_pending_instance) {
+    dao_flush(NULL);
+    dao_pending_instance = instance;
+  }
+  for(t = dao_pending; t < dao_pending + dao_pending_num; t++) {
+    if(t->prefixlen == prefixlen && uip_ipaddr_cmp(&t->prefix, prefix)) {
+      /* The latest lifetime wins, e.g. a No-Path after a refresh */
+      t->lifetime = lifetime;
+      return;
+    }
+  }
+  if(dao_pending_num == RPL_DAO_AGGREGATION_MAX_TARGETS) {
+    dao_flush(NULL);
+  }
+  t = &dao_pending[dao_pending_num++];
+  uip_ipaddr_copy(&t->prefix, prefix);
+  t->prefixlen = prefixlen;
+  t->lifetime = lifetime;
+  if(dao_pending_num == 1) {
+    ctimer_set(&dao_aggregation_timer, RPL_DAO_AGGREGATION_DELAY,
+               dao_flush, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_dao_aggregate_routes(rpl_instance_t *instance)
+{
+  uip_ds6_route_t *r;
+
+  /* The new parent knows none of our sub-DODAG: advertise it all,
+     rather than waiting for every node below to send a DAO */
+  rpl_dao_refresh_routes(instance);
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    if(r->state.dag == instance->current_dag
+       && r->state.learned_from == RPL_ROUTE_FROM_UNICAST_DAO
+       && !r->state.nopath_received) {
+      dao_aggregate(instance, &r->ipaddr, r->length, RPL_DEFAULT_LIFETIME);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_dao_refresh_routes(rpl_instance_t *instance)
+{
+  uip_ds6_route_t *r;
+
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    if(r->state.dag == instance->current_dag) {
+      r->state.dao_forwarded = 0;
+    }
+  }
+}
+#endif /* RPL_DAO_AGGREGATION */
+/*---------------------------------------------------------------------------*/
+/* Outcome of a DAO target */
+#define DAO_TARGET_IGNORED  0
+#define DAO_TARGET_ACCEPTED 1 /* To be acknowledged */
+#define DAO_TARGET_FORWARD  2 /* To be acknowledged and forwarded */
+
+/* Processes one target of a DAO received in storing mode */
+static int
+dao_input_target(rpl_instance_t *instance, rpl_dag_t *dag,
+                 rpl_parent_t *parent, uip_ipaddr_t *dao_sender_addr,
+                 int learned_from, uip_ipaddr_t *prefix, uint8_t prefixlen,
+                 uint8_t lifetime)
+{
+  uip_ds6_route_t *rep;
+  uip_ds6_nbr_t *nbr;
+#if RPL_DAO_AGGREGATION
+  unsigned long window;
+  int changed;
+#endif /* RPL_DAO_AGGREGATION */
+
+  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+          (unsigned)lifetime, (unsigned)prefixlen);
+  PRINT6ADDR(prefix);
+  PRINTF("\n");
+
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(prefix)) {
+    mcast_group = uip_mcast6_route_add(prefix);
+    if(mcast_group) {
+      mcast_group->dag = dag;
+      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+    }
+    return learned_from == RPL_ROUTE_FROM_UNICAST_DAO ?
+      DAO_TARGET_FORWARD : DAO_TARGET_IGNORED;
+  }
+#endif
+
+  rep = uip_ds6_route_lookup(prefix);
+
+  if(lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n");
+    LOG("RPL: DAO input from %d, target %d\n",
+        LOG_NODEID_FROM_IPADDR(dao_sender_addr), LOG_NODEID_FROM_IPADDR(prefix));
+    /* No-Path DAO received; invoke the route purging routine. */
+    if(rep != NULL &&
+       rep->state.nopath_received == 0 &&
+       rep->length == prefixlen &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), dao_sender_addr)) {
+      PRINTF("RPL: Setting expiration timer for prefix ");
+      PRINT6ADDR(prefix);
+      PRINTF("\n");
+      rep->state.nopath_received = 1;
+      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
+      /* We forward the incoming no-path DAO to our parent */
+      return DAO_TARGET_FORWARD;
+    }
+    return DAO_TARGET_IGNORED;
+  }
+
+  PRINTF("RPL: adding DAO route\n");
+
+  if((nbr = uip_ds6_nbr_lookup(dao_sender_addr)) == NULL) {
+    if((nbr = uip_ds6_nbr_add(dao_sender_addr,
+                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                              0, NBR_REACHABLE)) != NULL) {
+      /* set reachable timer */
+      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      PRINTF("RPL: Neighbor added to neighbor cache ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+    } else {
+      PRINTF("RPL: Out of Memory, dropping DAO from ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+      return DAO_TARGET_IGNORED;
+    }
+  } else {
+    PRINTF("RPL: Neighbor already in neighbor cache\n");
+  }
+
+  rpl_lock_parent(parent);
+
+#if RPL_DAO_AGGREGATION
+  changed = rep == NULL || rep->length != prefixlen
+    || rep->state.nopath_received
+    || uip_ds6_route_nexthop(rep) == NULL
+    || !uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), dao_sender_addr);
+#endif /* RPL_DAO_AGGREGATION */
+
+  rep = rpl_add_route(dag, prefix, prefixlen, dao_sender_addr);
+  if(rep == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+    return DAO_TARGET_IGNORED;
+  }
+
+  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
+  rep->state.learned_from = learned_from;
+
+  if(learned_from != RPL_ROUTE_FROM_UNICAST_DAO) {
+    return DAO_TARGET_IGNORED;
+  }
+#if RPL_DAO_AGGREGATION
+  if(changed) {
+    rep->state.dao_forwarded = 0;
+  }
+  /* Our parent still has this path for a while: no need to refresh it.
+     The route is stamped once the aggregated DAO is sent. */
+  window = RPL_LIFETIME(instance, lifetime) / 4;
+  if(window > RPL_DAO_AGGREGATION_REFRESH_MAX) {
+    window = RPL_DAO_AGGREGATION_REFRESH_MAX;
+  }
+  if(rep->state.dao_forwarded != 0
+     && clock_seconds() - rep->state.dao_forwarded < window) {
+    PRINTF("RPL: DAO refresh suppressed\n");
+    return DAO_TARGET_ACCEPTED;
+  }
+#endif /* RPL_DAO_AGGREGATION */
+  return DAO_TARGET_FORWARD;
+}
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
@@ -595,25 +995,33 @@ dao_input(void)
   unsigned char *buffer;
   uint16_t sequence;
   uint8_t instance_id;
-  uint8_t lifetime;
-  uint8_t prefixlen;
   uint8_t flags;
   uint8_t subopt_type;
   /*
   uint8_t pathcontrol;
   uint8_t pathsequence;
   */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
   uint8_t buffer_length;
   int pos;
   int len;
   int i;
   int learned_from;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
+  /* Targets, each with the lifetime of the transit option after it */
+#if RPL_DAO_AGGREGATION
+  struct dao_target targets[RPL_DAO_AGGREGATION_MAX_TARGETS];
+#else
+  struct {
+    uip_ipaddr_t prefix;
+    uint8_t prefixlen;
+    uint8_t lifetime;
+  } targets[1];
+#endif /* RPL_DAO_AGGREGATION */
+  int num_targets;
+  int first_transit;
+  int result;
+  int ret;
 
-  prefixlen = 0;
   parent = NULL;
 
   uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
@@ -636,8 +1044,6 @@ dao_input(void)
     return;
   }
 
-  lifetime = RPL_DEFAULT_LIFETIME;
-
   flags = buffer[pos++];
   /* reserved */
   pos++;
@@ -653,6 +1059,13 @@ dao_input(void)
     pos += 16;
   }
 
+#if RPL_WITH_NON_STORING
+  dao_input_nonstoring(instance, dag, buffer, buffer_length, pos,
+                       flags, sequence, &dao_sender_addr);
+  uip_len = 0;
+  return;
+#endif /* RPL_WITH_NON_STORING */
+
   learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
                  RPL_ROUTE_FROM_MULTICAST_DAO : RPL_ROUTE_FROM_UNICAST_DAO;
 
@@ -681,7 +1094,10 @@ dao_input(void)
     }
   }
 
-  /* Check if there are any RPL options present. */
+  /* Check if there are any RPL options present. A transit option
+     applies to the targets before it. */
+  num_targets = 0;
+  first_transit = 0;
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -693,129 +1109,63 @@ dao_input(void)
 
     switch(subopt_type) {
     case RPL_OPTION_TARGET:
-      /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      /* Handle the target option. Without room for it, it replaces
+         the last one. */
+      if(num_targets == sizeof(targets) / sizeof(targets[0])) {
+        num_targets--;
+        if(first_transit > num_targets) {
+          first_transit = num_targets;
+        }
+      }
+      targets[num_targets].prefixlen = buffer[i + 3];
+      targets[num_targets].lifetime = RPL_DEFAULT_LIFETIME;
+      memset(&targets[num_targets].prefix, 0, sizeof(uip_ipaddr_t));
+      memcpy(&targets[num_targets].prefix, buffer + i + 4,
+             (targets[num_targets].prefixlen + 7) / CHAR_BIT);
+      num_targets++;
       break;
     case RPL_OPTION_TRANSIT:
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
-      lifetime = buffer[i + 5];
+      for(; first_transit < num_targets; first_transit++) {
+        targets[first_transit].lifetime = buffer[i + 5];
+      }
       /* The parent address is also ignored. */
       break;
     }
   }
 
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
-
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+  result = DAO_TARGET_IGNORED;
+  for(i = 0; i < num_targets; i++) {
+    ret = dao_input_target(instance, dag, parent, &dao_sender_addr,
+                           learned_from, &targets[i].prefix,
+                           targets[i].prefixlen, targets[i].lifetime);
+#if RPL_DAO_AGGREGATION
+    if(ret == DAO_TARGET_FORWARD) {
+      dao_aggregate(instance, &targets[i].prefix, targets[i].prefixlen,
+                    targets[i].lifetime);
     }
-    goto fwd_dao;
-  }
-#endif
-
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
-
-      /* We forward the incoming no-path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        PRINTF("RPL: Forwarding no-path DAO to parent ");
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-      }
-      if(flags & RPL_DAO_K_FLAG) {
-        dao_ack_output(instance, &dao_sender_addr, sequence);
-      }
-    }
-
-    LOG("RPL: DAO input from %d, target %d\n",
-        LOG_NODEID_FROM_IPADDR(&dao_sender_addr), LOG_NODEID_FROM_IPADDR(&prefix));
-
-    return;
-  }
-
-  PRINTF("RPL: adding DAO route\n");
-
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
-    if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
-                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                              0, NBR_REACHABLE)) != NULL) {
-      /* set reachable timer */
-      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
-      PRINTF("RPL: Neighbor added to neighbor cache ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-    } else {
-      PRINTF("RPL: Out of Memory, dropping DAO from ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-      return;
+#endif /* RPL_DAO_AGGREGATION */
+    if(ret > result) {
+      result = ret;
     }
-  } else {
-    PRINTF("RPL: Neighbor already in neighbor cache\n");
   }
 
-  rpl_lock_parent(parent);
-
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
-    return;
+#if !RPL_DAO_AGGREGATION
+  if(result == DAO_TARGET_FORWARD &&
+     dag->preferred_parent != NULL &&
+     rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
+    PRINTF("RPL: Forwarding DAO to parent ");
+    PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    PRINTF("\n");
+    RPL_STAT(rpl_stats.dao_sent++);
+    uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
+                   ICMP6_RPL, RPL_CODE_DAO, buffer_length);
   }
-
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
-
-#if RPL_CONF_MULTICAST
-fwd_dao:
-#endif
-
-  int dao_fw = 0;
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      dao_fw = 1;
-      PRINTF("RPL: Forwarding DAO to parent ");
-      PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-      PRINTF("\n");
-      uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                     ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-    }
-    if(flags & RPL_DAO_K_FLAG) {
-      dao_ack_output(instance, &dao_sender_addr, sequence);
-    }
+#endif /* !RPL_DAO_AGGREGATION */
+  if(result != DAO_TARGET_IGNORED && (flags & RPL_DAO_K_FLAG)) {
+    dao_ack_output(instance, &dao_sender_addr, sequence);
   }
   uip_len = 0;
 }
@@ -832,10 +1182,63 @@ dao_output(rpl_parent_t *parent, uint8_t lifetime)
     return;
   }
 
+#if RPL_DAO_AGGREGATION
+  if(dao_pending_num > 0 && parent != NULL
+     && parent->dag != NULL && parent == parent->dag->preferred_parent
+     && lifetime != RPL_ZERO_LIFETIME && rpl_get_mode() != RPL_MODE_FEATHER) {
+    /* Our own target joins the pending ones */
+    dao_aggregate(parent->dag->instance, &prefix,
+                  sizeof(prefix) * CHAR_BIT, lifetime);
+    dao_flush(NULL);
+    return;
+  }
+#endif /* RPL_DAO_AGGREGATION */
+
   /* Sending a DAO with own prefix as target */
   dao_output_target(parent, &prefix, lifetime);
 }
 /*---------------------------------------------------------------------------*/
+/* Writes the DAO base object, returns its length */
+static int
+dao_output_header(rpl_dag_t *dag, unsigned char *buffer)
+{
+  int pos;
+
+  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  pos = 0;
+
+  buffer[pos++] = dag->instance->instance_id;
+  buffer[pos] = 0;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_CONF_DAO_ACK
+  buffer[pos] |= RPL_DAO_K_FLAG;
+#endif /* RPL_CONF_DAO_ACK */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_sequence;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+  pos+=sizeof(dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+/* Writes a target option at pos, returns the position after it */
+static int
+dao_output_target_option(unsigned char *buffer, int pos,
+                         uip_ipaddr_t *prefix, uint8_t prefixlen)
+{
+  buffer[pos++] = RPL_OPTION_TARGET;
+  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = prefixlen;
+  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
+  pos += ((prefixlen + 7) / CHAR_BIT);
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
 void
 dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 {
@@ -879,42 +1282,49 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 
   buffer = UIP_ICMP_PAYLOAD;
 
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
-
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
-#if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
-#endif /* RPL_DAO_SPECIFY_DAG */
-#if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
-#endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
-#if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
-#endif /* RPL_DAO_SPECIFY_DAG */
+  pos = dao_output_header(dag, buffer);
 
   /* create target subopt */
   prefixlen = sizeof(*prefix) * CHAR_BIT;
-  buffer[pos++] = RPL_OPTION_TARGET;
-  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = prefixlen;
-  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
-  pos += ((prefixlen + 7) / CHAR_BIT);
+  pos = dao_output_target_option(buffer, pos, prefix, prefixlen);
 
   /* Create a transit information sub-option. */
   buffer[pos++] = RPL_OPTION_TRANSIT;
+#if RPL_WITH_NON_STORING
+  /* Non-storing: the root learns our parent from its global address */
+  if(rpl_get_parent_ipaddr(parent) == NULL) {
+    PRINTF("RPL dao_output_target error parent address NULL\n");
+    return;
+  }
+  buffer[pos++] = 20;
+#else
   buffer[pos++] = 4;
+#endif /* RPL_WITH_NON_STORING */
   buffer[pos++] = 0; /* flags - ignored */
   buffer[pos++] = 0; /* path control - ignored */
   buffer[pos++] = 0; /* path seq - ignored */
   buffer[pos++] = lifetime;
+#if RPL_WITH_NON_STORING
+  memcpy(buffer + pos, &dag->dag_id, 8); /* prefix */
+  memcpy(buffer + pos + 8, ((unsigned char *)rpl_get_parent_ipaddr(parent)) + 8, 8);
+  pos += 16;
+#endif /* RPL_WITH_NON_STORING */
+
+#if RPL_WITH_NON_STORING
+  /* DAOs go to the root, the DAG ID being its global address */
+  PRINTF("RPL: Sending DAO with prefix ");
+  PRINT6ADDR(prefix);
+  PRINTF(" to root ");
+  PRINT6ADDR(&dag->dag_id);
+  PRINTF("\n");
+
+  LOG("RPL: DAO ouptut to root %d, target %d, parent %d\n",
+      LOG_NODEID_FROM_IPADDR(&dag->dag_id), LOG_NODEID_FROM_IPADDR(prefix),
+      LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(parent)));
 
+  RPL_STAT(rpl_stats.dao_sent++);
+  uip_icmp6_send(&dag->dag_id, ICMP6_RPL, RPL_CODE_DAO, pos);
+#else /* RPL_WITH_NON_STORING */
   PRINTF("RPL: Sending DAO with prefix ");
   PRINT6ADDR(prefix);
   PRINTF(" to ");
@@ -925,8 +1335,10 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   		LOG_NODEID_FROM_IPADDR(rpl_get_parent_ipaddr(parent)), LOG_NODEID_FROM_IPADDR(prefix));
 
   if(rpl_get_parent_ipaddr(parent) != NULL) {
+    RPL_STAT(rpl_stats.dao_sent++);
     uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
   }
+#endif /* RPL_WITH_NON_STORING */
 }
 /*---------------------------------------------------------------------------*/
 static void
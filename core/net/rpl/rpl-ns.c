@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         RPL non-storing mode: the parent table kept at the root.
+ *         The root learns one child -> parent link per DAO and
+ *         rebuilds downward paths from it when inserting source
+ *         routing headers (see rpl-ext-header.c).
+ */
+
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#include <string.h>
+
+#if RPL_WITH_NON_STORING
+
+/* The DAG the table refers to: all nodes share its prefix */
+static rpl_dag_t *ns_dag;
+/* Interface identifier, i.e. the last 8 bytes of the address, per node */
+static uint8_t link_identifier[TOPOLOGY_MAX_NODES][8];
+/* The node ids double as an open-addressing hash table on the
+   identifier: a node takes the first free id from its home id on. No
+   node sits further than this from its home, so that lookups stop
+   there even after nodes in between were removed. */
+static uint16_t max_probe;
+/*---------------------------------------------------------------------------*/
+/* The id a node is looked for first */
+static uint16_t
+home_id(const uip_ipaddr_t *addr)
+{
+  uint16_t h;
+#ifdef RPL_NS_CONF_NODE_ID_FROM_IPADDR
+  h = RPL_NS_CONF_NODE_ID_FROM_IPADDR(addr);
+  if(h > 0 && h < TOPOLOGY_MAX_NODES) {
+    return h;
+  }
+#else /* RPL_NS_CONF_NODE_ID_FROM_IPADDR */
+  /* The sum of the 16-bit words of the identifier, in network byte
+     order: identifiers that differ in their last byte only, e.g.
+     numbered nodes, get consecutive ids */
+  h = ((addr->u8[8] + addr->u8[10] + addr->u8[12] + addr->u8[14]) << 8)
+    + addr->u8[9] + addr->u8[11] + addr->u8[13] + addr->u8[15];
+#endif /* RPL_NS_CONF_NODE_ID_FROM_IPADDR */
+  return 1 + h % (TOPOLOGY_MAX_NODES - 1);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+next_id(uint16_t id)
+{
+  return id == TOPOLOGY_MAX_NODES - 1 ? 1 : id + 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+has_dag_prefix(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return addr != NULL && dag != NULL && dag == ns_dag
+    && !memcmp(addr, &dag->dag_id, 8);
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rpl_ns_get_node_id(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  uint16_t id;
+  uint16_t i;
+  if(!has_dag_prefix(dag, addr)) {
+    return TOPOLOGY_NONE;
+  }
+  id = home_id(addr);
+  for(i = 0; i <= max_probe; i++) {
+    if(topology_has_node(id)
+       && !memcmp(((const uint8_t *)addr) + 8, link_identifier[id], 8)) {
+      return id;
+    }
+    id = next_id(id);
+  }
+  return TOPOLOGY_NONE;
+}
+/*---------------------------------------------------------------------------*/
+/* Adds a node, or refreshes its lifetime. Returns its id. */
+static uint16_t
+add_node(const uip_ipaddr_t *addr, uint32_t lifetime)
+{
+  uint16_t id;
+  uint16_t i;
+
+  id = rpl_ns_get_node_id(ns_dag, addr);
+  if(id == TOPOLOGY_NONE) {
+    /* The first free id from home, usually home itself */
+    id = home_id(addr);
+    for(i = 0; i < TOPOLOGY_MAX_NODES - 1 && topology_has_node(id); i++) {
+      id = next_id(id);
+    }
+    if(i == TOPOLOGY_MAX_NODES - 1 || !topology_add_node(id, lifetime)) {
+      PRINTF("RPL: non-storing parent table full\n");
+      return TOPOLOGY_NONE;
+    }
+    memcpy(link_identifier[id], ((const uint8_t *)addr) + 8, 8);
+    if(i > max_probe) {
+      max_probe = i;
+    }
+  } else {
+    topology_add_node(id, lifetime);
+  }
+  return id;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_num_nodes(void)
+{
+  return topology_num_nodes();
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_get_path(const rpl_dag_t *dag, const uip_ipaddr_t *addr,
+                uint16_t *path, int max)
+{
+  return topology_get_path(rpl_ns_get_node_id(dag, &dag->dag_id),
+                           rpl_ns_get_node_id(dag, addr), path, max);
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return rpl_ns_get_path(dag, addr, NULL, RPL_NS_MAX_PATH) > 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                   const uip_ipaddr_t *parent, uint32_t lifetime)
+{
+  uint16_t child_id;
+  uint16_t parent_id;
+
+  if(dag != ns_dag) {
+    /* New DAG: start over */
+    topology_init();
+    max_probe = 0;
+    ns_dag = dag;
+  }
+  if(!has_dag_prefix(dag, child) || !has_dag_prefix(dag, parent)) {
+    return 0;
+  }
+
+  parent_id = rpl_ns_get_node_id(dag, parent);
+  if(parent_id == TOPOLOGY_NONE) {
+    /* Parent not announced yet: keep it as long as the child. The
+       root never sends DAOs, it is kept forever. */
+    parent_id = add_node(parent, uip_ipaddr_cmp(parent, &dag->dag_id) ?
+                         TOPOLOGY_INFINITE_LIFETIME : lifetime);
+    if(parent_id == TOPOLOGY_NONE) {
+      return 0;
+    }
+  }
+  child_id = add_node(child, lifetime);
+  if(child_id == TOPOLOGY_NONE) {
+    return 0;
+  }
+
+  /* A parent that would create a loop, e.g. from a stale DAO, is not
+     taken: the next DAO will settle it */
+  if(!topology_set_parent(child_id, parent_id)) {
+    PRINTF("RPL: non-storing parent update would create a loop\n");
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                     const uip_ipaddr_t *parent)
+{
+  uint16_t child_id;
+  child_id = rpl_ns_get_node_id(dag, child);
+  if(child_id != TOPOLOGY_NONE
+     && topology_get_parent(child_id) == rpl_ns_get_node_id(dag, parent)) {
+    topology_remove_node(child_id);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, uint16_t id)
+{
+  if(addr != NULL && ns_dag != NULL && topology_has_node(id)) {
+    memcpy(addr, &ns_dag->dag_id, 8);
+    memcpy(((uint8_t *)addr) + 8, link_identifier[id], 8);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_periodic(void)
+{
+  topology_age(1, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_init(void)
+{
+  ns_dag = NULL;
+  topology_init();
+  max_probe = 0;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* RPL_WITH_NON_STORING */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         RPL non-storing mode: the parent table kept at the root, on
+ *         top of the flat topology store (lib/topology.h). Nodes are
+ *         indexed by node id. A node gets the id its interface
+ *         identifier hashes to, or RPL_NS_CONF_NODE_ID_FROM_IPADDR(addr)
+ *         if defined, or the next free one on collisions: looking up
+ *         an address costs one comparison in the common case.
+ */
+
+#ifndef RPL_NS_H
+#define RPL_NS_H
+
+#include "net/rpl/rpl.h"
+#include "lib/topology.h"
+
+void rpl_ns_init(void);
+/* Number of nodes in the table */
+int rpl_ns_num_nodes(void);
+/* Called every second: ages the nodes and removes the expired ones */
+void rpl_ns_periodic(void);
+/* Adds or updates the child -> parent link announced in a DAO */
+int rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                       const uip_ipaddr_t *parent, uint32_t lifetime);
+/* No-Path DAO: drops the child if parent is its current parent */
+void rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                          const uip_ipaddr_t *parent);
+/* Node id of an address in the table, or TOPOLOGY_NONE */
+uint16_t rpl_ns_get_node_id(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+/* Is there a path from the root down to addr? */
+int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+/* Fills path[] with the node ids from the first hop below the root
+   down to addr. Returns the number of hops, 0 if unreachable. */
+int rpl_ns_get_path(const rpl_dag_t *dag, const uip_ipaddr_t *addr,
+                    uint16_t *path, int max);
+void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, uint16_t id);
+
+#endif /* RPL_NS_H */
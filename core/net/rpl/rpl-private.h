@@ -87,6 +87,13 @@
 #define RPL_OPTION_SOLICITED_INFO        7
 #define RPL_OPTION_PREFIX_INFO           8
 #define RPL_OPTION_TARGET_DESC           9
+/* 6LoWPAN Context Option (RFC 6775) carried in DIOs, to disseminate
+   the compression contexts. Not an RFC 6550 option: the type is ours. */
+#ifdef RPL_CONF_OPTION_6CO
+#define RPL_OPTION_6CO                   RPL_CONF_OPTION_6CO
+#else
+#define RPL_OPTION_6CO                   0x22
+#endif
 
 #define RPL_DAO_K_FLAG                   0x80 /* DAO ACK requested */
 #define RPL_DAO_D_FLAG                   0x40 /* DODAG ID present */
@@ -98,6 +105,11 @@
 #define RPL_HDR_OPT_DOWN_SHIFT  	7
 #define RPL_HDR_OPT_RANK_ERR		0x40
 #define RPL_HDR_OPT_RANK_ERR_SHIFT   	6
+
+/* RPL Source Routing Header (RFC 6554): the routing header, one byte
+   with CmprI and CmprE, one with Pad, two reserved, then the addresses. */
+#define RPL_RH_TYPE_SRH                 3
+#define RPL_SRH_LEN                     8
 #define RPL_HDR_OPT_FWD_ERR		0x20
 #define RPL_HDR_OPT_FWD_ERR_SHIFT   	5
 /*---------------------------------------------------------------------------*/
@@ -151,12 +163,7 @@
 #define RPL_ROUTE_FROM_MULTICAST_DAO    2
 #define RPL_ROUTE_FROM_DIO              3
 
-/* DAG Mode of Operation */
-#define RPL_MOP_NO_DOWNWARD_ROUTES      0
-#define RPL_MOP_NON_STORING             1
-#define RPL_MOP_STORING_NO_MULTICAST    2
-#define RPL_MOP_STORING_MULTICAST       3
-
+/* DAG Mode of Operation: see rpl-conf.h */
 #ifdef  RPL_CONF_MOP
 #define RPL_MOP_DEFAULT                 RPL_CONF_MOP
 #else /* RPL_CONF_MOP */
@@ -251,6 +258,8 @@ struct rpl_stats {
   uint16_t malformed_msgs;
   uint16_t resets;
   uint16_t parent_switch;
+  uint16_t forward_errors;
+  uint16_t dao_sent;
 };
 typedef struct rpl_stats rpl_stats_t;
 
@@ -323,6 +332,9 @@ void rpl_lock_parent(rpl_parent_t *p);
 
 /* Objective function. */
 rpl_of_t *rpl_find_of(rpl_ocp_t);
+#if RPL_CONF_RSSI_BASED_ETX
+uint16_t rpl_link_metric_from_rssi(int16_t rssi);
+#endif /* RPL_CONF_RSSI_BASED_ETX */
 
 /* Timer functions. */
 #if RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES
@@ -334,6 +346,12 @@ void rpl_cancel_dao(rpl_instance_t *instance);
 #define rpl_schedule_dao_immediately(i)
 #define rpl_cancel_dao(i)
 #endif /* RPL_CONF_MOP != RPL_MOP_NO_DOWNWARD_ROUTES */
+#if RPL_DAO_AGGREGATION
+/* Advertises the whole sub-DODAG to a new preferred parent */
+void rpl_dao_aggregate_routes(rpl_instance_t *instance);
+/* Lets the next refresh of every route through, e.g. on a DTSN increment */
+void rpl_dao_refresh_routes(rpl_instance_t *instance);
+#endif /* RPL_DAO_AGGREGATION */
 
 void rpl_reset_dio_timer(rpl_instance_t *, int src);
 void rpl_reset_periodic_timer(void);
@@ -43,6 +43,8 @@
 
 #include "contiki-conf.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+#include "net/ipv6/sicslowpan.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "lib/random.h"
 #include "sys/ctimer.h"
@@ -76,8 +78,24 @@ static void
 handle_periodic_timer(void *ptr)
 {
   rpl_purge_routes();
+#if RPL_WITH_NON_STORING
+  rpl_ns_periodic();
+#endif /* RPL_WITH_NON_STORING */
   rpl_recalculate_ranks();
 
+#if SICSLOWPAN_DYNAMIC_CONTEXTS
+#if SICSLOWPAN_CONTEXT_ALLOC
+  /* The root allocates the contexts */
+  sicslowpan_context_alloc_enable(default_instance != NULL
+      && default_instance->current_dag != NULL
+      && default_instance->current_dag->rank == ROOT_RANK(default_instance));
+#endif /* SICSLOWPAN_CONTEXT_ALLOC */
+  /* Spread context changes quickly */
+  if(sicslowpan_context_updated() && default_instance != NULL) {
+    rpl_reset_dio_timer(default_instance, 18);
+  }
+#endif /* SICSLOWPAN_DYNAMIC_CONTEXTS */
+
   /* handle DIS */
 #if RPL_DIS_SEND
   next_dis++;
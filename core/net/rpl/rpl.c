@@ -47,6 +47,7 @@
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 
 #define DEBUG DEBUG_NONE
@@ -264,6 +265,11 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
         if(instance->of->neighbor_link_callback != NULL) {
           instance->of->neighbor_link_callback(parent, status, numtx);
           parent->tx_count += numtx;
+#if RPL_PROBING_EXPIRATION
+          if(status == MAC_TX_OK || status == MAC_TX_NOACK) {
+            parent->last_update = clock_seconds();
+          }
+#endif /* RPL_PROBING_EXPIRATION */
 #if RPL_CONF_PROBING_LOCK_ALL
           if(parent->tx_count >= RPL_CONF_PROBING_TX_THRESHOLD) {
             nbr_table_lock(rpl_parents, parent);
@@ -275,6 +281,33 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Link measurement from a frame that carried no RPL message, e.g. a
+   TSCH EB: refreshes the RSSI of a candidate parent and, as long as we
+   never transmitted to it, its RSSI-based link metric. Only the latter
+   makes its estimate fresh. */
+void
+rpl_link_rssi_callback(const linkaddr_t *addr, int16_t rssi)
+{
+  rpl_parent_t *parent = rpl_get_parent((uip_lladdr_t *)addr);
+
+  if(parent == NULL) {
+    return;
+  }
+  parent->rssi = rssi;
+#if RPL_CONF_RSSI_BASED_ETX
+  if(parent->tx_count == 0) {
+    uint16_t link_metric = rpl_link_metric_from_rssi(rssi);
+#if RPL_PROBING_EXPIRATION
+    parent->last_update = clock_seconds();
+#endif /* RPL_PROBING_EXPIRATION */
+    if(link_metric != parent->link_metric) {
+      parent->link_metric = link_metric;
+      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+    }
+  }
+#endif /* RPL_CONF_RSSI_BASED_ETX */
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_ipv6_neighbor_callback(uip_ds6_nbr_t *nbr)
 {
@@ -306,6 +339,9 @@ rpl_init(void)
   default_instance = NULL;
 
   rpl_dag_init();
+#if RPL_WITH_NON_STORING
+  rpl_ns_init();
+#endif /* RPL_WITH_NON_STORING */
   rpl_reset_periodic_timer();
   rpl_icmp6_register_handlers();
 
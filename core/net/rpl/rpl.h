@@ -118,6 +118,9 @@ struct rpl_parent {
   uint16_t link_metric;
   int16_t rssi;
   uint16_t tx_count;
+#if RPL_PROBING_EXPIRATION
+  uint32_t last_update; /* clock_seconds() of the last link measurement */
+#endif /* RPL_PROBING_EXPIRATION */
   uint8_t dtsn;
   uint8_t flags;
 };
@@ -254,10 +257,13 @@ int rpl_verify_header(int);
 void rpl_insert_header(void);
 void rpl_remove_header(void);
 uint8_t rpl_invert_header(void);
+int rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr);
+int rpl_process_srh_header(void);
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_parent_t *rpl_get_parent(uip_lladdr_t *addr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
 uint16_t rpl_get_parent_link_metric(const uip_lladdr_t *addr);
+void rpl_link_rssi_callback(const linkaddr_t *addr, int16_t rssi);
 void rpl_dag_init(void);
 
 
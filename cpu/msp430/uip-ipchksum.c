@@ -74,3 +74,45 @@ uip_ipchksum(void)
 #endif
 #endif
 /*---------------------------------------------------------------------------*/
+#if UIP_ARCH_CHKSUM_WORDS
+uint32_t
+uip_arch_chksum_words(const uint16_t *words, uint16_t n)
+{
+#ifdef __IAR_SYSTEMS_ICC__
+  uint32_t acc = 0;
+
+  while(n > 0) {
+    acc += *words++;
+    n--;
+  }
+  return acc;
+#else
+  /* Auto-increment loads, the carries counted in the upper word */
+  register uint16_t lo = 0;
+  register uint16_t hi = 0;
+
+  while(n >= 4) {
+    __asm__ __volatile__("add  @%[p]+, %[lo]\n\t"
+                         "addc #0, %[hi]\n\t"
+                         "add  @%[p]+, %[lo]\n\t"
+                         "addc #0, %[hi]\n\t"
+                         "add  @%[p]+, %[lo]\n\t"
+                         "addc #0, %[hi]\n\t"
+                         "add  @%[p]+, %[lo]\n\t"
+                         "addc #0, %[hi]"
+                         : [lo] "+r" (lo), [hi] "+r" (hi), [p] "+r" (words)
+                         : : "memory");
+    n -= 4;
+  }
+  while(n > 0) {
+    __asm__ __volatile__("add  @%[p]+, %[lo]\n\t"
+                         "addc #0, %[hi]"
+                         : [lo] "+r" (lo), [hi] "+r" (hi), [p] "+r" (words)
+                         : : "memory");
+    n--;
+  }
+  return ((uint32_t)hi << 16) | lo;
+#endif
+}
+#endif /* UIP_ARCH_CHKSUM_WORDS */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * \file
+ *         Node of the IPv6 multicast throughput benchmark. Node 1 is the
+ *         RPL root and the seed: it sends to a group every other node has
+ *         joined, at the interval set by the simulation. Every node logs
+ *         the events the simulation script computes the metrics from:
+ *           MCB send <seq>          datagram sent to the group (root)
+ *           MCB recv <seq>          datagram delivered to the group member
+ *           MCB fwd <n> <icmp>      datagrams forwarded, ROLL-TM ICMPv6
+ *                                   messages sent so far
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "sys/etimer.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/rpl/rpl.h"
+
+#include "simple-udp.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MCAST_PORT 3001
+
+#define ROOT_ID 1
+/* Let the DODAG form before sending */
+#define SEND_START      (60 * CLOCK_SECOND)
+#ifndef MCB_INTERVAL
+#define MCB_INTERVAL    1000 /* ms */
+#endif
+#define SEND_INTERVAL   (MCB_INTERVAL * CLOCK_SECOND / 1000)
+#define STATS_INTERVAL  (60 * CLOCK_SECOND)
+/* Payload size, the sequence number and padding */
+#define MCB_PAYLOAD     32
+
+static struct simple_udp_connection connection;
+static uint8_t node_id;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(mcast_bench_process, "Multicast benchmark");
+AUTOSTART_PROCESSES(&mcast_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  uint16_t seq;
+  if(datalen == MCB_PAYLOAD) {
+    memcpy(&seq, data, sizeof(seq));
+    printf("MCB recv %u\n", seq);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_group_address(uip_ipaddr_t *ipaddr)
+{
+  /* FF1E::89:ABCD, as in examples/ipv6/multicast */
+  uip_ip6addr(ipaddr, 0xFF1E, 0, 0, 0, 0, 0, 0x89, 0xABCD);
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_global_address(uip_ipaddr_t *ipaddr)
+{
+  uip_ip6addr(ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(ipaddr, 0, ADDR_AUTOCONF);
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_rpl_dag(uip_ipaddr_t *ipaddr)
+{
+  rpl_dag_t *dag;
+  uip_ipaddr_t prefix;
+
+  rpl_set_root(RPL_DEFAULT_INSTANCE, ipaddr);
+  dag = rpl_get_any_dag();
+  uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  rpl_set_prefix(dag, &prefix, 64);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_stats(void)
+{
+#if UIP_MCAST6_CONF_ENGINE == UIP_MCAST6_ENGINE_ROLL_TM
+  printf("MCB fwd %u %u\n", UIP_MCAST6_STATS_GET(mcast_fwd),
+         ((struct roll_tm_stats *)uip_mcast6_stats.engine_stats)->icmp_out);
+#else
+  printf("MCB fwd %u 0\n", UIP_MCAST6_STATS_GET(mcast_fwd));
+#endif
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mcast_bench_process, ev, data)
+{
+  static struct etimer send_timer;
+  static struct etimer stats_timer;
+  static uint8_t buf[MCB_PAYLOAD];
+  static uint16_t seq;
+  uip_ipaddr_t ipaddr;
+
+  PROCESS_BEGIN();
+
+  node_id = uip_lladdr.addr[sizeof(uip_lladdr.addr) - 1];
+  set_global_address(&ipaddr);
+  if(node_id == ROOT_ID) {
+    create_rpl_dag(&ipaddr);
+  } else {
+    set_group_address(&ipaddr);
+    uip_ds6_maddr_add(&ipaddr);
+  }
+  simple_udp_register(&connection, MCAST_PORT, NULL, MCAST_PORT, receiver);
+
+  etimer_set(&send_timer, SEND_START);
+  etimer_set(&stats_timer, STATS_INTERVAL + random_rand() % CLOCK_SECOND);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+    if(etimer_expired(&stats_timer)) {
+      etimer_reset(&stats_timer);
+      print_stats();
+    }
+    if(etimer_expired(&send_timer)) {
+      etimer_reset(&send_timer);
+      if(node_id == ROOT_ID) {
+        seq++;
+        memcpy(buf, &seq, sizeof(seq));
+        set_group_address(&ipaddr);
+        printf("MCB send %u\n", seq);
+        simple_udp_sendto(&connection, buf, sizeof(buf), &ipaddr);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
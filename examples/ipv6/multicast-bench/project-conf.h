@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+#include "net/ipv6/multicast/uip-mcast6-engines.h"
+
+/* The engine under test, set by each simulation through
+   DEFINES=MCB_ENGINE=<n>,MCB_INTERVAL=<ms>. Engine codes are those of
+   uip-mcast6-engines.h */
+#ifndef MCB_ENGINE
+#define MCB_ENGINE UIP_MCAST6_ENGINE_ROLL_TM
+#endif
+#define UIP_MCAST6_CONF_ENGINE MCB_ENGINE
+
+/* Logging hooks of apps/deployment, not used here */
+#define LOG_INC_HOPCOUNT_FROM_PACKETBUF()
+#define LOG_PRINT_NEIGHBOR_LIST()
+
+/* Forwarding counters, logged by every node */
+#define UIP_MCAST6_CONF_STATS 1
+
+/* No duty cycling: the benchmark measures the engine, not the MAC.
+   Imin as recommended over NullRDC in examples/ipv6/multicast */
+#undef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC nullrdc_driver
+#define ROLL_TM_CONF_IMIN_1 16
+#define SMRF_CONF_MIN_FWD_DELAY 0
+
+#undef UIP_CONF_ND6_SEND_RA
+#undef UIP_CONF_ROUTER
+#define UIP_CONF_ND6_SEND_RA         0
+#define UIP_CONF_ROUTER              1
+#define UIP_MCAST6_ROUTE_CONF_ROUTES 1
+
+/* One DAG per instance, as in the testbed */
+#undef RPL_CONF_MOP
+#define RPL_CONF_MOP RPL_MOP_STORING_MULTICAST
+#undef RPL_CONF_MAX_DAG_PER_INSTANCE
+#define RPL_CONF_MAX_DAG_PER_INSTANCE 1
+
+#undef UIP_CONF_TCP
+#define UIP_CONF_TCP 0
+
+/* Room for the multicast buffers on the Sky */
+#undef UIP_CONF_DS6_NBR_NBU
+#undef UIP_CONF_DS6_ROUTE_NBU
+#define UIP_CONF_DS6_NBR_NBU        10
+#define UIP_CONF_DS6_ROUTE_NBU      10
+
+#endif /* PROJECT_CONF_H_ */
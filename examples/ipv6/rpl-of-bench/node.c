@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * \file
+ *         Node of the RPL objective function benchmark. Node 1 is the
+ *         root, all others send to it periodically. Every node logs
+ *         the events the simulation script computes the metrics from:
+ *           OFB parent <id> <rank>  preferred parent change (0: none)
+ *           OFB send <seq>          packet sent to the root
+ *           OFB recv <id> <seq>     packet received at the root
+ *           OFB ctrl <n>            ICMPv6 messages sent so far
+ *           OFB dao <n>             DAOs sent so far (with RPL stats)
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "sys/etimer.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/rpl/rpl.h"
+#if RPL_CONF_STATS
+#include "net/rpl/rpl-private.h"
+#endif
+
+#include "simple-udp.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define UDP_PORT 1234
+
+#define ROOT_ID 1
+/* Let the DODAG form before sending */
+#define SEND_START      (60 * CLOCK_SECOND)
+#define SEND_INTERVAL   (30 * CLOCK_SECOND)
+#define CTRL_INTERVAL   (60 * CLOCK_SECOND)
+
+/* In Cooja, the last byte of addresses is the node id */
+#define NODE_ID_FROM_IPADDR(addr) ((addr)->u8[15])
+
+struct ofb_msg {
+  uint16_t id;
+  uint16_t seq;
+};
+
+static struct simple_udp_connection connection;
+static uint8_t node_id;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(of_bench_process, "RPL OF benchmark");
+AUTOSTART_PROCESSES(&of_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  struct ofb_msg msg;
+  if(datalen == sizeof(msg)) {
+    memcpy(&msg, data, sizeof(msg));
+    printf("OFB recv %u %u\n", msg.id, msg.seq);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_global_address(uip_ipaddr_t *ipaddr)
+{
+  uip_ip6addr(ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(ipaddr, 0, ADDR_AUTOCONF);
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_rpl_dag(uip_ipaddr_t *ipaddr)
+{
+  rpl_dag_t *dag;
+  uip_ipaddr_t prefix;
+
+  rpl_set_root(RPL_DEFAULT_INSTANCE, ipaddr);
+  dag = rpl_get_any_dag();
+  uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  rpl_set_prefix(dag, &prefix, 64);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_parent(void)
+{
+  static uint8_t last_parent;
+  static rpl_rank_t last_rank;
+  rpl_dag_t *dag = rpl_get_any_dag();
+  uint8_t parent = 0;
+  rpl_rank_t rank = 0;
+
+  if(dag != NULL && dag->preferred_parent != NULL) {
+    parent = NODE_ID_FROM_IPADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    rank = dag->rank;
+  }
+  if(parent != last_parent || (parent != 0 && rank != last_rank)) {
+    printf("OFB parent %u %u\n", parent, rank);
+    last_parent = parent;
+    last_rank = rank;
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(of_bench_process, ev, data)
+{
+  static struct etimer check_timer;
+  static struct etimer send_timer;
+  static struct etimer ctrl_timer;
+  static struct ofb_msg msg;
+  uip_ipaddr_t ipaddr;
+
+  PROCESS_BEGIN();
+
+  node_id = uip_lladdr.addr[sizeof(uip_lladdr.addr) - 1];
+  set_global_address(&ipaddr);
+  if(node_id == ROOT_ID) {
+    create_rpl_dag(&ipaddr);
+  }
+  simple_udp_register(&connection, UDP_PORT, NULL, UDP_PORT, receiver);
+
+  msg.id = node_id;
+  msg.seq = 0;
+  etimer_set(&check_timer, CLOCK_SECOND);
+  etimer_set(&send_timer, SEND_START + random_rand() % SEND_INTERVAL);
+  etimer_set(&ctrl_timer, CTRL_INTERVAL);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+    if(etimer_expired(&check_timer)) {
+      etimer_reset(&check_timer);
+      if(node_id != ROOT_ID) {
+        check_parent();
+      }
+    }
+    if(etimer_expired(&ctrl_timer)) {
+      etimer_reset(&ctrl_timer);
+      printf("OFB ctrl %u\n", uip_stat.icmp.sent);
+#if RPL_CONF_STATS
+      printf("OFB dao %u\n", rpl_stats.dao_sent);
+#endif
+    }
+    if(etimer_expired(&send_timer)) {
+      etimer_reset(&send_timer);
+      if(node_id != ROOT_ID) {
+        uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0x0201, 0x0001, 0x0001, 0x0001);
+        msg.seq++;
+        printf("OFB send %u\n", msg.seq);
+        simple_udp_sendto(&connection, &msg, sizeof(msg), &ipaddr);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* The objective function under test, set by each simulation through
+   DEFINES=OF_BENCH_OF=<n>. The settings of each OF are those of the
+   TSCH testbed (examples/tsch-testbed/project-conf.h). */
+#define OF_BENCH_OF0      0
+#define OF_BENCH_MRHOF    1
+#define OF_BENCH_ETX_EXP  2
+#define OF_BENCH_HOP_ETX  3
+#define OF_BENCH_PDR      4
+
+#ifndef OF_BENCH_OF
+#define OF_BENCH_OF OF_BENCH_MRHOF
+#endif
+
+/* Storing mode instead of upward traffic only, for the DAO overhead,
+   with DEFINES=OF_BENCH_OF=<n>,OF_BENCH_STORING=1, optionally with
+   OF_BENCH_DAO_AGGREGATION=1 */
+#ifndef OF_BENCH_STORING
+#define OF_BENCH_STORING 0
+#endif
+#ifndef OF_BENCH_DAO_AGGREGATION
+#define OF_BENCH_DAO_AGGREGATION 0
+#endif
+
+/* Logging hooks of apps/deployment, not used here */
+#define LOG_INC_HOPCOUNT_FROM_PACKETBUF()
+#define LOG_PRINT_NEIGHBOR_LIST()
+
+/* ICMPv6 tx counters, for the control overhead */
+#undef UIP_CONF_STATISTICS
+#define UIP_CONF_STATISTICS 1
+
+/* Upward traffic only unless OF_BENCH_STORING, one DAG per instance,
+   as in the testbed */
+#undef RPL_CONF_MOP
+#if OF_BENCH_STORING
+#define RPL_CONF_MOP RPL_MOP_STORING_NO_MULTICAST
+#define RPL_CONF_DAO_AGGREGATION OF_BENCH_DAO_AGGREGATION
+/* DAO tx counter */
+#define RPL_CONF_STATS 1
+#else
+#define RPL_CONF_MOP RPL_MOP_NO_DOWNWARD_ROUTES
+#endif
+#undef RPL_CONF_MAX_DAG_PER_INSTANCE
+#define RPL_CONF_MAX_DAG_PER_INSTANCE 1
+
+#if OF_BENCH_OF == OF_BENCH_OF0
+
+#undef RPL_CONF_OF
+#define RPL_CONF_OF rpl_of0
+
+#elif OF_BENCH_OF == OF_BENCH_MRHOF
+
+#undef RPL_CONF_OF
+#define RPL_CONF_OF rpl_mrhof
+
+#elif OF_BENCH_OF == OF_BENCH_ETX_EXP
+
+#undef RPL_CONF_OF
+#define RPL_CONF_OF rpl_of_etx_exp
+#undef RPL_CONF_INIT_LINK_METRIC
+#define RPL_CONF_INIT_LINK_METRIC 2
+#undef RPL_CONF_MIN_HOPRANKINC
+#define RPL_CONF_MIN_HOPRANKINC 256
+#undef RPL_CONF_MAX_HOPRANKINC
+#define RPL_CONF_MAX_HOPRANKINC 0
+#define RPL_CONF_MAX_NBRHOPINC (RPL_MIN_HOPRANKINC + RPL_MIN_HOPRANKINC/2)
+#define RPL_OF_ETX_EXP_CONF_N 2
+
+#elif OF_BENCH_OF == OF_BENCH_HOP_ETX
+
+#define WITH_OF_HOP_ETX 1
+#undef RPL_CONF_OF
+#define RPL_CONF_OF rpl_of_hop_etx
+#undef RPL_CONF_INIT_LINK_METRIC
+#define RPL_CONF_INIT_LINK_METRIC 1
+#undef RPL_CONF_MIN_HOPRANKINC
+#define RPL_CONF_MIN_HOPRANKINC 1
+#undef RPL_CONF_MAX_HOPRANKINC
+#define RPL_CONF_MAX_HOPRANKINC 0
+#define RPL_CONF_MAX_NBRHOPINC 4
+#define RPL_OF_HOP_ETX_CONF_THRESHOLD (RPL_DAG_MC_ETX_DIVISOR / 2)
+
+#elif OF_BENCH_OF == OF_BENCH_PDR
+
+#undef RPL_CONF_OF
+#define RPL_CONF_OF rpl_of_pdr
+#undef RPL_CONF_INIT_LINK_METRIC
+#define RPL_CONF_INIT_LINK_METRIC (64256/RPL_DAG_MC_ETX_DIVISOR) /* 98% PRR */
+#undef RPL_CONF_MIN_HOPRANKINC
+#define RPL_CONF_MIN_HOPRANKINC 1
+#undef RPL_CONF_MAX_HOPRANKINC
+#define RPL_CONF_MAX_HOPRANKINC 0
+
+#else
+#error Unknown OF_BENCH_OF
+#endif
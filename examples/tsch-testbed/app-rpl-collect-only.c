@@ -37,6 +37,7 @@
 
 #include "contiki-conf.h"
 #include "net/netstack.h"
+#include "net/mac/tsch/tsch.h"
 #include "net/mac/tsch/tsch-schedule.h"
 #include "net/rpl/rpl-private.h"
 #include "net/mac/tsch/tsch-schedule.h"
@@ -51,6 +52,23 @@
 #define SEND_INTERVAL   (CLOCK_SECOND)
 #define UDP_PORT 1234
 
+/* Generate packets just before our next Tx cell rather than at a random time,
+ * to minimize queuing latency */
+#ifdef APP_CONF_JIT_SEND
+#define APP_JIT_SEND APP_CONF_JIT_SEND
+#else
+#define APP_JIT_SEND WITH_TSCH
+#endif
+/* How many slots before the Tx cell the packets are generated */
+#define APP_JIT_LEAD_SLOTS 2
+
+/* Send to the neighbor we have dedicated Tx cells to, rather than to all
+ * neighbors through the shared cells */
+#define APP_WITH_DEDICATED (WITH_TSCH && WITH_ORCHESTRA && ORCHESTRA_WITH_DEDICATED)
+
+/* Copies of each packet sent, in one batch */
+#define APP_COPIES 3
+
 static struct simple_udp_connection unicast_connection;
 extern struct asn_t current_asn;
 extern uint16_t record_slot;
@@ -59,6 +77,15 @@ extern uint16_t record_slot;
 PROCESS(unicast_sender_process, "Collect-only Application");
 AUTOSTART_PROCESSES(&unicast_sender_process);
 /*---------------------------------------------------------------------------*/
+#if APP_JIT_SEND
+static struct tsch_asn_callback jit_callback;
+static void
+jit_send_callback(void *ptr)
+{
+  process_poll(&unicast_sender_process);
+}
+#endif /* APP_JIT_SEND */
+/*---------------------------------------------------------------------------*/
 static void
 receiver(struct simple_udp_connection *c,
          const uip_ipaddr_t *sender_addr,
@@ -74,9 +101,34 @@ receiver(struct simple_udp_connection *c,
     struct app_data data2;
     appdata_copy(&data2, data);
     printf("%d %d %u\n", UIP_HTONS(data2.src), node_id, record_slot);
+#if WITH_LOG_LATENCY
+    if(node_id == ROOT_ID) {
+      log_latency_record(&data2);
+    }
+#endif /* WITH_LOG_LATENCY */
   }
 }
 /*---------------------------------------------------------------------------*/
+#if APP_WITH_DEDICATED
+/* Sets the link-local address of our scheduled receiver. Returns 0 if we
+ * have no dedicated Tx cell. The neighbor is added to the ds6 neighbor cache
+ * as we do not run ND. */
+static int
+get_scheduled_receiver_ipaddr(uip_ipaddr_t *ipaddr)
+{
+  linkaddr_t lladdr;
+  if(!orchestra_get_scheduled_receiver(&lladdr)) {
+    return 0;
+  }
+  uip_create_linklocal_prefix(ipaddr);
+  uip_ds6_set_addr_iid(ipaddr, (uip_lladdr_t *)&lladdr);
+  if(uip_ds6_nbr_lookup(ipaddr) == NULL) {
+    return uip_ds6_nbr_add(ipaddr, (uip_lladdr_t *)&lladdr, 0, NBR_REACHABLE) != NULL;
+  }
+  return 1;
+}
+#endif /* APP_WITH_DEDICATED */
+/*---------------------------------------------------------------------------*/
 int
 can_send_to(uip_ipaddr_t *ipaddr) {
   return uip_ds6_is_addr_onlink(ipaddr)
@@ -89,13 +141,18 @@ app_send_to(uint16_t id, uint32_t seqno, unsigned int to_send_cnt)
 {
 
   struct app_data data;
+  struct simple_udp_datagram batch[APP_COPIES];
   uip_ipaddr_t dest_ipaddr;
+  int i;
 
   data.magic = UIP_HTONL(LOG_MAGIC);
   data.seqno = UIP_HTONL(seqno);
   data.src = UIP_HTONS(node_id);
   data.dest = UIP_HTONS(id);
   data.hop = 0;
+#if WITH_LOG_LATENCY
+  log_latency_init(&data);
+#endif /* WITH_LOG_LATENCY */
 
   set_ipaddr_from_id(&dest_ipaddr, id);
 
@@ -105,11 +162,20 @@ app_send_to(uint16_t id, uint32_t seqno, unsigned int to_send_cnt)
     //LOG("App: sending\n");
     //simple_udp_sendto(&unicast_connection, &data, sizeof(data), &dest_ipaddr);
     //simple_udp_send(&unicast_connection, &data, sizeof(data));
-    uip_create_linklocal_allnodes_mcast(&dest_ipaddr);
+#if APP_WITH_DEDICATED
+    if(!get_scheduled_receiver_ipaddr(&dest_ipaddr))
+#endif /* APP_WITH_DEDICATED */
+    {
+      uip_create_linklocal_allnodes_mcast(&dest_ipaddr);
+    }
     //simple_udp_sendto(&unicast_connection, "Test", 4, &dest_ipaddr);
-    simple_udp_sendto(&unicast_connection, &data, sizeof(data), &dest_ipaddr);
-    simple_udp_sendto(&unicast_connection, &data, sizeof(data), &dest_ipaddr);
-    simple_udp_sendto(&unicast_connection, &data, sizeof(data), &dest_ipaddr);
+    for(i = 0; i < APP_COPIES; i++) {
+      batch[i].data = &data;
+      batch[i].datalen = sizeof(data);
+    }
+    /* Stops at the first copy the MAC queue has no room for. Copies are
+       not retried: if none made it, the seqno shows up as lost */
+    simple_udp_sendto_batch(&unicast_connection, batch, APP_COPIES, &dest_ipaddr);
     return 1;
   } else {
     data.seqno = UIP_HTONL(seqno + to_send_cnt - 1);
@@ -126,6 +192,9 @@ PROCESS_THREAD(unicast_sender_process, ev, data)
   static unsigned int cnt;
   static unsigned int to_send_cnt;
   static uint32_t seqno;
+#if APP_JIT_SEND
+  static linkaddr_t jit_addr;
+#endif /* APP_JIT_SEND */
 
   PROCESS_BEGIN();
 
@@ -148,8 +217,24 @@ PROCESS_THREAD(unicast_sender_process, ev, data)
   //if(node_id != ROOT_ID) {
     etimer_set(&periodic_timer, SEND_INTERVAL);
     while(1) {
-      etimer_set(&send_timer, random_rand() % (SEND_INTERVAL));
-      PROCESS_WAIT_UNTIL(etimer_expired(&send_timer));
+#if APP_JIT_SEND
+#if APP_WITH_DEDICATED
+      /* Wait for the next dedicated Tx cell to our receiver */
+      if(!orchestra_get_scheduled_receiver(&jit_addr))
+#endif /* APP_WITH_DEDICATED */
+      {
+        /* Our packets are link-layer broadcast, wait for the next broadcast Tx cell */
+        linkaddr_copy(&jit_addr, &linkaddr_null);
+      }
+      if(tsch_asn_callback_set_before_tx(&jit_callback, &jit_addr,
+            APP_JIT_LEAD_SLOTS, jit_send_callback, NULL)) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+      } else
+#endif /* APP_JIT_SEND */
+      {
+        etimer_set(&send_timer, random_rand() % (SEND_INTERVAL));
+        PROCESS_WAIT_UNTIL(etimer_expired(&send_timer));
+      }
 
       //if(default_instance != NULL) {
         to_send_cnt++;
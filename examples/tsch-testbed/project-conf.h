@@ -95,11 +95,40 @@
 #define TSCH_CALLBACK_LEAVING_NETWORK tsch_rpl_callback_leaving_network
 #endif
 #define RPL_CALLBACK_PARENT_SWITCH tsch_rpl_callback_parent_switch
+#define RPL_CALLBACK_REMOVE_PARENT tsch_rpl_callback_remove_parent
 #define RPL_CALLBACK_NEW_DIO_INTERVAL tsch_rpl_callback_new_dio_interval
+#define TSCH_CALLBACK_EB_RECEIVED tsch_rpl_callback_eb_received
 #endif
 
 #define TSCH_CONF_GUARD_TIME 600
 
+#if CONFIG == CONFIG_TSCH
+/* Report TSCH queue congestion to applications, and stop local UDP
+   traffic to a next hop while its queue is congested */
+#define TSCH_CALLBACK_QUEUE_CONGESTION tcpip_set_congested
+#define TCPIP_CALLBACK_NBR_CONGESTED tsch_queue_nbr_is_congested
+#endif
+
+/* Downward multicast from the root (e.g. configuration pushes) with SMRF,
+ * in Orchestra multicast cells scheduled along the DODAG depth: one
+ * slotframe per hop at most. Build with make WITH_TSCH_MULTICAST=1 */
+#ifndef WITH_TSCH_MULTICAST
+#define WITH_TSCH_MULTICAST 0
+#endif
+#if WITH_TSCH_MULTICAST && CONFIG == CONFIG_TSCH && ORCHESTRA_CONFIG == ORCHESTRA_SENDER_BASED
+#include "net/ipv6/multicast/uip-mcast6-engines.h"
+#define UIP_MCAST6_CONF_ENGINE UIP_MCAST6_ENGINE_SMRF
+/* The cells serialize forwarding, no need for SMRF's random delay */
+#define SMRF_CONF_MIN_FWD_DELAY 0
+#define TSCH_CONF_WITH_MULTICAST_QUEUE 1
+#define TSCH_CALLBACK_IS_MULTICAST tsch_rpl_callback_is_multicast
+#define ORCHESTRA_CONF_WITH_MULTICAST 1
+#define TSCH_CALLBACK_NEW_JOIN_PRIORITY orchestra_callback_new_join_priority
+#endif
+
+/* Keep a secondary time source (another RPL parent) for instantaneous failover */
+#define TSCH_CONF_MAX_TIME_SOURCES 2
+
 /* #define WITH_OF_HOP_ETX 1 */
 /* #define WITH_OF_PDR 1 */
 #define WITH_OF_ETX_EXP 1
@@ -112,6 +141,10 @@
 #define RPL_CONF_PROBING_TX_THRESHOLD 4 /* Stop probing after 4 tx to a neighbor */
 #define RPL_CONF_PROBING_LOCK_ALL 1
 #define RPL_CONF_RSSI_BASED_ETX 1
+#if WITH_RPL && CONFIG == CONFIG_TSCH
+/* EBs and ACKs keep link estimates fresh: probe only stale neighbors */
+#define RPL_CONF_PROBING_EXPIRATION 300
+#endif
 
 #define ANNOTATE_DEFAULT_ROUTE IN_COOJA
 
@@ -170,8 +203,14 @@
 
 /* No Downwards routes */
 #undef RPL_CONF_MOP
+#if WITH_TSCH_MULTICAST
+/* Multicast routes, for SMRF */
+#define RPL_CONF_MOP RPL_MOP_STORING_MULTICAST
+#else
 #define RPL_CONF_MOP RPL_MOP_NO_DOWNWARD_ROUTES
+#endif
 //#define RPL_CONF_MOP RPL_MOP_STORING_NO_MULTICAST
+//#define RPL_CONF_MOP RPL_MOP_NON_STORING
 
 #undef UIP_CONF_IP_FORWARD
 #define UIP_CONF_IP_FORWARD 0
@@ -254,6 +293,23 @@
 #undef RPL_CONF_DIS_SEND
 #define RPL_CONF_DIS_SEND 0
 
+/* Reuse the compressed headers of the periodic flows */
+#undef SICSLOWPAN_CONF_HC06_CACHE
+#define SICSLOWPAN_CONF_HC06_CACHE 2
+
+/* 6LoWPAN contexts spread by the root in its DIOs (6CO), including /128
+ * contexts it allocates to the addresses it most often sees inline.
+ * Build with make WITH_DYNAMIC_CONTEXTS=1 */
+#ifndef WITH_DYNAMIC_CONTEXTS
+#define WITH_DYNAMIC_CONTEXTS 0
+#endif
+#if WITH_DYNAMIC_CONTEXTS
+#define SICSLOWPAN_CONF_DYNAMIC_CONTEXTS 1
+#define SICSLOWPAN_CONF_CONTEXT_ALLOC 1
+#undef SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS
+#define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS 4
+#endif
+
 /* Space saving */
 #undef UIP_CONF_TCP
 #define UIP_CONF_TCP             0
@@ -353,6 +409,8 @@
 #define WITH_TSCH_LOG 0
 #define WITH_LOG 1
 #define WITH_LOG_HOP_COUNT 1
+/* Trace generation and per-hop queueing ASNs in app_data, aggregated at the root */
+#define WITH_LOG_LATENCY (CONFIG == CONFIG_TSCH)
 #if WITH_LOG
 #include "deployment-log.h"
 #endif
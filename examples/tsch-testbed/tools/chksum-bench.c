@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native micro-benchmark of the IPv6 checksum of core/net/ipv6/uip6.c
+ *         against the former byte-pair loop, kept here as reference. Times
+ *         uip_chksum() on aligned and odd buffers and uip_udpchksum() on
+ *         UDP packets of the given payload lengths, checking both against
+ *         the reference, then the update of an echo reply checksum with
+ *         uip_chksum_update() against a full uip_icmp6chksum().
+ *
+ *         Build and run from this directory:
+ *         gcc -O2 -I../../../core -I../../../core/net -I../../../platform/native \
+ *           -I../../../cpu/native -DNETSTACK_CONF_WITH_IPV6=1 \
+ *           -DUIP_CONF_IPV6_RPL=0 -o chksum-bench chksum-bench.c \
+ *           ../../../core/net/ipv6/uip6.c && ./chksum-bench 16 64 100
+ *
+ *         Before any timing, uip_chksum() is checked against the reference
+ *         for every length up to UIP_BUFSIZE on even- and odd-aligned
+ *         buffers. Built with -DUIP_ARCH_CHKSUM_WORDS=1 and linked with the
+ *         architecture's uip_arch_chksum_words() (e.g.
+ *         cpu/msp430/uip-ipchksum.c), the check validates that routine,
+ *         which is also compared to a plain sum of the words.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uip-icmp6.h"
+#include "net/ipv6/uip-nd6.h"
+
+#define RUNS 1000000
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_ICMP_BUF ((struct uip_icmp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define UIP_UDP_BUF  ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+/*---------------------------------------------------------------------------*/
+/* Stubs for the parts of the stack uip6.c calls into, never called here */
+uip_ds6_netif_t uip_ds6_if;
+
+void uip_ds6_init(void) {}
+void uip_nd6_init(void) {}
+void uip_icmp6_init(void) {}
+void tcpip_uipcall(void) {}
+void tcpip_icmp6_call(uint8_t type) {}
+uint8_t uip_icmp6_input(uint8_t type, uint8_t icode) { return 0; }
+void uip_icmp6_error_output(uint8_t type, uint8_t code, uint32_t param) {}
+void uip_ds6_select_src(uip_ipaddr_t *src, uip_ipaddr_t *dst) {}
+uip_ds6_addr_t *uip_ds6_addr_lookup(uip_ipaddr_t *ipaddr) { return NULL; }
+uip_ds6_maddr_t *uip_ds6_maddr_lookup(const uip_ipaddr_t *ipaddr) { return NULL; }
+uint8_t uip_ds6_is_addr_onlink(uip_ipaddr_t *ipaddr) { return 0; }
+/*---------------------------------------------------------------------------*/
+/* Reference: the former chksum() of uip6.c */
+static uint16_t
+ref_chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  dataptr = data;
+  last_byte = data + len - 1;
+
+  while(dataptr < last_byte) {
+    t = (dataptr[0] << 8) + dataptr[1];
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+    dataptr += 2;
+  }
+
+  if(dataptr == last_byte) {
+    t = (dataptr[0] << 8) + 0;
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+  }
+  return sum;
+}
+static uint16_t
+ref_upper_layer_chksum(uint8_t proto)
+{
+  uint16_t upper_layer_len;
+  uint16_t sum;
+
+  upper_layer_len = ((uint16_t)(UIP_IP_BUF->len[0]) << 8) + UIP_IP_BUF->len[1];
+  sum = upper_layer_len + proto;
+  sum = ref_chksum(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+  sum = ref_chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN], upper_layer_len);
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t rnd_state = 1;
+static uint32_t
+rnd(void)
+{
+  /* xorshift32, for reproducible runs */
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+/* A packet from fd00::<src> to fd00::<dst> with a random payload */
+static void
+make_packet(uint8_t proto, int payload_len)
+{
+  int len = (proto == UIP_PROTO_UDP ? UIP_UDPH_LEN : UIP_ICMPH_LEN) + payload_len;
+  int i;
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = proto;
+  UIP_IP_BUF->ttl = 64;
+  UIP_IP_BUF->len[0] = len >> 8;
+  UIP_IP_BUF->len[1] = len & 0xff;
+  uip_ip6addr(&UIP_IP_BUF->srcipaddr, 0xfd00, 0, 0, 0, 0x0212, 0x7400, 0, rnd());
+  uip_ip6addr(&UIP_IP_BUF->destipaddr, 0xfd00, 0, 0, 0, 0x0212, 0x7400, 0, 1);
+  for(i = 0; i < len; i++) {
+    uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + i] = rnd();
+  }
+  uip_len = UIP_IPH_LEN + len;
+  uip_ext_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the number of mismatches of the word path against the reference */
+static int
+validate(void)
+{
+  /* 16-bit aligned, data + 1 is the odd buffer */
+  static uint16_t words[UIP_BUFSIZE / 2 + 1];
+  uint8_t *data = (uint8_t *)words;
+  int errors = 0;
+  int len;
+  int i;
+
+  for(i = 0; i < (int)sizeof(words); i++) {
+    data[i] = rnd();
+  }
+  /* All ones, to exercise the carries */
+  memset(data + UIP_BUFSIZE / 2, 0xff, UIP_BUFSIZE / 4);
+  for(len = 0; len <= UIP_BUFSIZE; len++) {
+    for(i = 0; i < 2; i++) {
+      if(uip_chksum((uint16_t *)(data + i), len)
+         != uip_htons(ref_chksum(0, data + i, len))) {
+        printf("  mismatch: %d bytes %s\n", len, i ? "odd" : "aligned");
+        errors++;
+      }
+    }
+#if UIP_ARCH_CHKSUM_WORDS
+    {
+      uint32_t acc = 0;
+      for(i = 0; i < len / 2; i++) {
+        acc += words[i];
+      }
+      if(uip_arch_chksum_words(words, len / 2) != acc) {
+        printf("  mismatch: uip_arch_chksum_words, %d words\n", len / 2);
+        errors++;
+      }
+    }
+#endif /* UIP_ARCH_CHKSUM_WORDS */
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench(int payload_len)
+{
+  static uint8_t data[UIP_BUFSIZE + 2];
+  volatile uint16_t sink;
+  double t_ref, t_new;
+  int errors = 0;
+  int len = payload_len + UIP_UDPH_LEN;
+  int i;
+
+  /* Raw buffer, aligned then odd */
+  for(i = 0; i < (int)sizeof(data); i++) {
+    data[i] = rnd();
+  }
+  for(i = 0; i < 2; i++) {
+    int j;
+    double t;
+    t = now_ns();
+    for(j = 0; j < RUNS; j++) {
+      sink = ref_chksum(0, data + i, len);
+    }
+    t_ref = now_ns() - t;
+    t = now_ns();
+    for(j = 0; j < RUNS; j++) {
+      sink = uip_chksum((uint16_t *)(data + i), len);
+    }
+    t_new = now_ns() - t;
+    errors += uip_chksum((uint16_t *)(data + i), len) != uip_htons(ref_chksum(0, data + i, len));
+    printf("  %4d bytes %s: byte pairs %7.1f ns   words %7.1f ns\n",
+           len, i ? "odd    " : "aligned", t_ref / RUNS, t_new / RUNS);
+  }
+
+  /* UDP packets, as checked on input and computed on output */
+  make_packet(UIP_PROTO_UDP, payload_len);
+  t_ref = now_ns();
+  for(i = 0; i < RUNS; i++) {
+    sink = ref_upper_layer_chksum(UIP_PROTO_UDP);
+  }
+  t_ref = now_ns() - t_ref;
+  t_new = now_ns();
+  for(i = 0; i < RUNS; i++) {
+    sink = uip_udpchksum();
+  }
+  t_new = now_ns() - t_new;
+  errors += uip_udpchksum() != ref_upper_layer_chksum(UIP_PROTO_UDP);
+  printf("  %4d bytes UDP    : byte pairs %7.1f ns   words %7.1f ns\n",
+         len, t_ref / RUNS, t_new / RUNS);
+
+  /* Echo reply: full checksum vs RFC 1624 update of the request one */
+  make_packet(UIP_PROTO_ICMP6, payload_len);
+  UIP_ICMP_BUF->type = ICMP6_ECHO_REQUEST;
+  UIP_ICMP_BUF->icode = 0;
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+  t_ref = now_ns();
+  for(i = 0; i < RUNS; i++) {
+    sink = ~uip_icmp6chksum();
+  }
+  t_ref = now_ns() - t_ref;
+  t_new = now_ns();
+  for(i = 0; i < RUNS; i++) {
+    sink = uip_chksum_update(UIP_ICMP_BUF->icmpchksum, UIP_HTONS(ICMP6_ECHO_REQUEST << 8),
+                             UIP_HTONS(ICMP6_ECHO_REPLY << 8));
+  }
+  t_new = now_ns() - t_new;
+  UIP_ICMP_BUF->icmpchksum = sink;
+  UIP_ICMP_BUF->type = ICMP6_ECHO_REPLY;
+  errors += uip_icmp6chksum() != 0xffff;
+  printf("  %4d bytes echo   : full       %7.1f ns   update %6.1f ns\n",
+         len - UIP_UDPH_LEN + UIP_ICMPH_LEN, t_ref / RUNS, t_new / RUNS);
+
+  if(errors) {
+    printf("  %d MISMATCHES\n", errors);
+  }
+  (void)sink;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int i;
+  int n;
+
+  printf("uip_chksum() against the reference, lengths 0 to %d: ", UIP_BUFSIZE);
+  n = validate();
+  if(n) {
+    printf("%d MISMATCHES\n", n);
+    return 1;
+  }
+  printf("ok\n");
+
+  printf("IPv6 checksum, per packet:\n");
+  if(argc < 2) {
+    bench(64);
+    return 0;
+  }
+  for(i = 1; i < argc; i++) {
+    n = atoi(argv[i]);
+    if(n < 0 || n > UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPH_LEN - UIP_UDPH_LEN) {
+      fprintf(stderr, "payload length must be in [0, %d]\n",
+              UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPH_LEN - UIP_UDPH_LEN);
+      return 2;
+    }
+    bench(n);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
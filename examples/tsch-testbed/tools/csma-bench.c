@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native fairness benchmark of core/net/mac/csma.c, on a simulated
+ *         clock with a nullrdc-like radio duty cycling layer. A router
+ *         sends to one busy neighbor over a lossy link (150 packets/s,
+ *         50% PRR), to four light neighbors (4 packets/s each, 90% PRR)
+ *         and broadcasts 1 packet/s, for 600 s. Prints, per destination,
+ *         the packets offered, delivered, dropped when queuing (err) and
+ *         after the last retransmission (noack), and the queuing latency.
+ *
+ *         Build and run from this directory, once per CSMA variant:
+ *         for s in 0 1; do gcc -O2 -I../../../core -I../../../platform/native \
+ *           -I../../../cpu/native -DNETSTACK_CONF_RDC=bench_rdc \
+ *           -DNETSTACK_CONF_LLSEC=bench_llsec -DQUEUEBUF_CONF_NUM=16 \
+ *           -DNBR_TABLE_CONF_MAX_NEIGHBORS=8 -DCSMA_CONF_MAX_NEIGHBOR_QUEUES=8 \
+ *           -DCSMA_CONF_WITH_SCHEDULER=$s '-DLOGP(...)=' -o csma-bench \
+ *           csma-bench.c ../../../core/net/mac/csma.c ../../../core/net/mac/mac.c \
+ *           ../../../core/net/packetbuf.c ../../../core/net/queuebuf.c \
+ *           ../../../core/net/nbr-table.c ../../../core/net/linkaddr.c \
+ *           ../../../core/lib/list.c ../../../core/lib/memb.c \
+ *           ../../../core/lib/random.c ../../../core/sys/timer.c && ./csma-bench; done
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/csma.h"
+#include "net/mac/rdc.h"
+#include "net/llsec/llsec.h"
+
+#define DURATION (600 * CLOCK_SECOND)
+/* Air time of a packet and its ack, in clock ticks */
+#define TX_TIME 4
+/* Destination 0 is broadcast, 1 the busy neighbor */
+#define DESTINATIONS 6
+#define MAX_CTIMERS 16
+
+#ifndef CSMA_CONF_WITH_SCHEDULER
+#define CSMA_CONF_WITH_SCHEDULER 0
+#endif
+
+struct destination {
+  clock_time_t interval;
+  int prr;
+  clock_time_t next;
+  long offered, ok, err, noack;
+  clock_time_t latency;
+};
+static struct destination dest[DESTINATIONS];
+
+/*---------------------------------------------------------------------------*/
+/* Simulated clock and ctimers */
+static clock_time_t now;
+static struct ctimer *ctimers[MAX_CTIMERS];
+static int num_ctimers;
+
+clock_time_t
+clock_time(void)
+{
+  return now;
+}
+void
+ctimer_stop(struct ctimer *c)
+{
+  int i;
+  for(i = 0; i < num_ctimers; i++) {
+    if(ctimers[i] == c) {
+      ctimers[i] = ctimers[--num_ctimers];
+      return;
+    }
+  }
+}
+void
+ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr)
+{
+  ctimer_stop(c);
+  timer_set(&c->etimer.timer, t);
+  c->f = f;
+  c->ptr = ptr;
+  if(num_ctimers == MAX_CTIMERS) {
+    fprintf(stderr, "too many ctimers\n");
+    exit(1);
+  }
+  ctimers[num_ctimers++] = c;
+}
+/* Clock ticks until a ctimer fires */
+static clock_time_t
+ctimer_due(struct ctimer *c)
+{
+  return timer_expired(&c->etimer.timer) ? 0 : timer_remaining(&c->etimer.timer);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t rnd_state = 1;
+static uint32_t
+rnd(void)
+{
+  /* xorshift32, for reproducible runs */
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+/*---------------------------------------------------------------------------*/
+/* A radio duty cycling layer that sends lists as nullrdc does */
+static void
+send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *list)
+{
+  while(list != NULL) {
+    struct rdc_buf_list *next = list->next;
+    int d;
+
+    queuebuf_to_packetbuf(list->buf);
+    d = packetbuf_addr(PACKETBUF_ADDR_RECEIVER)->u8[0];
+    now += TX_TIME;
+    if(d != 0 && rnd() % 100 >= dest[d].prr) {
+      sent(ptr, MAC_TX_NOACK, 1);
+      return;
+    }
+    sent(ptr, MAC_TX_OK, 1);
+    list = next;
+  }
+}
+static void
+rdc_init(void)
+{
+}
+static int
+rdc_on(void)
+{
+  return 0;
+}
+static int
+rdc_off(int keep_radio_on)
+{
+  return 0;
+}
+static unsigned short
+rdc_channel_check_interval(void)
+{
+  return 0;
+}
+const struct rdc_driver bench_rdc = {
+  "bench", rdc_init, NULL, send_list, NULL, rdc_on, rdc_off,
+  rdc_channel_check_interval,
+};
+const struct llsec_driver bench_llsec;
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(void *ptr, int status, int num_tx)
+{
+  struct destination *d = &dest[((uintptr_t)ptr) >> 24];
+  clock_time_t queued = ((uintptr_t)ptr) & 0xffffff;
+
+  if(status == MAC_TX_OK) {
+    d->ok++;
+    d->latency += now - queued;
+  } else if(status == MAC_TX_ERR) {
+    d->err++;
+  } else {
+    d->noack++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_to(int i)
+{
+  linkaddr_t addr;
+
+  packetbuf_clear();
+  packetbuf_set_datalen(60);
+  memset(&addr, 0, sizeof(addr));
+  addr.u8[0] = i;
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &addr);
+  dest[i].offered++;
+  csma_driver.send(packet_sent, (void *)(((uintptr_t)i << 24) | now));
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  struct ctimer *c;
+  int first_ctimer;
+  int first_dest;
+  int i;
+
+  dest[0].interval = CLOCK_SECOND;
+  dest[0].prr = 100;
+  dest[1].interval = CLOCK_SECOND / 150;
+  dest[1].prr = 50;
+  for(i = 2; i < DESTINATIONS; i++) {
+    dest[i].interval = CLOCK_SECOND / 4;
+    dest[i].prr = 90;
+  }
+  for(i = 0; i < DESTINATIONS; i++) {
+    dest[i].next = rnd() % dest[i].interval;
+  }
+  queuebuf_init();
+  csma_driver.init();
+
+  while(now < DURATION) {
+    first_ctimer = -1;
+    for(i = 0; i < num_ctimers; i++) {
+      if(first_ctimer == -1
+         || ctimer_due(ctimers[i]) < ctimer_due(ctimers[first_ctimer])) {
+        first_ctimer = i;
+      }
+    }
+    first_dest = 0;
+    for(i = 1; i < DESTINATIONS; i++) {
+      if(dest[i].next < dest[first_dest].next) {
+        first_dest = i;
+      }
+    }
+    if(first_ctimer != -1
+       && now + ctimer_due(ctimers[first_ctimer]) <= dest[first_dest].next) {
+      c = ctimers[first_ctimer];
+      now += ctimer_due(c);
+      ctimer_stop(c);
+      c->f(c->ptr);
+    } else {
+      if(dest[first_dest].next > now) {
+        now = dest[first_dest].next;
+      }
+      /* Packets arrive every interval, give or take a half */
+      dest[first_dest].next = now + dest[first_dest].interval / 2
+        + rnd() % dest[first_dest].interval;
+      send_to(first_dest);
+    }
+  }
+
+  printf("csma, %s:\n", CSMA_CONF_WITH_SCHEDULER ?
+         "scheduler" : "per-neighbor timers");
+  printf("  dest  offered     ok    err  noack  latency\n");
+  for(i = 0; i < DESTINATIONS; i++) {
+    printf("  %-5s %7ld %6ld %6ld %6ld  %5.1f ms\n",
+           i == 0 ? "bcast" : i == 1 ? "busy" : "light",
+           dest[i].offered, dest[i].ok, dest[i].err, dest[i].noack,
+           dest[i].ok ? (double)dest[i].latency / dest[i].ok : 0.0);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,699 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native benchmark of the full-network update time of
+ *         apps/deluge/deluge.c over TSCH. 50 nodes on a 10x5 grid
+ *         (90% PRR to the 4 closest neighbors, 70% to the diagonal
+ *         ones) each run their own copy of Deluge, loaded from a shared
+ *         object, on a slot-level TSCH model with 10 ms slots: one
+ *         shared cell every 31 slots as in Orchestra, plus with bulk
+ *         transfer the Orchestra bulk slotframe (8 slots, reserved from
+ *         the time source tree, lowest priority). Node 1, at a corner,
+ *         disseminates a new version of a file. Prints when nodes get
+ *         the update and the frames sent.
+ *
+ *         Build and run from this directory, once per Deluge mode:
+ *         for b in 0 1; do gcc -O2 -fPIC -shared -Wl,-Bsymbolic \
+ *           -I../../../core -I../../../platform/native -I../../../cpu/native \
+ *           -I../../../apps/deluge -DNETSTACK_CONF_WITH_RIME=1 \
+ *           -DDELUGE_CONF_BULK_TRANSFER=$b \
+ *           -DDELUGE_CALLBACK_BULK_RESERVE=bench_bulk_reserve \
+ *           -DDELUGE_CALLBACK_BULK_RELEASE=bench_bulk_release \
+ *           -o deluge.so ../../../apps/deluge/deluge.c && \
+ *         gcc -O2 -rdynamic -I../../../core -I../../../platform/native \
+ *           -I../../../cpu/native -I../../../apps/deluge \
+ *           -DNETSTACK_CONF_WITH_RIME=1 -DDELUGE_CONF_BULK_TRANSFER=$b \
+ *           -o deluge-bench deluge-bench.c ../../../core/net/packetbuf.c \
+ *           ../../../core/net/linkaddr.c ../../../core/lib/crc16.c \
+ *           ../../../core/sys/timer.c -ldl && ./deluge-bench; done
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/rime/rime.h"
+#include "cfs/cfs.h"
+#include "dev/leds.h"
+#include "deluge.h"
+
+#define GRID_W 10
+#define GRID_H 5
+#define NODES (GRID_W * GRID_H)
+#define SINK 0
+#define FILE_SIZE (32 * S_PAGE)
+#define SLOT_TICKS (CLOCK_SECOND / 100)
+#define MAX_DURATION (6L * 3600 * CLOCK_SECOND)
+/* Orchestra: shared cell, bulk slotframe (see tools/orchestra.h) */
+#define SHARED_PERIOD 31
+#define BULK_SPREAD 4
+#define BULK_PERIOD (2 * BULK_SPREAD)
+/* TSCH queues and CSMA */
+#define QUEUE_LEN 8
+#define POOL_LEN 16
+#define MAX_FRAME_RETRIES 8
+#define MAX_BE 4
+#define MAX_TIMERS 512
+/* The broadcast queue */
+#define BCAST NODES
+
+struct frame {
+  uint8_t data[PACKETBUF_SIZE];
+  uint8_t len;
+  uint8_t transmissions;
+  uint8_t discard;
+};
+
+struct queue {
+  struct frame frames[QUEUE_LEN];
+  uint8_t head;
+  uint8_t len;
+  uint8_t backoff_exponent;
+  uint8_t backoff_window;
+  uint8_t tx_links;
+};
+
+/* A bulk slotframe link */
+struct bulk_link {
+  int8_t peer;
+  uint8_t tx;
+};
+
+struct node {
+  int depth;
+  int parent;
+  struct process *process;
+  struct broadcast_conn *bc;
+  const struct broadcast_callbacks *bcb;
+  struct unicast_conn *uc;
+  const struct unicast_callbacks *ucb;
+  struct queue queues[NODES + 1];
+  int queued;
+  struct bulk_link bulk[BULK_PERIOD];
+  uint8_t file[FILE_SIZE];
+  cfs_offset_t file_size;
+  cfs_offset_t file_pos;
+  clock_time_t done;
+};
+static struct node nodes[NODES];
+static int prr[NODES][NODES];
+
+/* The node running */
+static int cur;
+static long tx_shared, tx_bulk, dropped;
+
+/*---------------------------------------------------------------------------*/
+/* Simulated clock, ctimers and etimers */
+static clock_time_t now;
+static struct {
+  struct ctimer *c;
+  struct etimer *e;
+  int node;
+} timers[MAX_TIMERS];
+static int num_timers;
+
+clock_time_t
+clock_time(void)
+{
+  return now;
+}
+static void
+timer_remove(void *t)
+{
+  int i;
+  for(i = 0; i < num_timers; i++) {
+    if(timers[i].c == t || timers[i].e == t) {
+      timers[i] = timers[--num_timers];
+      return;
+    }
+  }
+}
+static void
+timer_add(struct ctimer *c, struct etimer *e)
+{
+  if(num_timers == MAX_TIMERS) {
+    fprintf(stderr, "too many timers\n");
+    exit(1);
+  }
+  timers[num_timers].c = c;
+  timers[num_timers].e = e;
+  timers[num_timers].node = cur;
+  num_timers++;
+}
+static clock_time_t
+timer_due(int i)
+{
+  struct timer *t = timers[i].c != NULL ?
+    &timers[i].c->etimer.timer : &timers[i].e->timer;
+  return t->start + t->interval;
+}
+void
+ctimer_stop(struct ctimer *c)
+{
+  timer_remove(c);
+  c->etimer.p = PROCESS_NONE;
+}
+void
+ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr)
+{
+  timer_remove(c);
+  timer_set(&c->etimer.timer, t);
+  c->etimer.p = nodes[cur].process;
+  c->f = f;
+  c->ptr = ptr;
+  timer_add(c, NULL);
+}
+void
+ctimer_reset(struct ctimer *c)
+{
+  timer_remove(c);
+  c->etimer.timer.start += c->etimer.timer.interval;
+  c->etimer.p = nodes[cur].process;
+  timer_add(c, NULL);
+}
+int
+ctimer_expired(struct ctimer *c)
+{
+  return c->etimer.p == PROCESS_NONE;
+}
+void
+etimer_set(struct etimer *et, clock_time_t interval)
+{
+  timer_remove(et);
+  timer_set(&et->timer, interval);
+  et->p = nodes[cur].process;
+  timer_add(NULL, et);
+}
+int
+etimer_expired(struct etimer *et)
+{
+  return et->p == PROCESS_NONE;
+}
+/* Fires the timers due by now, in order */
+static void
+timers_run(void)
+{
+  struct ctimer *c;
+  struct etimer *e;
+  struct process *p;
+  int first;
+  int i;
+
+  while(num_timers > 0) {
+    first = 0;
+    for(i = 1; i < num_timers; i++) {
+      if(timer_due(i) < timer_due(first)) {
+        first = i;
+      }
+    }
+    if(timer_due(first) > now) {
+      return;
+    }
+    c = timers[first].c;
+    e = timers[first].e;
+    cur = timers[first].node;
+    timers[first] = timers[--num_timers];
+    if(c != NULL) {
+      c->etimer.p = PROCESS_NONE;
+      c->f(c->ptr);
+    } else {
+      p = e->p;
+      e->p = PROCESS_NONE;
+      p->thread(&p->pt, PROCESS_EVENT_TIMER, e);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Processes */
+process_event_t
+process_alloc_event(void)
+{
+  return PROCESS_EVENT_MAX;
+}
+void
+process_start(struct process *p, process_data_t data)
+{
+  nodes[cur].process = p;
+  PT_INIT(&p->pt);
+  p->thread(&p->pt, PROCESS_EVENT_INIT, data);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t rnd_state = 1;
+static uint32_t
+rnd(void)
+{
+  /* xorshift32, for reproducible runs */
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+unsigned short
+random_rand(void)
+{
+  return rnd();
+}
+void
+leds_on(unsigned char leds)
+{
+  /* Deluge turns the red LED on when it has the whole update */
+  if(nodes[cur].done == 0) {
+    nodes[cur].done = now;
+  }
+}
+void
+leds_off(unsigned char leds)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* One file per node, the one Deluge disseminates */
+int
+cfs_open(const char *name, int flags)
+{
+  nodes[cur].file_pos = 0;
+  return cur;
+}
+void
+cfs_close(int fd)
+{
+}
+cfs_offset_t
+cfs_seek(int fd, cfs_offset_t offset, int whence)
+{
+  struct node *n = &nodes[fd];
+  if(whence == CFS_SEEK_END) {
+    offset += n->file_size;
+  } else if(whence == CFS_SEEK_CUR) {
+    offset += n->file_pos;
+  }
+  if(offset < 0 || offset > FILE_SIZE) {
+    return (cfs_offset_t)-1;
+  }
+  n->file_pos = offset;
+  return offset;
+}
+int
+cfs_read(int fd, void *buf, unsigned int len)
+{
+  struct node *n = &nodes[fd];
+  if(len > n->file_size - n->file_pos) {
+    len = n->file_size - n->file_pos;
+  }
+  memcpy(buf, &n->file[n->file_pos], len);
+  n->file_pos += len;
+  return len;
+}
+int
+cfs_write(int fd, const void *buf, unsigned int len)
+{
+  struct node *n = &nodes[fd];
+  if(len > FILE_SIZE - n->file_pos) {
+    len = FILE_SIZE - n->file_pos;
+  }
+  memcpy(&n->file[n->file_pos], buf, len);
+  n->file_pos += len;
+  if(n->file_pos > n->file_size) {
+    n->file_size = n->file_pos;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Rime: frames go to the TSCH queues of the node */
+static void
+node_addr(linkaddr_t *addr, int i)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->u8[0] = i + 1;
+}
+static int
+enqueue(int dest, int discard)
+{
+  struct queue *q = &nodes[cur].queues[dest];
+  struct frame *f;
+
+  if(q->len == QUEUE_LEN || nodes[cur].queued == POOL_LEN) {
+    dropped++;
+    return 0;
+  }
+  f = &q->frames[(q->head + q->len) % QUEUE_LEN];
+  f->len = packetbuf_copyto(f->data);
+  f->transmissions = 0;
+  f->discard = discard;
+  q->len++;
+  nodes[cur].queued++;
+  return 1;
+}
+void
+broadcast_open(struct broadcast_conn *c, uint16_t channel,
+               const struct broadcast_callbacks *u)
+{
+  nodes[cur].bc = c;
+  nodes[cur].bcb = u;
+}
+void
+broadcast_close(struct broadcast_conn *c)
+{
+}
+int
+broadcast_send(struct broadcast_conn *c)
+{
+  return enqueue(BCAST, 0);
+}
+void
+unicast_open(struct unicast_conn *c, uint16_t channel,
+             const struct unicast_callbacks *u)
+{
+  nodes[cur].uc = c;
+  nodes[cur].ucb = u;
+}
+void
+unicast_close(struct unicast_conn *c)
+{
+}
+int
+unicast_send(struct unicast_conn *c, const linkaddr_t *receiver)
+{
+  if(receiver->u8[0] == 0 || receiver->u8[0] > NODES) {
+    /* E.g. linkaddr_null: broadcast by the MAC, dropped by the unicast
+       layer of every receiver */
+    return enqueue(BCAST, 1);
+  }
+  return enqueue(receiver->u8[0] - 1, 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Orchestra bulk cells, as orchestra_callback_bulk_reserve() installs
+   them: a node at depth d receives from its time source at slot
+   (d % 2) * BULK_SPREAD + its index % BULK_SPREAD */
+static int
+bulk_timeslot(int depth, int index)
+{
+  return (depth % 2) * BULK_SPREAD + index % BULK_SPREAD;
+}
+static void
+bulk_add(int slot, int peer, int tx)
+{
+  struct node *n = &nodes[cur];
+  if(n->bulk[slot].peer >= 0 && n->bulk[slot].tx) {
+    n->queues[n->bulk[slot].peer].tx_links--;
+  }
+  n->bulk[slot].peer = peer;
+  n->bulk[slot].tx = tx;
+  if(tx) {
+    n->queues[peer].tx_links++;
+  }
+}
+int
+bench_bulk_reserve(const linkaddr_t *peer, int tx)
+{
+  int p = peer->u8[0] - 1;
+  if(tx) {
+    bulk_add(bulk_timeslot(nodes[cur].depth + 1, p), p, 1);
+    return 1;
+  }
+  if(p != nodes[cur].parent) {
+    return 0;
+  }
+  bulk_add(bulk_timeslot(nodes[cur].depth, cur), p, 0);
+  return 1;
+}
+void
+bench_bulk_release(const linkaddr_t *peer, int tx)
+{
+  struct node *n = &nodes[cur];
+  int p = peer->u8[0] - 1;
+  int i;
+  for(i = 0; i < BULK_PERIOD; i++) {
+    if(n->bulk[i].peer == p && n->bulk[i].tx == !!tx) {
+      if(tx) {
+        n->queues[p].tx_links--;
+      }
+      n->bulk[i].peer = -1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* One TSCH slot: every node picks its frame for the cell it is in, then
+   frames are received by the listening neighbors that hear only one
+   transmitter */
+static void
+slot(unsigned long asn)
+{
+  static int dest[NODES];
+  static struct frame *frame[NODES];
+  int shared = asn % SHARED_PERIOD == 0;
+  int ts = asn % BULK_PERIOD;
+  int listening[NODES];
+  int heard[NODES];
+  int from[NODES];
+  struct queue *q;
+  linkaddr_t addr;
+  int i;
+  int j;
+
+  for(i = 0; i < NODES; i++) {
+    struct node *n = &nodes[i];
+    frame[i] = NULL;
+    dest[i] = -1;
+    listening[i] = 0;
+    if(shared) {
+      listening[i] = 1;
+      /* Broadcast first, then unicast to neighbors we have no Tx link to */
+      if(n->queues[BCAST].len > 0) {
+        dest[i] = BCAST;
+      } else {
+        for(j = 0; j < NODES; j++) {
+          q = &n->queues[j];
+          if(q->len > 0 && q->tx_links == 0 && q->backoff_window == 0) {
+            dest[i] = j;
+            break;
+          }
+        }
+      }
+    } else if(n->bulk[ts].peer >= 0) {
+      if(n->bulk[ts].tx) {
+        if(n->queues[n->bulk[ts].peer].len > 0) {
+          dest[i] = n->bulk[ts].peer;
+        }
+      } else {
+        listening[i] = 1;
+      }
+    }
+    if(dest[i] >= 0) {
+      q = &n->queues[dest[i]];
+      frame[i] = &q->frames[q->head];
+      listening[i] = 0;
+      if(shared) {
+        tx_shared++;
+      } else {
+        tx_bulk++;
+      }
+    }
+  }
+
+  /* Receptions, without capture */
+  for(j = 0; j < NODES; j++) {
+    heard[j] = 0;
+    from[j] = -1;
+    for(i = 0; i < NODES; i++) {
+      if(frame[i] != NULL && prr[i][j] > 0) {
+        heard[j]++;
+        from[j] = i;
+      }
+    }
+    if(!listening[j] || heard[j] != 1 || (int)(rnd() % 100) >= prr[from[j]][j]) {
+      from[j] = -1;
+    }
+  }
+
+  /* Transmitter side: dequeue, retransmit or back off */
+  for(i = 0; i < NODES; i++) {
+    struct node *n = &nodes[i];
+    int acked;
+    if(frame[i] == NULL) {
+      if(shared) {
+        /* Backoff windows count shared slots */
+        for(j = 0; j < NODES; j++) {
+          if(n->queues[j].backoff_window > 0 && n->queues[j].tx_links == 0) {
+            n->queues[j].backoff_window--;
+          }
+        }
+      }
+      continue;
+    }
+    q = &n->queues[dest[i]];
+    acked = dest[i] == BCAST || from[dest[i]] == i;
+    frame[i]->transmissions++;
+    if(acked || frame[i]->transmissions > MAX_FRAME_RETRIES) {
+      if(!acked) {
+        dropped++;
+      }
+      q->head = (q->head + 1) % QUEUE_LEN;
+      q->len--;
+      n->queued--;
+      if(dest[i] != BCAST && shared) {
+        q->backoff_exponent = 0;
+        q->backoff_window = 0;
+      }
+    } else if(shared && dest[i] != BCAST) {
+      q->backoff_exponent = q->backoff_exponent < MAX_BE ? q->backoff_exponent + 1 : MAX_BE;
+      q->backoff_window = (rnd() % (1 << q->backoff_exponent)) + 1;
+    }
+    if(shared) {
+      for(j = 0; j < NODES; j++) {
+        if(n->queues[j].backoff_window > 0 && n->queues[j].tx_links == 0) {
+          n->queues[j].backoff_window--;
+        }
+      }
+    }
+  }
+
+  /* Deliver to Deluge. The dequeued frames are still in the rings. */
+  for(j = 0; j < NODES; j++) {
+    i = from[j];
+    if(i < 0 || (dest[i] != BCAST && dest[i] != j) || frame[i]->discard) {
+      continue;
+    }
+    cur = j;
+    packetbuf_clear();
+    packetbuf_copyfrom(frame[i]->data, frame[i]->len);
+    node_addr(&addr, i);
+    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &addr);
+    if(dest[i] == BCAST) {
+      nodes[j].bcb->recv(nodes[j].bc, &addr);
+    } else {
+      nodes[j].ucb->recv(nodes[j].uc, &addr);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  char name[64];
+  char cmd[160];
+  int (*disseminate)(char *, unsigned);
+  void *so;
+  clock_time_t done[GRID_W];
+  unsigned long asn;
+  int updated;
+  int correct;
+  int dx, dy;
+  int i, j;
+
+  /* Topology and time source tree: the parent is the closest neighbor
+     one hop closer to the sink */
+  for(i = 0; i < NODES; i++) {
+    nodes[i].depth = i % GRID_W > i / GRID_W ? i % GRID_W : i / GRID_W;
+    nodes[i].parent = -1;
+    for(j = 0; j < BULK_PERIOD; j++) {
+      nodes[i].bulk[j].peer = -1;
+    }
+    for(j = 0; j < NODES; j++) {
+      dx = abs(i % GRID_W - j % GRID_W);
+      dy = abs(i / GRID_W - j / GRID_W);
+      prr[i][j] = i == j || dx > 1 || dy > 1 ? 0 : dx + dy == 1 ? 90 : 70;
+    }
+  }
+  for(i = 0; i < NODES; i++) {
+    for(j = 0; j < NODES; j++) {
+      if(prr[i][j] > 0 && nodes[j].depth == nodes[i].depth - 1
+         && (nodes[i].parent < 0 || prr[i][j] > prr[i][nodes[i].parent])) {
+        nodes[i].parent = j;
+      }
+    }
+  }
+
+  /* One copy of Deluge per node */
+  for(i = 0; i < NODES; i++) {
+    cur = i;
+    nodes[i].file_size = FILE_SIZE;
+    for(j = 0; j < FILE_SIZE; j++) {
+      nodes[i].file[j] = i == SINK ? j * 7 + 1 : 0;
+    }
+    snprintf(name, sizeof(name), "/tmp/deluge-bench-%d.so", i);
+    snprintf(cmd, sizeof(cmd), "cp deluge.so %s", name);
+    if(system(cmd) != 0 || (so = dlopen(name, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+      fprintf(stderr, "could not load %s: %s\n", name, dlerror());
+      return 1;
+    }
+    unlink(name);
+    disseminate = (int (*)(char *, unsigned))dlsym(so, "deluge_disseminate");
+    if(disseminate == NULL || disseminate("firmware", i == SINK) < 0) {
+      fprintf(stderr, "deluge_disseminate failed\n");
+      return 1;
+    }
+  }
+  nodes[SINK].done = 0;
+
+  updated = 0;
+  for(asn = 0; now < MAX_DURATION && updated < NODES - 1; asn++) {
+    now = asn * SLOT_TICKS;
+    timers_run();
+    slot(asn);
+    for(i = 0, updated = 0; i < NODES; i++) {
+      updated += i != SINK && nodes[i].done != 0;
+    }
+  }
+
+  /* When the last node of each depth got the update */
+  memset(done, 0, sizeof(done));
+  correct = 0;
+  for(i = 0; i < NODES; i++) {
+    if(i != SINK) {
+      correct += !memcmp(nodes[i].file, nodes[SINK].file, FILE_SIZE);
+      if(nodes[i].done == 0) {
+        done[nodes[i].depth] = (clock_time_t)-1;
+      } else if(done[nodes[i].depth] < nodes[i].done) {
+        done[nodes[i].depth] = nodes[i].done;
+      }
+    }
+  }
+  printf("deluge, %s, %d pages to %d nodes:\n", DELUGE_BULK_TRANSFER ?
+         "bulk transfer in reserved cells" : "broadcast in shared cells",
+         FILE_SIZE / S_PAGE, NODES - 1);
+  for(i = 1; i < GRID_W; i++) {
+    if(done[i] == (clock_time_t)-1) {
+      printf("  depth %d: not all updated\n", i);
+    } else {
+      printf("  depth %d: all updated after %6.0f s\n", i,
+             (double)done[i] / CLOCK_SECOND);
+    }
+  }
+  printf("  all nodes: %d/%d updated (%d correct) after %.0f s\n",
+         updated, NODES - 1, correct, (double)now / CLOCK_SECOND);
+  printf("  frames: %ld in shared cells, %ld in bulk cells, %ld dropped\n",
+         tx_shared, tx_bulk, dropped);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
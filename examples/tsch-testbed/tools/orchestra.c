@@ -57,9 +57,18 @@ static struct tsch_slotframe *sf_eb;
 #if ORCHESTRA_WITH_COMMON_SHARED
 static struct tsch_slotframe *sf_common;
 #endif
+#if ORCHESTRA_WITH_DEDICATED
+static struct tsch_slotframe *sf_data;
+#endif
 #if ORCHESTRA_WITH_RBUNICAST
 static struct tsch_slotframe *sf_rb;
 #endif
+#if ORCHESTRA_WITH_MULTICAST
+static struct tsch_slotframe *sf_mc;
+#endif
+#if ORCHESTRA_WITH_BULK
+static struct tsch_slotframe *sf_bulk;
+#endif
 #if ORCHESTRA_WITH_SBUNICAST
 static struct tsch_slotframe *sf_sb;
 static struct tsch_slotframe *sf_sb2;
@@ -292,13 +301,156 @@ orchestra_packet_sent(int mac_status)
 }
 #endif /* ORCHESTRA_WITH_SBUNICAST */
 
+#if ORCHESTRA_WITH_MULTICAST
+/* Multicast slot of a node at a given depth: the slotframe has one block of
+ * ORCHESTRA_MULTICAST_SPREAD slots per depth, in increasing depth order */
+static uint16_t
+orchestra_multicast_timeslot(uint8_t depth, uint16_t index)
+{
+  return (depth % ORCHESTRA_MULTICAST_MAX_DEPTH) * ORCHESTRA_MULTICAST_SPREAD
+      + index % ORCHESTRA_MULTICAST_SPREAD;
+}
+/* Install our multicast links: Tx in our depth's block, Rx in our time
+ * source's slot, one block earlier. A multicast packet from the root thus
+ * goes one block down per hop, and reaches every depth within a slotframe
+ * when forwarded right away (SMRF without forwarding delay). */
+static void
+orchestra_multicast_update(void)
+{
+  struct tsch_link *l;
+  struct tsch_neighbor *ts;
+  uint16_t ts_index;
+
+  if(sf_mc == NULL) {
+    return;
+  }
+  /* Start over, this happens on topology changes only */
+  while((l = list_head(sf_mc->links_list)) != NULL
+      && tsch_schedule_remove_link(sf_mc, l));
+  if(tsch_join_priority >= TSCH_MAX_JOIN_PRIORITY) {
+    /* Not associated */
+    return;
+  }
+  PRINTF("Orchestra: adding multicast tx link at %u\n",
+      orchestra_multicast_timeslot(tsch_join_priority, node_index));
+  tsch_schedule_add_link(sf_mc,
+      LINK_OPTION_TX,
+      LINK_TYPE_NORMAL, &tsch_multicast_address,
+      orchestra_multicast_timeslot(tsch_join_priority, node_index),
+      ORCHESTRA_MULTICAST_CHANNEL_OFFSET);
+  ts = tsch_queue_get_time_source();
+  if(tsch_join_priority > 0 && ts != NULL) {
+    ts_index = get_node_index_from_id(node_id_from_linkaddr(&ts->addr));
+    if(ts_index != 0xffff) {
+      PRINTF("Orchestra: adding multicast rx link at %u\n",
+          orchestra_multicast_timeslot(tsch_join_priority - 1, ts_index));
+      tsch_schedule_add_link(sf_mc,
+          LINK_OPTION_RX,
+          LINK_TYPE_NORMAL, &ts->addr,
+          orchestra_multicast_timeslot(tsch_join_priority - 1, ts_index),
+          ORCHESTRA_MULTICAST_CHANNEL_OFFSET);
+    }
+  }
+}
+#endif /* ORCHESTRA_WITH_MULTICAST */
+
+#if ORCHESTRA_WITH_BULK
+/* Bulk slot for transfers to a receiver at a given depth: the slotframe
+ * has one block of ORCHESTRA_BULK_SPREAD slots for even depths and one
+ * for odd depths. A node receives from its time source in one block and
+ * sends to its children in the other, i.e. it can receive a page while
+ * it forwards the previous one */
+static uint16_t
+orchestra_bulk_timeslot(uint8_t depth, uint16_t index)
+{
+  return (depth % 2) * ORCHESTRA_BULK_SPREAD + index % ORCHESTRA_BULK_SPREAD;
+}
+#endif /* ORCHESTRA_WITH_BULK */
+
+/* Reserve cells for a bulk transfer to (tx) or from (!tx) a neighbor.
+ * Only transfers from our time source to us are scheduled, which lets
+ * both ends derive the cells from the receiver's depth. Returns 1 if
+ * the cells are installed */
+int
+orchestra_callback_bulk_reserve(const linkaddr_t *peer, int tx)
+{
+#if ORCHESTRA_WITH_BULK
+  struct tsch_neighbor *ts;
+  uint16_t index;
+
+  if(sf_bulk == NULL || tsch_join_priority >= TSCH_MAX_JOIN_PRIORITY) {
+    return 0;
+  }
+  if(tx) {
+    /* The peer asks for bulk cells only if we are its time source */
+    index = get_node_index_from_id(node_id_from_linkaddr(peer));
+    if(index == 0xffff) {
+      return 0;
+    }
+    PRINTF("Orchestra: adding bulk tx link at %u\n",
+        orchestra_bulk_timeslot(tsch_join_priority + 1, index));
+    return tsch_schedule_add_link(sf_bulk,
+        LINK_OPTION_TX,
+        LINK_TYPE_NORMAL, peer,
+        orchestra_bulk_timeslot(tsch_join_priority + 1, index),
+        ORCHESTRA_BULK_CHANNEL_OFFSET) != NULL;
+  } else {
+    ts = tsch_queue_get_time_source();
+    if(ts == NULL || !linkaddr_cmp(&ts->addr, peer)) {
+      return 0;
+    }
+    PRINTF("Orchestra: adding bulk rx link at %u\n",
+        orchestra_bulk_timeslot(tsch_join_priority, node_index));
+    return tsch_schedule_add_link(sf_bulk,
+        LINK_OPTION_RX,
+        LINK_TYPE_NORMAL, peer,
+        orchestra_bulk_timeslot(tsch_join_priority, node_index),
+        ORCHESTRA_BULK_CHANNEL_OFFSET) != NULL;
+  }
+#else /* ORCHESTRA_WITH_BULK */
+  return 0;
+#endif /* ORCHESTRA_WITH_BULK */
+}
+
+void
+orchestra_callback_bulk_release(const linkaddr_t *peer, int tx)
+{
+#if ORCHESTRA_WITH_BULK
+  struct tsch_link *l;
+  struct tsch_link *next;
+
+  if(sf_bulk == NULL) {
+    return;
+  }
+  l = list_head(sf_bulk->links_list);
+  while(l != NULL) {
+    next = list_item_next(l);
+    if(linkaddr_cmp(&l->addr, peer)
+        && !(l->link_options & LINK_OPTION_TX) == !tx) {
+      PRINTF("Orchestra: removing bulk link at %u\n", l->timeslot);
+      tsch_schedule_remove_link(sf_bulk, l);
+    }
+    l = next;
+  }
+#endif /* ORCHESTRA_WITH_BULK */
+}
+
+void
+orchestra_callback_new_join_priority(uint8_t join_priority)
+{
+#if ORCHESTRA_WITH_MULTICAST
+  orchestra_multicast_update();
+#endif
+}
+
 void
 orchestra_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new)
 {
-  uint16_t old_id = node_id_from_linkaddr(&old->addr);
-  uint16_t old_index = get_node_index_from_id(old_id);
-  uint16_t new_id = node_id_from_linkaddr(&new->addr);
-  uint16_t new_index = get_node_index_from_id(new_id);
+  /* old or new are NULL when the first time source is set or when all time sources are lost */
+  uint16_t old_id = old != NULL ? node_id_from_linkaddr(&old->addr) : 0;
+  uint16_t old_index = old != NULL ? get_node_index_from_id(old_id) : 0xffff;
+  uint16_t new_id = new != NULL ? node_id_from_linkaddr(&new->addr) : 0;
+  uint16_t new_index = new != NULL ? get_node_index_from_id(new_id) : 0xffff;
 
   if(new_index == old_index) {
     return;
@@ -320,12 +472,74 @@ orchestra_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighb
   }
 #endif /* ORCHESTRA_WITH_EBSF */
 
+#if ORCHESTRA_WITH_MULTICAST
+  /* Listen to the new time source's multicast slot */
+  orchestra_multicast_update();
+#endif
+
 }
 
 #define NODE_NUMBER 50
 
-
-
+#if ORCHESTRA_WITH_DEDICATED
+/* Number of schedule[] entries */
+#define SCHEDULE_LEN (sizeof(schedule)/sizeof(schedule[0]) / 3)
+/* Channel offset of schedule entry i: entries sharing a timeslot are
+ * packed into consecutive channel offsets, in schedule[] order */
+static uint8_t
+orchestra_schedule_offset(uint8_t i)
+{
+  uint8_t j;
+  uint8_t offset = 0;
+  for(j = 0; j < i; j++) {
+    if(schedule[3*j+2] == schedule[3*i+2]) {
+      offset++;
+    }
+  }
+  return offset;
+}
+/* Checks that schedule entry i can be installed at this node: its channel
+ * offset must fit the hopping sequence, and we must not have another
+ * entry (Tx or Rx, as we are half-duplex) in the same timeslot.
+ * The first entry wins, conflicting ones are skipped. Returns 1 if ok.
+ * Rejections are a schedule.h bug, so they are reported with printf:
+ * LOG() is compiled out in WITH_DEPLOYMENT builds. */
+static int
+orchestra_schedule_check(uint8_t i, uint8_t offset)
+{
+  uint8_t j;
+  if(offset >= TSCH_N_CHANNELS) {
+    printf("Orchestra:! %u->%u slot %u: channel offset %u >= %u\n",
+        schedule[3*i], schedule[3*i+1], schedule[3*i+2], offset, TSCH_N_CHANNELS);
+    return 0;
+  }
+  for(j = 0; j < i; j++) {
+    if(schedule[3*j+2] == schedule[3*i+2]
+        && (schedule[3*j] == node_id || schedule[3*j+1] == node_id)) {
+      printf("Orchestra:! %u->%u slot %u: conflicts with %u->%u\n",
+          schedule[3*i], schedule[3*i+1], schedule[3*i+2],
+          schedule[3*j], schedule[3*j+1]);
+      return 0;
+    }
+  }
+  return 1;
+}
+/* Get the first neighbor we have a dedicated Tx cell to.
+ * Returns 1 and sets addr if found, 0 otherwise */
+int
+orchestra_get_scheduled_receiver(linkaddr_t *addr)
+{
+  struct tsch_link *l = sf_data != NULL ? list_head(sf_data->links_list) : NULL;
+  while(l != NULL) {
+    if(l->link_options & LINK_OPTION_TX) {
+      linkaddr_copy(addr, &l->addr);
+      return 1;
+    }
+    l = list_item_next(l);
+  }
+  return 0;
+}
+#endif
 
 void
 orchestra_init()
@@ -339,65 +553,73 @@ orchestra_init()
       node_index, 0);
 #endif
 
-//application packets
+#if ORCHESTRA_WITH_DEDICATED
+  /* Dedicated slotframe for application packets, installed from the
+   * static schedule: one Tx cell at the sender bound to the receiver, and
+   * one Rx cell at the receiver bound to the sender. None of these cells
+   * are shared, i.e. no CSMA backoff and no contention on the data path */
+  sf_data = tsch_schedule_add_slotframe(1, ORCHESTRA_DEDICATED_PERIOD);
+  uint8_t i;
+  uint8_t offset;
+  linkaddr_t link_addr;
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    if(schedule[3*i] != node_id && schedule[3*i+1] != node_id) {
+      continue;
+    }
+    offset = orchestra_schedule_offset(i);
+    if(!orchestra_schedule_check(i, offset)) {
+      continue;
+    }
+    if(schedule[3*i] == node_id) {
+      set_linkaddr_from_id(&link_addr, schedule[3*i+1]);
+      PRINTF("Orchestra: adding dedicated tx link to %u at %u\n", schedule[3*i+1], schedule[3*i+2]);
+      tsch_schedule_add_link(sf_data,
+          LINK_OPTION_TX,
+          LINK_TYPE_NORMAL, &link_addr,
+          schedule[3*i+2] + NODE_NUMBER, offset);
+    } else {
+      set_linkaddr_from_id(&link_addr, schedule[3*i]);
+      PRINTF("Orchestra: adding dedicated rx link from %u at %u\n", schedule[3*i], schedule[3*i+2]);
+      tsch_schedule_add_link(sf_data,
+          LINK_OPTION_RX,
+          LINK_TYPE_NORMAL, &link_addr,
+          schedule[3*i+2] + NODE_NUMBER, offset);
+    }
+  }
+#endif
+
 #if ORCHESTRA_WITH_SBUNICAST
   memb_init(&nbr_timestamps);
   /* Sender-based slotframe for unicast */
   sf_sb = tsch_schedule_add_slotframe(2, ORCHESTRA_SBUNICAST_PERIOD);
-
   /* Rx links (with lease time) will be added upon receiving unicast */
   /* Tx links (with lease time) will be added upon transmitting unicast (if ack received) */
-  uint8_t i = 0;
-  uint8_t curslot = 0;
-  uint8_t offset = 0;
-  //printf("orchestra: %d\n", sizeof(schedule)/sizeof(schedule[0]));
-  //printf("%d %d\n", node_index, node_id);
-  for(i = 0; i < sizeof(schedule)/sizeof(schedule[0]); i = i + 3){
-
-    if(schedule[i+2] != curslot){
-      curslot = schedule[i+2];
-      offset = 0;
-    }
-    else {
-      offset++;
-    }
-
-  	//printf("node %d %d %d\n", schedule[i], schedule[i+1], schedule[i+2]);
-  	if(schedule[i] == node_id){
-  		//printf("1    node %d timeslot %d\n", node_index, schedule[i+2]);
-  		/*
-  		tsch_schedule_add_link(sf_sb,
-      		LINK_OPTION_TX ,
-      		ORCHESTRA_COMMON_SHARED_TYPE, &tsch_broadcast_address,
-      		schedule[i+2], 2);
-		*/
-  		tsch_schedule_add_link(sf_eb,
-      		LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED,
-      		ORCHESTRA_COMMON_SHARED_TYPE, &tsch_broadcast_address,
-      		schedule[i+2] + NODE_NUMBER, offset);
-  	}
-  	else if(schedule[i+1] == node_id){
-  		//printf("2   node %d timeslot %d\n", node_index, schedule[i+2]);
-  		tsch_schedule_add_link(sf_eb,
-      		LINK_OPTION_RX ,
-      		ORCHESTRA_COMMON_SHARED_TYPE, &tsch_broadcast_address,
-      		schedule[i+2] + NODE_NUMBER, offset);  	
-  	}
-  }
-
-
   //rime_sniffer_add(&orhcestra_sniffer);
 #endif
 
 #if ORCHESTRA_WITH_COMMON_SHARED
   /* Default slotframe: for broadcast or unicast to neighbors we
    * do not have a link to */
-  /*
-  sf_common = tsch_schedule_add_slotframe(1, ORCHESTRA_COMMON_SHARED_PERIOD);
+  /* Application packets have dedicated cells, this slotframe carries
+   * management traffic (RPL DIO/DIS/DAO) only. It has a lower priority
+   * than the EB, dedicated and unicast slotframes, but a higher one than
+   * the multicast (4) and bulk (5) slotframes. */
+  sf_common = tsch_schedule_add_slotframe(3, ORCHESTRA_COMMON_SHARED_PERIOD);
   tsch_schedule_add_link(sf_common,
       LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED,
       ORCHESTRA_COMMON_SHARED_TYPE, &tsch_broadcast_address,
       0, 1);
-   */
+#endif
+
+#if ORCHESTRA_WITH_MULTICAST
+  /* Multicast slotframe, links follow our depth and time source */
+  sf_mc = tsch_schedule_add_slotframe(4, ORCHESTRA_MULTICAST_PERIOD);
+  orchestra_multicast_update();
+#endif
+
+#if ORCHESTRA_WITH_BULK
+  /* Bulk slotframe, empty until transfers reserve links in it. It has
+   * the lowest priority: the other slotframes' cells win on overlaps */
+  sf_bulk = tsch_schedule_add_slotframe(5, ORCHESTRA_BULK_PERIOD);
 #endif
 }
@@ -65,6 +65,8 @@
 #define ORCHESTRA_COMMON_SHARED_PERIOD            31
 #define ORCHESTRA_WITH_SBUNICAST                  1
 #define ORCHESTRA_SBUNICAST_PERIOD                ORCHESTRA_UNICAST_PERIOD
+#define ORCHESTRA_WITH_DEDICATED                  1
+#define ORCHESTRA_DEDICATED_PERIOD                ORCHESTRA_EBSF_PERIOD
 #ifdef ORCHESTRA_UNICAST_PERIOD2
 #define ORCHESTRA_SBUNICAST_PERIOD2               ORCHESTRA_UNICAST_PERIOD2
 #endif
@@ -76,9 +78,54 @@
 
 #endif
 
+/* Multicast slotframe, for downward multicast (e.g. SMRF) in cells scheduled
+ * along the DODAG depth. Needs TSCH_CONF_WITH_MULTICAST_QUEUE and
+ * TSCH_CALLBACK_NEW_JOIN_PRIORITY set to orchestra_callback_new_join_priority */
+#ifdef ORCHESTRA_CONF_WITH_MULTICAST
+#define ORCHESTRA_WITH_MULTICAST                  ORCHESTRA_CONF_WITH_MULTICAST
+#else
+#define ORCHESTRA_WITH_MULTICAST                  0
+#endif
+/* Tx slots per depth: nodes at the same depth are spread over them */
+#ifdef ORCHESTRA_CONF_MULTICAST_SPREAD
+#define ORCHESTRA_MULTICAST_SPREAD                ORCHESTRA_CONF_MULTICAST_SPREAD
+#else
+#define ORCHESTRA_MULTICAST_SPREAD                4
+#endif
+/* Depths with slots of their own, deeper nodes wrap around */
+#ifdef ORCHESTRA_CONF_MULTICAST_MAX_DEPTH
+#define ORCHESTRA_MULTICAST_MAX_DEPTH             ORCHESTRA_CONF_MULTICAST_MAX_DEPTH
+#else
+#define ORCHESTRA_MULTICAST_MAX_DEPTH             8
+#endif
+#define ORCHESTRA_MULTICAST_PERIOD                (ORCHESTRA_MULTICAST_MAX_DEPTH * ORCHESTRA_MULTICAST_SPREAD)
+#ifdef ORCHESTRA_CONF_MULTICAST_CHANNEL_OFFSET
+#define ORCHESTRA_MULTICAST_CHANNEL_OFFSET        ORCHESTRA_CONF_MULTICAST_CHANNEL_OFFSET
+#else
+#define ORCHESTRA_MULTICAST_CHANNEL_OFFSET        4
+#endif
+
+/* Bulk transfer slotframe, for Deluge in bulk mode (apps/deluge) with
+ * DELUGE_CALLBACK_BULK_RESERVE set to orchestra_callback_bulk_reserve and
+ * DELUGE_CALLBACK_BULK_RELEASE to orchestra_callback_bulk_release. Cells
+ * are reserved on demand between a node and its time source */
+#ifdef ORCHESTRA_CONF_WITH_BULK
+#define ORCHESTRA_WITH_BULK                       ORCHESTRA_CONF_WITH_BULK
+#else
+#define ORCHESTRA_WITH_BULK                       0
+#endif
+/* Slots per depth parity: the children of a node are spread over them */
+#define ORCHESTRA_BULK_SPREAD                     4
+#define ORCHESTRA_BULK_PERIOD                     (2 * ORCHESTRA_BULK_SPREAD)
+#define ORCHESTRA_BULK_CHANNEL_OFFSET             5
+
 void orchestra_init();
 void orchestra_callback_new_time_source(struct tsch_neighbor *old, struct tsch_neighbor *new);
+void orchestra_callback_new_join_priority(uint8_t join_priority);
+int orchestra_callback_bulk_reserve(const linkaddr_t *peer, int tx);
+void orchestra_callback_bulk_release(const linkaddr_t *peer, int tx);
 void orchestra_callback_joining_network();
 int orchestra_callback_do_nack(struct tsch_link *link, linkaddr_t *src, linkaddr_t *dst);
+int orchestra_get_scheduled_receiver(linkaddr_t *addr);
 
 #endif /* __ORCHESTRA_H__ */
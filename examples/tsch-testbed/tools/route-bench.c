@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native micro-benchmark of uip_ds6_route_lookup(), with the
+ *         route table of core/net/ipv6/uip-ds6-route.c. Fills the table
+ *         with n host routes (plus one /64 prefix route with -p) through
+ *         16 neighbors, then times lookups of random routed destinations
+ *         and of unrouted ones.
+ *
+ *         Build and run from this directory, once per lookup variant:
+ *         for h in 0 1; do gcc -O2 -I../../../core -I../../../platform/native \
+ *           -I../../../cpu/native -DNETSTACK_CONF_WITH_IPV6=1 \
+ *           -DUIP_CONF_MAX_ROUTES=256 -DNBR_TABLE_CONF_MAX_NEIGHBORS=16 \
+ *           -DUIP_DS6_ROUTE_CONF_HASH=$h -o route-bench route-bench.c \
+ *           ../../../core/net/ipv6/uip-ds6-route.c ../../../core/net/nbr-table.c \
+ *           ../../../core/net/linkaddr.c ../../../core/lib/list.c \
+ *           ../../../core/lib/memb.c && ./route-bench 8 64 256; done
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "net/ipv6/uip-ds6.h"
+
+#define NEIGHBORS 16
+#define LOOKUPS 1000000
+
+/*---------------------------------------------------------------------------*/
+/* Stubs for the parts of the stack the route table calls into. The
+   link-layer address of a neighbor is the tail of its IPv6 address. */
+static uip_lladdr_t lladdr;
+
+const uip_lladdr_t *
+uip_ds6_nbr_lladdr_from_ipaddr(const uip_ipaddr_t *ipaddr)
+{
+  memcpy(&lladdr, &ipaddr->u8[16 - sizeof(lladdr)], sizeof(lladdr));
+  return &lladdr;
+}
+uip_ipaddr_t *
+uip_ds6_nbr_ipaddr_from_lladdr(const uip_lladdr_t *lladdr)
+{
+  return NULL;
+}
+uip_ds6_nbr_t *
+uip_ds6_nbr_lookup(const uip_ipaddr_t *ipaddr)
+{
+  return NULL;
+}
+void
+uip_debug_ipaddr_print(const uip_ipaddr_t *addr)
+{
+}
+void
+stimer_set(struct stimer *t, unsigned long interval)
+{
+}
+int
+stimer_expired(struct stimer *t)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t rnd_state = 1;
+static uint32_t
+rnd(void)
+{
+  /* xorshift32, for reproducible runs */
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+/* fd00::<id>, as in the testbed */
+static void
+node_addr(uip_ipaddr_t *addr, uint16_t id)
+{
+  uip_ip6addr(addr, 0xfd00, 0, 0, 0, 0x0212, 0x7400, 0, id);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench(int n, int with_prefix)
+{
+  static uip_ipaddr_t dest[LOOKUPS / 1000];
+  uip_ipaddr_t addr;
+  uip_ipaddr_t nexthop;
+  double t;
+  long found;
+  int i;
+
+  for(i = 0; i < n; i++) {
+    node_addr(&addr, NEIGHBORS + 1 + i);
+    node_addr(&nexthop, 1 + i % NEIGHBORS);
+    if(uip_ds6_route_add(&addr, 128, &nexthop) == NULL) {
+      fprintf(stderr, "could not add route %d\n", i);
+      exit(1);
+    }
+  }
+  if(with_prefix) {
+    /* A prefix route, e.g. towards another PAN */
+    uip_ip6addr(&addr, 0xfd01, 0, 0, 0, 0, 0, 0, 0);
+    node_addr(&nexthop, 1);
+    uip_ds6_route_add(&addr, 64, &nexthop);
+  }
+
+  /* Routed destinations */
+  for(i = 0; i < LOOKUPS / 1000; i++) {
+    node_addr(&dest[i], NEIGHBORS + 1 + rnd() % n);
+  }
+  found = 0;
+  t = now_ns();
+  for(i = 0; i < LOOKUPS; i++) {
+    found += uip_ds6_route_lookup(&dest[i % (LOOKUPS / 1000)]) != NULL;
+  }
+  printf("  %4d routes%s: hit %7.1f ns", n, with_prefix ? " + /64" : "      ",
+         (now_ns() - t) / LOOKUPS);
+  if(found != LOOKUPS) {
+    printf(" (%ld MISSING)", LOOKUPS - found);
+  }
+
+  /* Unrouted destinations, e.g. going up to the default route */
+  for(i = 0; i < LOOKUPS / 1000; i++) {
+    node_addr(&dest[i], NEIGHBORS + 1 + n + rnd() % 1000);
+  }
+  found = 0;
+  t = now_ns();
+  for(i = 0; i < LOOKUPS; i++) {
+    found += uip_ds6_route_lookup(&dest[i % (LOOKUPS / 1000)]) != NULL;
+  }
+  printf("   miss %7.1f ns%s\n", (now_ns() - t) / LOOKUPS,
+         found ? " (FOUND)" : "");
+
+  while(uip_ds6_route_head() != NULL) {
+    uip_ds6_route_rm(uip_ds6_route_head());
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int with_prefix = 0;
+  int i;
+  int n;
+
+  printf("uip_ds6_route_lookup, %s, per lookup:\n",
+         UIP_DS6_ROUTE_HASH ? "hashed host routes" : "list walk");
+  uip_ds6_route_init();
+  for(i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-p")) {
+      with_prefix = 1;
+      continue;
+    }
+    n = atoi(argv[i]);
+    if(n < 1 || n + with_prefix > UIP_DS6_ROUTE_NB) {
+      fprintf(stderr, "n must be in [1, %d]\n", UIP_DS6_ROUTE_NB - with_prefix);
+      return 2;
+    }
+    bench(n, with_prefix);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
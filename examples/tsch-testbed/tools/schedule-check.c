@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Host-side checker for the static schedule in schedule.h.
+ *         Reports half-duplex and channel offset conflicts, packs the
+ *         cells into parallel channel offsets, prints the packed schedule
+ *         and the achievable throughput.
+ *
+ *         Build and run from this directory:
+ *         gcc -o schedule-check schedule-check.c && ./schedule-check [n_channels] [slotframe_len]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "schedule.h"
+
+/* Defaults match TSCH_N_CHANNELS and ORCHESTRA_DEDICATED_PERIOD */
+#define DEFAULT_N_CHANNELS 16
+#define DEFAULT_SLOTFRAME_LEN 397
+/* Orchestra installs the cells from this timeslot on (NODE_NUMBER) */
+#define SLOT_BASE 50
+/* Timeslot duration, in us */
+#define SLOT_DURATION 15000
+
+#define MAX_NODES 256
+#define MAX_SLOTS 512
+#define SCHEDULE_LEN ((int)(sizeof(schedule) / sizeof(schedule[0]) / 3))
+
+struct cell {
+  int sender;
+  int receiver;
+  int slot;
+  int offset;
+};
+
+static struct cell cells[SCHEDULE_LEN];
+static struct cell packed[SCHEDULE_LEN];
+/* Per timeslot: number of cells (i.e. channel offsets) in use */
+static int slot_cells[MAX_SLOTS];
+/* Per timeslot and node: 1 if the node already Tx or Rx in the slot */
+static unsigned char slot_busy[MAX_SLOTS][MAX_NODES];
+/*---------------------------------------------------------------------------*/
+static int
+node_ok(int id)
+{
+  return id > 0 && id < MAX_NODES;
+}
+/*---------------------------------------------------------------------------*/
+/* Loads schedule[], with channel offsets assigned as in orchestra_init.
+ * Returns the number of conflicts found. */
+static int
+load_and_check(int n_channels, int slotframe_len)
+{
+  int i, j;
+  int conflicts = 0;
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    cells[i].sender = schedule[3 * i];
+    cells[i].receiver = schedule[3 * i + 1];
+    cells[i].slot = schedule[3 * i + 2];
+    cells[i].offset = 0;
+    if(!node_ok(cells[i].sender) || !node_ok(cells[i].receiver)
+       || cells[i].sender == cells[i].receiver
+       || cells[i].slot < 0 || cells[i].slot >= MAX_SLOTS) {
+      printf("invalid: %d->%d slot %d\n",
+             cells[i].sender, cells[i].receiver, cells[i].slot);
+      conflicts++;
+      continue;
+    }
+    if(SLOT_BASE + cells[i].slot >= slotframe_len) {
+      printf("slotframe: %d->%d slot %d does not fit a slotframe of %d\n",
+             cells[i].sender, cells[i].receiver, cells[i].slot, slotframe_len);
+      conflicts++;
+    }
+    for(j = 0; j < i; j++) {
+      if(cells[j].slot != cells[i].slot) {
+        continue;
+      }
+      cells[i].offset++;
+      if(cells[j].sender == cells[i].sender || cells[j].sender == cells[i].receiver
+         || cells[j].receiver == cells[i].sender || cells[j].receiver == cells[i].receiver) {
+        printf("half-duplex: %d->%d and %d->%d both in slot %d\n",
+               cells[j].sender, cells[j].receiver,
+               cells[i].sender, cells[i].receiver, cells[i].slot);
+        conflicts++;
+      }
+    }
+    if(cells[i].offset >= n_channels) {
+      printf("channel: %d->%d slot %d needs offset %d, only %d channels\n",
+             cells[i].sender, cells[i].receiver, cells[i].slot,
+             cells[i].offset, n_channels);
+      conflicts++;
+    }
+  }
+  return conflicts;
+}
+/*---------------------------------------------------------------------------*/
+/* Greedy list scheduling: cells are taken in timeslot order and placed in
+ * the earliest timeslot where both ends are free and a channel offset is
+ * left. A cell is never placed before a cell that delivers to its sender,
+ * so that multi-hop forwarding order is preserved. */
+static void
+pack(int n_channels)
+{
+  int order[SCHEDULE_LEN];
+  int rx_ready[MAX_NODES];
+  int first = MAX_SLOTS;
+  int i, j, t;
+
+  memset(slot_cells, 0, sizeof(slot_cells));
+  memset(slot_busy, 0, sizeof(slot_busy));
+  /* Keep the first timeslot of the original schedule */
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    if(cells[i].slot >= 0 && cells[i].slot < first) {
+      first = cells[i].slot;
+    }
+  }
+  for(i = 0; i < MAX_NODES; i++) {
+    rx_ready[i] = first;
+  }
+  /* Stable insertion sort of the cells by timeslot */
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    for(j = i; j > 0 && cells[order[j - 1]].slot > cells[i].slot; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    struct cell *c = &cells[order[i]];
+    struct cell *p = &packed[order[i]];
+    *p = *c;
+    p->slot = -1;
+    if(!node_ok(c->sender) || !node_ok(c->receiver)) {
+      continue;
+    }
+    for(t = rx_ready[c->sender]; t < MAX_SLOTS; t++) {
+      if(slot_cells[t] < n_channels
+         && !slot_busy[t][c->sender] && !slot_busy[t][c->receiver]) {
+        break;
+      }
+    }
+    if(t == MAX_SLOTS) {
+      continue;
+    }
+    p->slot = t;
+    p->offset = slot_cells[t]++;
+    slot_busy[t][c->sender] = 1;
+    slot_busy[t][c->receiver] = 1;
+    if(rx_ready[c->receiver] < t + 1) {
+      rx_ready[c->receiver] = t + 1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Prints slot span, concurrency and throughput of a set of cells */
+static void
+report(const char *name, struct cell *set, int slotframe_len)
+{
+  int i;
+  int n = 0;
+  int min = MAX_SLOTS;
+  int max = -1;
+  int span;
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    if(set[i].slot < 0) {
+      continue;
+    }
+    n++;
+    if(set[i].slot < min) {
+      min = set[i].slot;
+    }
+    if(set[i].slot > max) {
+      max = set[i].slot;
+    }
+  }
+  if(n == 0) {
+    printf("%s: no cells\n", name);
+    return;
+  }
+  span = max - min + 1;
+  printf("%s: %d cells in %d timeslots, %.2f cells per timeslot\n",
+         name, n, span, (double)n / span);
+  /* One packet per cell and slotframe */
+  printf("%s: %.2f pkt/s per cell, %.2f pkt/s total with a slotframe of %d\n",
+         name, 1e6 / ((double)slotframe_len * SLOT_DURATION),
+         n * 1e6 / ((double)slotframe_len * SLOT_DURATION), slotframe_len);
+  printf("%s: %.2f pkt/s total with a slotframe of %d (no idle timeslot)\n",
+         name, n * 1e6 / ((double)span * SLOT_DURATION), span);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int n_channels = argc > 1 ? atoi(argv[1]) : DEFAULT_N_CHANNELS;
+  int slotframe_len = argc > 2 ? atoi(argv[2]) : DEFAULT_SLOTFRAME_LEN;
+  int conflicts;
+  int i, t;
+
+  if(n_channels <= 0 || slotframe_len <= 0) {
+    fprintf(stderr, "usage: %s [n_channels] [slotframe_len]\n", argv[0]);
+    return 2;
+  }
+
+  conflicts = load_and_check(n_channels, slotframe_len);
+  printf("schedule.h: %d cells, %d conflicts\n", SCHEDULE_LEN, conflicts);
+  if(conflicts == 0) {
+    report("schedule.h", cells, slotframe_len);
+  }
+
+  pack(n_channels);
+  report("packed", packed, slotframe_len);
+
+  /* Print the packed schedule, ordered by timeslot then channel offset,
+   * so that orchestra_init derives the same channel offsets */
+  printf("int schedule[] = {\n");
+  for(t = 0; t < MAX_SLOTS; t++) {
+    int offset;
+    for(offset = 0; offset < slot_cells[t]; offset++) {
+      for(i = 0; i < SCHEDULE_LEN; i++) {
+        if(packed[i].slot == t && packed[i].offset == offset) {
+          printf("  %d, %d, %d,\n", packed[i].sender, packed[i].receiver, t);
+        }
+      }
+    }
+  }
+  printf("};\n");
+  for(i = 0; i < SCHEDULE_LEN; i++) {
+    if(packed[i].slot < 0) {
+      printf("unscheduled: %d->%d\n", packed[i].sender, packed[i].receiver);
+    }
+  }
+
+  return conflicts != 0;
+}
+/*---------------------------------------------------------------------------*/
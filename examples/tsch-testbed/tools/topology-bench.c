@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+/**
+ * \file
+ *         Native benchmark of the root-side topology store (lib/topology.c)
+ *         against a list of nodes with linear lookup, as kept by a
+ *         list-based parent table. Builds a random tree of n nodes, then
+ *         times reparenting, path reconstruction, children walks and aging.
+ *         Then does the same through the RPL non-storing parent table
+ *         (net/rpl/rpl-ns.c), which the root uses by address: DAOs,
+ *         address lookups and paths, with numbered (MAC-derived) and with
+ *         random interface identifiers, against a linear address scan.
+ *
+ *         Build and run from this directory:
+ *         gcc -O2 -I../../../core -I../../../platform/native -I../../../cpu/native \
+ *           -DNETSTACK_CONF_WITH_IPV6=1 -DUIP_CONF_IPV6_RPL=1 -DRPL_CONF_MOP=1 \
+ *           -DTOPOLOGY_CONF_MAX_NODES=10001 -o topology-bench topology-bench.c \
+ *           ../../../core/lib/topology.c ../../../core/net/rpl/rpl-ns.c \
+ *           && ./topology-bench 1000 10000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lib/topology.h"
+#include "net/rpl/rpl-ns.h"
+
+#define MAX_PATH 64
+#define LIFETIME 3600
+
+/*---------------------------------------------------------------------------*/
+/* Reference: one list element per node, found by linear search */
+struct list_node {
+  struct list_node *next;
+  uint16_t id;
+  struct list_node *parent;
+  uint32_t lifetime;
+};
+static struct list_node *list_first;
+static struct list_node list_nodes[TOPOLOGY_MAX_NODES];
+
+static struct list_node *
+list_lookup(uint16_t id)
+{
+  struct list_node *l;
+  for(l = list_first; l != NULL; l = l->next) {
+    if(l->id == id) {
+      return l;
+    }
+  }
+  return NULL;
+}
+static void
+list_update(uint16_t id, uint16_t parent)
+{
+  struct list_node *n = list_lookup(id);
+  if(n == NULL) {
+    n = &list_nodes[id];
+    n->id = id;
+    n->next = list_first;
+    list_first = n;
+  }
+  n->lifetime = LIFETIME;
+  n->parent = parent ? list_lookup(parent) : NULL;
+}
+static int
+list_get_path(uint16_t root, uint16_t id, uint16_t *path, int max)
+{
+  struct list_node *n;
+  int len = 0;
+  int i;
+  for(n = list_lookup(id); n != NULL && n->id != root; n = n->parent) {
+    if(++len > max) {
+      return 0;
+    }
+  }
+  if(n == NULL) {
+    return 0;
+  }
+  for(n = list_lookup(id), i = len - 1; i >= 0; n = n->parent, i--) {
+    path[i] = n->id;
+  }
+  return len;
+}
+static int
+list_count_children(uint16_t id)
+{
+  struct list_node *l;
+  int count = 0;
+  for(l = list_first; l != NULL; l = l->next) {
+    if(l->parent != NULL && l->parent->id == id) {
+      count++;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t rnd_state = 1;
+static uint32_t
+rnd(void)
+{
+  /* xorshift32, for reproducible runs */
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+static uint16_t
+random_parent(uint16_t id)
+{
+  /* Among the nodes in [id/2, id): a depth of about 1.4 log2(n) */
+  uint16_t low = id / 2 > 1 ? id / 2 : 1;
+  return low + rnd() % (id - low);
+}
+static double
+now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t tree_parent[TOPOLOGY_MAX_NODES];
+
+static void
+bench(int n)
+{
+  uint16_t path[MAX_PATH];
+  double t;
+  long hops;
+  long checksum;
+  int ops = n;
+  int i;
+  uint16_t id, c;
+
+  /* Node 1 is the root, every other node picks an earlier parent */
+  rnd_state = 1;
+  for(i = 2; i <= n; i++) {
+    tree_parent[i] = random_parent(i);
+  }
+
+  printf("n = %d nodes, %d bytes per node (flat) vs %d (list)\n",
+         n, (int)(4 * sizeof(uint16_t) + sizeof(uint32_t)), (int)sizeof(struct list_node));
+
+  /* Build */
+  topology_init();
+  t = now_us();
+  topology_add_node(1, TOPOLOGY_INFINITE_LIFETIME);
+  for(i = 2; i <= n; i++) {
+    topology_add_node(i, LIFETIME);
+    topology_set_parent(i, tree_parent[i]);
+  }
+  printf("  build:    flat %10.3f us/node", (now_us() - t) / n);
+  list_first = NULL;
+  t = now_us();
+  list_update(1, 0);
+  for(i = 2; i <= n; i++) {
+    list_update(i, tree_parent[i]);
+  }
+  printf("   list %10.3f us/node\n", (now_us() - t) / n);
+
+  /* Paths */
+  hops = 0;
+  rnd_state = 2;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    hops += topology_get_path(1, 2 + rnd() % (n - 1), path, MAX_PATH);
+  }
+  printf("  path:     flat %10.3f us/path", (now_us() - t) / ops);
+  checksum = hops;
+  hops = 0;
+  rnd_state = 2;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    hops += list_get_path(1, 2 + rnd() % (n - 1), path, MAX_PATH);
+  }
+  printf("   list %10.3f us/path (%.2f hops on average%s)\n",
+         (now_us() - t) / ops, (double)hops / ops, hops == checksum ? "" : ", MISMATCH");
+
+  /* Reparenting, as new DAOs come in */
+  rnd_state = 3;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    id = 2 + rnd() % (n - 1);
+    topology_add_node(id, LIFETIME);
+    topology_set_parent(id, random_parent(id));
+  }
+  printf("  reparent: flat %10.3f us/op  ", (now_us() - t) / ops);
+  rnd_state = 3;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    id = 2 + rnd() % (n - 1);
+    list_update(id, random_parent(id));
+  }
+  printf("   list %10.3f us/op\n", (now_us() - t) / ops);
+
+  /* Children of every node, e.g. for a scheduler */
+  checksum = 0;
+  t = now_us();
+  for(id = 1; id <= n; id++) {
+    for(c = topology_first_child(id); c != TOPOLOGY_NONE; c = topology_next_sibling(c)) {
+      checksum++;
+    }
+  }
+  printf("  children: flat %10.3f us/node", (now_us() - t) / n);
+  hops = 0;
+  if(n <= 1000) {
+    t = now_us();
+    for(id = 1; id <= n; id++) {
+      hops += list_count_children(id);
+    }
+    printf("   list %10.3f us/node%s\n", (now_us() - t) / n, hops == checksum ? "" : " MISMATCH");
+  } else {
+    printf("   list    (O(n^2), skipped)\n");
+  }
+
+  /* One aging pass */
+  t = now_us();
+  topology_age(1, NULL);
+  printf("  age:      flat %10.3f us/pass, %u nodes left\n",
+         now_us() - t, topology_num_nodes());
+}
+/*---------------------------------------------------------------------------*/
+/* The same tree, through rpl-ns by address, as the root sees it */
+static void
+bench_addr(int n, int numbered)
+{
+  static uip_ipaddr_t addrs[TOPOLOGY_MAX_NODES];
+  static rpl_dag_t dag;
+  uint16_t path[MAX_PATH];
+  uint32_t r;
+  double t;
+  long hops;
+  long found;
+  int ops = n;
+  int i;
+  int j;
+  uint16_t id;
+
+  /* aaaa::/64, node 1 is the root, i.e. the DAG id */
+  rnd_state = 4;
+  for(i = 1; i <= n; i++) {
+    memset(&addrs[i], 0, sizeof(addrs[i]));
+    addrs[i].u8[0] = addrs[i].u8[1] = 0xaa;
+    if(numbered) {
+      /* 0212:7400:0000:<i>, as derived from the MAC of numbered motes */
+      addrs[i].u8[8] = 0x02;
+      addrs[i].u8[9] = 0x12;
+      addrs[i].u8[10] = 0x74;
+      addrs[i].u8[14] = i >> 8;
+      addrs[i].u8[15] = i;
+    } else {
+      r = rnd();
+      memcpy(&addrs[i].u8[8], &r, 4);
+      r = rnd();
+      memcpy(&addrs[i].u8[12], &r, 4);
+    }
+  }
+  memcpy(&dag.dag_id, &addrs[1], sizeof(dag.dag_id));
+
+  printf("  by address, %s identifiers:\n", numbered ? "numbered" : "random");
+  rpl_ns_init();
+  t = now_us();
+  for(i = 2; i <= n; i++) {
+    rpl_ns_update_node(&dag, &addrs[i], &addrs[tree_parent[i]], LIFETIME);
+  }
+  printf("    DAO:    rpl-ns %10.3f us/DAO,  %d nodes\n",
+         (now_us() - t) / (n - 1), rpl_ns_num_nodes());
+
+  found = 0;
+  rnd_state = 5;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    found += rpl_ns_get_node_id(&dag, &addrs[2 + rnd() % (n - 1)]) != TOPOLOGY_NONE;
+  }
+  printf("    lookup: rpl-ns %10.3f us/op ", (now_us() - t) / ops);
+  rnd_state = 5;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    id = 2 + rnd() % (n - 1);
+    for(j = 1; j <= n && memcmp(&addrs[j].u8[8], &addrs[id].u8[8], 8); j++);
+    found -= j <= n;
+  }
+  printf("  linear %10.3f us/op%s\n", (now_us() - t) / ops,
+         found == 0 ? "" : " MISMATCH");
+
+  hops = 0;
+  rnd_state = 2;
+  t = now_us();
+  for(i = 0; i < ops; i++) {
+    hops += rpl_ns_get_path(&dag, &addrs[2 + rnd() % (n - 1)], path, MAX_PATH);
+  }
+  printf("    path:   rpl-ns %10.3f us/path (%.2f hops on average)\n",
+         (now_us() - t) / ops, (double)hops / ops);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int i;
+  int n;
+
+  if(argc < 2) {
+    bench(1000);
+    bench_addr(1000, 1);
+    bench_addr(1000, 0);
+    return 0;
+  }
+  for(i = 1; i < argc; i++) {
+    n = atoi(argv[i]);
+    if(n < 2 || n >= TOPOLOGY_MAX_NODES) {
+      fprintf(stderr, "n must be in [2, %d]\n", TOPOLOGY_MAX_NODES - 1);
+      return 2;
+    }
+    bench(n);
+    bench_addr(n, 1);
+    bench_addr(n, 0);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -205,6 +205,10 @@
 #define UIP_CONF_FWCACHE_SIZE    30
 #define UIP_CONF_BROADCAST       1
 #define UIP_ARCH_IPCHKSUM        1
+/* The assembly checksum loop of cpu/msp430/uip-ipchksum.c is opt-in until
+   it has been checked against chksum() with examples/tsch-testbed/tools/
+   chksum-bench.c built for the target with UIP_ARCH_CHKSUM_WORDS=1. */
+#define UIP_ARCH_CHKSUM_WORDS    0
 #define UIP_CONF_UDP             1
 #define UIP_CONF_UDP_CHECKSUMS   1
 #define UIP_CONF_PINGADDRCONF    0